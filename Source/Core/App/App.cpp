@@ -27,6 +27,7 @@
 #include "ThemeSettings.h"
 #include "DataEncoder.h"
 #include "PluginManager.h"
+#include "PluginScanner.h"
 #include "Config.h"
 #include "Supervisor.h"
 #include "InternalClipboard.h"
@@ -296,10 +297,19 @@ void App::initialise(const String &commandLine)
         App::Layout().init();
 #endif
     }
-    else if (this->runMode == App::PLUGIN_CHECK)
+    else if (this->runMode == App::PLUGIN_SCAN)
     {
-        this->checkPlugin(commandLine);
-        this->quit();
+#if JUCE_MAC
+        Process::setDockIconVisible(false);
+#endif
+
+        // Stays alive and scans whatever the host sends, until the host disconnects
+        this->pluginScannerWorker = new PluginScannerWorker();
+
+        if (! this->pluginScannerWorker->initialiseFromCommandLine(commandLine, PLUGIN_SCANNER_PROCESS_ID))
+        {
+            this->quit();
+        }
     }
     else if (this->runMode == App::FONT_SERIALIZE)
     {
@@ -341,9 +351,9 @@ void App::shutdown()
         
         Logger::setCurrentLogger(nullptr);
     }
-    else if (this->runMode == App::PLUGIN_CHECK)
+    else if (this->runMode == App::PLUGIN_SCAN)
     {
-
+        this->pluginScannerWorker = nullptr;
     }
     else if (this->runMode == App::FONT_SERIALIZE)
     {
@@ -531,73 +541,15 @@ App::RunMode App::detectRunMode(const String &commandLine)
         {
             return App::FONT_SERIALIZE;
         }
-        if (FileUtils::getTempSlot(commandLine).existsAsFile())
+        if (PluginScanner::isWorkerCommandLine(commandLine))
         {
-            return App::PLUGIN_CHECK;
+            return App::PLUGIN_SCAN;
         }
     }
 
     return App::NORMAL;
 }
 
-void App::checkPlugin(const String &markerFile)
-{
-#if JUCE_MAC
-    Process::setDockIconVisible(false);
-#endif
-
-    const File tempFile(FileUtils::getTemporaryFolder() + File::separatorString + markerFile);
-
-    try
-    {
-        if (tempFile.existsAsFile())
-        {
-            if (tempFile.getSize() < 32768)
-            {
-                const String pluginPath = tempFile.loadFileAsString();
-
-                // сразу удаляем файл, если плагин накосячит, хост об этом узнает
-                tempFile.deleteFile();
-
-                const File pluginFile(pluginPath);
-
-                //if (pluginFile.existsAsFile()) // может быть и id
-                {
-                    KnownPluginList scanner;
-                    OwnedArray<PluginDescription> typesFound;
-
-                    AudioPluginFormatManager formatManager;
-                    AudioCore::initAudioFormats(formatManager);
-
-                    for (int i = 0; i < formatManager.getNumFormats(); ++i)
-                    {
-                        AudioPluginFormat *format = formatManager.getFormat(i);
-                        scanner.scanAndAddFile(pluginPath, false, typesFound, *format);
-                    }
-
-                    // если мы дошли до сих пор, то все хорошо и плагин нас не обрушил
-                    // так и запишем.
-                    if (typesFound.size() != 0)
-                    {
-                        ScopedPointer<XmlElement> typesXml(new XmlElement(Serialization::Core::instrumentRoot));
-
-                        for (auto i : typesFound)
-                        {
-                            typesXml->addChildElement(i->createXml());
-                        }
-
-                        DataEncoder::saveObfuscated(tempFile, typesXml);
-                    }
-                }
-            }
-        }
-    }
-    catch (...)
-    {
-        JUCEApplication::quit();
-    }
-}
-
 void App::handleAsyncUpdate()
 {
     this->quit();
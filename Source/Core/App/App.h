@@ -42,6 +42,7 @@ class Supervisor;
 class UpdateManager;
 class InternalClipboard;
 class AuthorizationManager;
+class PluginScannerWorker;
 
 class App : public JUCEApplication,
             private AsyncUpdater,
@@ -155,14 +156,14 @@ private:
 
     ScopedPointer<class Workspace> workspace;
 
+    ScopedPointer<PluginScannerWorker> pluginScannerWorker;
+
 private:
 
     String collectSomeSystemInfo();
 
     String getMacAddressList();
 
-    void checkPlugin(const String &markerFile);
-    
     void changeListenerCallback(ChangeBroadcaster *source) override;
 
 private:
@@ -170,7 +171,7 @@ private:
     enum RunMode
     {
         NORMAL,
-        PLUGIN_CHECK,
+        PLUGIN_SCAN,
         FONT_SERIALIZE
     };
 
@@ -25,8 +25,12 @@
 #include "DataEncoder.h"
 #include "SerializationKeys.h"
 #include "AudioMonitor.h"
+#include "ParallelAudioCallback.h"
 #include "AudiobusOutput.h"
 
+// The state captures are short and only run for the edited plugins
+#define AUDIO_CORE_MAX_LOADING_THREADS 4
+
 void AudioCore::initAudioFormats(AudioPluginFormatManager &formatManager)
 {
     formatManager.addDefaultFormats();
@@ -41,8 +45,14 @@ AudioCore::AudioCore()
     this->audioMonitor = new AudioMonitor();
     this->deviceManager.addAudioCallback(this->audioMonitor);
 
+    this->instrumentsCallback = new ParallelAudioCallback();
+    this->deviceManager.addAudioCallback(this->instrumentsCallback);
+
     AudioCore::initAudioFormats(this->formatManager);
 
+    this->instrumentsLoadingPool =
+        new ThreadPool(jlimit(1, AUDIO_CORE_MAX_LOADING_THREADS, SystemStats::getNumCpus() - 1));
+
     // requesting 0 inputs and only 2 outputs because of fucking alsa
     this->deviceManager.initialise(0, 2, nullptr, true);
 
@@ -62,6 +72,12 @@ AudioCore::~AudioCore()
     this->deviceManager.removeAudioCallback(this->audioMonitor);
     this->audioMonitor = nullptr;
 
+    this->deviceManager.removeAudioCallback(this->instrumentsCallback);
+    this->instrumentsCallback = nullptr;
+
+    // The state captures still in flight are waited for here
+    this->instrumentsLoadingPool = nullptr;
+
     //ScopedPointer<XmlElement> test(this->metaInstrument->serialize());
     //DataEncoder::saveObfuscated(File("111.txt"), test);
 
@@ -109,7 +125,7 @@ AudioMonitor *AudioCore::getMonitor() const noexcept
 Instrument *AudioCore::addInstrument(const PluginDescription &pluginDescription,
                                      const String &name)
 {
-    auto instrument = new Instrument(formatManager, name);
+    auto instrument = new Instrument(this->formatManager, *this->instrumentsLoadingPool, name);
     this->addInstrumentToDevice(instrument);
 
     instrument->initializeFrom(pluginDescription);
@@ -132,13 +148,13 @@ void AudioCore::removeInstrument(Instrument *instrument)
 
 void AudioCore::addInstrumentToDevice(Instrument *instrument)
 {
-    this->deviceManager.addAudioCallback(&instrument->getProcessorPlayer());
+    this->instrumentsCallback->addCallback(&instrument->getProcessorPlayer());
     this->deviceManager.addMidiInputCallback(String::empty, &instrument->getProcessorPlayer().getMidiMessageCollector());
 }
 
 void AudioCore::removeInstrumentFromDevice(Instrument *instrument)
 {
-    this->deviceManager.removeAudioCallback(&instrument->getProcessorPlayer());
+    this->instrumentsCallback->removeCallback(&instrument->getProcessorPlayer());
     this->deviceManager.removeMidiInputCallback(String::empty, &instrument->getProcessorPlayer().getMidiMessageCollector());
 }
 
@@ -281,11 +297,13 @@ void AudioCore::deserialize(const XmlElement &xml)
         {
             //Logger::writeToLog("--- instrument ---");
             //Logger::writeToLog(instrumentNode->createDocument(""));
-            Instrument *instrument = new Instrument(this->formatManager, "");
+            Instrument *instrument = new Instrument(this->formatManager, *this->instrumentsLoadingPool, "");
             this->addInstrumentToDevice(instrument);
             instrument->deserialize(*instrumentNode);
             this->instruments.add(instrument);
         }
+
+        Logger::writeToLog("AudioCore: loading " + String(this->instruments.size()) + " instruments");
     }
 
 
@@ -19,6 +19,7 @@
 
 class Instrument;
 class AudioMonitor;
+class ParallelAudioCallback;
 
 #include "Serializable.h"
 #include "OrchestraPit.h"
@@ -98,8 +99,15 @@ private:
     OwnedArray<Instrument> instruments;
     ScopedPointer<AudioMonitor> audioMonitor;
 
+    // All instruments are processed by this callback, in parallel
+    ScopedPointer<ParallelAudioCallback> instrumentsCallback;
+
     AudioPluginFormatManager formatManager;
     AudioDeviceManager deviceManager;
+
+    // Captures the edited plugins' states in the background, see NodeStateWatcher;
+    // restoring them is done on the message thread, as the plugins expect
+    ScopedPointer<ThreadPool> instrumentsLoadingPool;
     
     WeakReference<AudioCore>::Master masterReference;
     friend class WeakReference<AudioCore>;
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "BuiltInSynthSampler.h"
+
 #define BUILTIN_SYNTH_NUM_VOICES 32
 
 class BuiltInSynthAudioPlugin : public AudioPluginInstance
@@ -114,6 +116,6 @@ protected:
 
     virtual void initSampler() = 0;
 
-    Synthesiser synth;
+    BuiltInSynthesiser synth;
 
 };
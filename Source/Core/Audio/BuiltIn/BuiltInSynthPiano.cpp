@@ -17,6 +17,10 @@
 
 #include "Common.h"
 #include "BuiltInSynthPiano.h"
+#include "BuiltInSynthSampler.h"
+#include "BuiltInSynthSamplesPool.h"
+#include "BuiltInSynthSamplesCache.h"
+#include "BuiltInSynthStreamer.h"
 #include "BinaryData.h"
 
 #define ATTACK_TIME 0.0
@@ -29,17 +33,29 @@
 #   define BUILTIN_PIANO_DEFERRED_INIT 0
 #endif
 
+// If enabled, only the attacks are kept in memory, and the samples are played
+// up to their full length, streaming the rest from the decoded samples cache
+#if HELIO_DESKTOP
+#   define BUILTIN_PIANO_STREAMING 1
+#elif HELIO_MOBILE
+#   define BUILTIN_PIANO_STREAMING 0
+#endif
 
-BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/)
+
+BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/) :
+    Thread("BuiltInSynthPiano")
 {
     if (! empty)
     {
         this->initSamples();
         this->initVoices();
         
-#if ! BUILTIN_PIANO_DEFERRED_INIT
-        // This takes about 400ms on app load.
-        // If defined, avioding this and doing a deferred init on first processBlock
+#if BUILTIN_PIANO_DEFERRED_INIT
+        // This takes about 400ms on app load, when no decoded samples are cached yet,
+        // so decoding and caching are done in the background; the instrument
+        // just stays silent until its sounds are added
+        this->startThread(3);
+#else
         this->initSampler();
 #endif
     }
@@ -52,6 +68,16 @@ BuiltInSynthPiano::BuiltInSynthPiano(bool empty /*= false*/)
 
 BuiltInSynthPiano::~BuiltInSynthPiano()
 {
+#if BUILTIN_PIANO_DEFERRED_INIT
+    this->stopThread(5000);
+#endif
+
+    // Let the pool unload the samples, if this was the last instrument using them;
+    // the audio thread is not using this instance anymore at this point
+    this->synth.clearVoices();
+    this->synth.clearSounds();
+    BuiltInSynthSamplesPool::getInstance().purge();
+
     this->samples.clear();
 }
 
@@ -64,43 +90,87 @@ void BuiltInSynthPiano::initVoices()
 {
     for (int i = BUILTIN_SYNTH_NUM_VOICES; --i >= 0;)
     {
-        this->synth.addVoice(new SamplerVoice());
+        this->synth.addVoice(new BuiltInSynthVoice(BUILTIN_PIANO_STREAMING));
     }
+
+    // With the sustain pedal down, there are lots of quiet released notes
+    // which are the least noticeable ones to cut off
+    this->synth.setVoiceStealing(BuiltInSynthesiser::quietestNoteStealing);
+    this->synth.setInterpolation(BuiltInSynthVoice::linearInterpolation);
 }
 
-void BuiltInSynthPiano::processBlock(AudioSampleBuffer &buffer, MidiBuffer &midiMessages)
+void BuiltInSynthPiano::reset()
 {
-#if BUILTIN_PIANO_DEFERRED_INIT
-    if (this->synth.getNumSounds() == 0 &&
-        midiMessages.getNumEvents() > 0)
+    this->synth.allNotesOff(0, true);
+
+#if BUILTIN_PIANO_STREAMING
+    const int numUnderruns = BuiltInSynthStreamer::getInstance().getNumUnderruns();
+
+    if (numUnderruns > 0)
     {
-        Logger::writeToLog("BuiltInSynthPiano deferred init.");
-        this->initSampler();
+        Logger::writeToLog("BuiltInSynthPiano streaming underruns so far: " + String(numUnderruns));
     }
 #endif
-    
-    BuiltInSynthAudioPlugin::processBlock(buffer, midiMessages);
 }
 
-void BuiltInSynthPiano::reset()
+void BuiltInSynthPiano::run()
 {
-    this->synth.allNotesOff(0, true);
+    Logger::writeToLog("BuiltInSynthPiano deferred init.");
+    this->initSampler();
 }
 
 void BuiltInSynthPiano::initSampler()
 {
     this->synth.clearSounds();
 
+    const double startTime = Time::getMillisecondCounterHiRes();
+    auto &pool = BuiltInSynthSamplesPool::getInstance();
+
     for (auto s : this->samples)
     {
-        this->synth.addSound(new SamplerSound(s->name,
-                                              *s->reader,
-                                              s->midiNotes,
-                                              s->midiNoteForNormalPitch,
-                                              ATTACK_TIME,
-                                              RELEASE_TIME,
-                                              MAX_PLAY_TIME));
+        if (this->threadShouldExit())
+        {
+            return;
+        }
+
+        int streamedFileId = -1;
+        double maxLength = MAX_PLAY_TIME;
+
+#if BUILTIN_PIANO_STREAMING
+        const File streamedFile(BuiltInSynthSamplesCache::getCachedFileFor(s->name, s->sourceData, s->sourceDataSize));
+
+        // Falls back to preloading the whole thing, if the cache is not writable
+        if (streamedFile.existsAsFile())
+        {
+            streamedFileId = BuiltInSynthStreamer::getInstance().registerFile(streamedFile);
+            maxLength = BUILTIN_SYNTH_STREAMING_PRELOAD_SECONDS;
+        }
+#endif
+
+        // Other instances most likely hold these samples already:
+        BuiltInSynthSamplesPool::Sample::Ptr sample =
+            pool.getSample(s->name, s->sourceData, s->sourceDataSize, maxLength);
+
+        if (sample == nullptr)
+        {
+            jassertfalse;
+            continue;
+        }
+
+        this->synth.addSound(new BuiltInSynthSound(s->name,
+                                                   sample,
+                                                   s->midiNotes,
+                                                   s->midiNoteForNormalPitch,
+                                                   ATTACK_TIME,
+                                                   RELEASE_TIME,
+                                                   streamedFileId));
     }
+
+    const double initTimeMs = Time::getMillisecondCounterHiRes() - startTime;
+    const auto stats = pool.getStatistics();
+    Logger::writeToLog("BuiltInSynthPiano sampler init took " + String(initTimeMs, 1) + "ms, samples pool has " +
+                       String(stats.numSamples) + " samples, " + File::descriptionOfSizeInBytes(stats.bytesUsed) + " used, " +
+                       File::descriptionOfSizeInBytes(stats.bytesSaved) + " saved by sharing.");
 }
 
 void BuiltInSynthPiano::initSamples()
@@ -32,26 +32,28 @@ struct GrandSample
         int lowKey, int highKey, int rootKey,
         const void* sourceData, size_t sourceDataSize) :
         name(std::move(keyName)),
-        midiNoteForNormalPitch(rootKey)
+        midiNoteForNormalPitch(rootKey),
+        sourceData(sourceData),
+        sourceDataSize(sourceDataSize)
     {
         for (int i = lowKey; i <= highKey; ++i)
         { this->midiNotes.setBit(i); }
-
-        OggVorbisAudioFormat ogg;
-        this->reader = ogg.createReaderFor(new MemoryInputStream(sourceData, sourceDataSize, false), true);
     }
 
     String name;
-    ScopedPointer<AudioFormatReader> reader;
     BigInteger midiNotes;
     int midiNoteForNormalPitch;
+
+    // Compressed data is decoded (or taken from the shared pool) in initSampler
+    const void *sourceData;
+    size_t sourceDataSize;
     
 private:
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrandSample)
 };
 
-class BuiltInSynthPiano : public BuiltInSynthAudioPlugin
+class BuiltInSynthPiano : public BuiltInSynthAudioPlugin, private Thread
 {
 public:
 
@@ -63,8 +65,6 @@ public:
 
     const String getName() const override;
 
-    void processBlock(AudioSampleBuffer &buffer, MidiBuffer &midiMessages) override;
-
     void reset() override;
 
 protected:
@@ -76,6 +76,11 @@ protected:
     void initSamples();
 
     OwnedArray<GrandSample> samples;
+
+private:
+
+    // Deferred init: decodes and caches the samples off the audio thread
+    void run() override;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthPiano)
 
@@ -0,0 +1,420 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "BuiltInSynthSampler.h"
+
+//===----------------------------------------------------------------------===//
+// Sound
+//===----------------------------------------------------------------------===//
+
+BuiltInSynthSound::BuiltInSynthSound(const String &name,
+                                     BuiltInSynthSamplesPool::Sample::Ptr sample,
+                                     const BigInteger &midiNotes,
+                                     int midiNoteForNormalPitch,
+                                     double attackTimeSecs,
+                                     double releaseTimeSecs,
+                                     int streamedFileId) :
+    name(name),
+    sample(sample),
+    midiNotes(midiNotes),
+    midiRootNote(midiNoteForNormalPitch),
+    attackSamples(0),
+    releaseSamples(0),
+    streamedFileId(streamedFileId)
+{
+    jassert(this->sample != nullptr);
+
+    if (this->sample != nullptr)
+    {
+        this->attackSamples = roundToInt(attackTimeSecs * this->sample->getSampleRate());
+        this->releaseSamples = roundToInt(releaseTimeSecs * this->sample->getSampleRate());
+    }
+}
+
+bool BuiltInSynthSound::appliesToNote(int midiNoteNumber)
+{
+    return this->midiNotes[midiNoteNumber];
+}
+
+bool BuiltInSynthSound::appliesToChannel(int /*midiChannel*/)
+{
+    return true;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Voice
+//===----------------------------------------------------------------------===//
+
+BuiltInSynthVoice::BuiltInSynthVoice(bool supportsStreaming) :
+    interpolation(linearInterpolation),
+    stream(supportsStreaming ? new BuiltInSynthStream() : nullptr),
+    isStreaming(false),
+    pitchRatio(0.0),
+    sourceSamplePosition(0.0),
+    lgain(0.f),
+    rgain(0.f),
+    attackReleaseLevel(0.f),
+    attackDelta(0.f),
+    releaseDelta(0.f),
+    isInAttack(false),
+    isInRelease(false) {}
+
+float BuiltInSynthVoice::getCurrentLevel() const noexcept
+{
+    return this->lgain * this->attackReleaseLevel;
+}
+
+bool BuiltInSynthVoice::canPlaySound(SynthesiserSound *sound)
+{
+    return dynamic_cast<const BuiltInSynthSound *>(sound) != nullptr;
+}
+
+void BuiltInSynthVoice::startNote(int midiNoteNumber, float velocity, SynthesiserSound *s, int /*pitchWheel*/)
+{
+    const auto sound = dynamic_cast<const BuiltInSynthSound *>(s);
+
+    if (sound == nullptr || sound->sample == nullptr)
+    {
+        jassertfalse;
+        return;
+    }
+
+    this->pitchRatio = pow(2.0, (midiNoteNumber - sound->midiRootNote) / 12.0) *
+        sound->sample->getSampleRate() / this->getSampleRate();
+
+    this->sourceSamplePosition = 0.0;
+
+    // The preloaded part covers the time the streaming thread needs to fill the ring
+    this->isStreaming = (this->stream != nullptr && sound->isStreamed());
+
+    if (this->isStreaming)
+    {
+        this->stream->start(sound->streamedFileId, sound->sample->getData().getNumSamples());
+    }
+
+    this->lgain = velocity;
+    this->rgain = velocity;
+
+    this->isInAttack = (sound->attackSamples > 0);
+    this->isInRelease = false;
+
+    if (this->isInAttack)
+    {
+        this->attackReleaseLevel = 0.f;
+        this->attackDelta = float(this->pitchRatio / sound->attackSamples);
+    }
+    else
+    {
+        this->attackReleaseLevel = 1.f;
+        this->attackDelta = 0.f;
+    }
+
+    if (sound->releaseSamples > 0)
+    {
+        this->releaseDelta = float(-this->pitchRatio / sound->releaseSamples);
+    }
+    else
+    {
+        this->releaseDelta = -1.f;
+    }
+}
+
+void BuiltInSynthVoice::stopNote(float /*velocity*/, bool allowTailOff)
+{
+    if (allowTailOff)
+    {
+        this->isInAttack = false;
+        this->isInRelease = true;
+    }
+    else
+    {
+        if (this->isStreaming)
+        {
+            this->stream->stop();
+            this->isStreaming = false;
+        }
+
+        this->clearCurrentNote();
+    }
+}
+
+void BuiltInSynthVoice::pitchWheelMoved(int /*newValue*/) {}
+
+void BuiltInSynthVoice::controllerMoved(int /*controllerNumber*/, int /*newValue*/) {}
+
+void BuiltInSynthVoice::renderNextBlock(AudioSampleBuffer &outputBuffer, int startSample, int numSamples)
+{
+    const auto playingSound = static_cast<BuiltInSynthSound *>(this->getCurrentlyPlayingSound().get());
+
+    if (playingSound == nullptr)
+    {
+        return;
+    }
+
+    const AudioSampleBuffer &data = playingSound->sample->getData();
+    const double length = double(this->isStreaming ?
+        playingSound->sample->getSourceLength() : playingSound->sample->getLength());
+
+    const float *const inL = data.getReadPointer(0);
+    const float *const inR = data.getNumChannels() > 1 ? data.getReadPointer(1) : nullptr;
+
+    float *outL = outputBuffer.getWritePointer(0, startSample);
+    float *outR = outputBuffer.getNumChannels() > 1 ? outputBuffer.getWritePointer(1, startSample) : nullptr;
+
+    float chunkL[BUILTIN_SYNTH_RENDER_CHUNK_SIZE];
+    float chunkR[BUILTIN_SYNTH_RENDER_CHUNK_SIZE];
+    float envelope[BUILTIN_SYNTH_RENDER_CHUNK_SIZE];
+
+    // Only used by streaming voices
+    float scratchL[BUILTIN_SYNTH_STREAMING_SCRATCH_SIZE];
+    float scratchR[BUILTIN_SYNTH_STREAMING_SCRATCH_SIZE];
+
+    while (numSamples > 0)
+    {
+        int numToRender = jmin(numSamples, BUILTIN_SYNTH_RENDER_CHUNK_SIZE);
+        bool shouldStop = false;
+
+        if (this->isStreaming)
+        {
+            // Make sure the source frames of this chunk fit in the scratch buffers
+            numToRender = jmin(numToRender,
+                jmax(1, int((BUILTIN_SYNTH_STREAMING_SCRATCH_SIZE - 4) / this->pitchRatio)));
+        }
+
+        // The voice stops right after it has passed the end of the sample
+        const int samplesUntilEnd = int((length - this->sourceSamplePosition) / this->pitchRatio) + 1;
+
+        if (samplesUntilEnd <= numToRender)
+        {
+            numToRender = jmax(0, samplesUntilEnd);
+            shouldStop = true;
+        }
+
+        const float *sourceL = inL;
+        const float *sourceR = inR;
+        double sourcePosition = this->sourceSamplePosition;
+
+        if (this->isStreaming)
+        {
+            const int64 lastFrame = int64(this->sourceSamplePosition + this->pitchRatio * numToRender) + 2;
+
+            if (lastFrame >= data.getNumSamples())
+            {
+                // Past the preloaded part, gather the frames in the scratch buffers;
+                // on underrun the voice just plays silence and goes on
+                const int64 firstFrame = jmax(int64(0), int64(this->sourceSamplePosition) - 1);
+                this->stream->read(data, firstFrame, int(lastFrame - firstFrame + 1), scratchL, scratchR);
+                sourceL = scratchL;
+                sourceR = scratchR;
+                sourcePosition -= double(firstFrame);
+            }
+        }
+
+        this->interpolate(sourceL, sourcePosition, chunkL, numToRender);
+
+        if (sourceR != nullptr)
+        {
+            this->interpolate(sourceR, sourcePosition, chunkR, numToRender);
+        }
+
+        const float *const renderedR = (sourceR != nullptr) ? chunkR : chunkL;
+
+        if (this->isInAttack || this->isInRelease)
+        {
+            const float delta = this->isInAttack ? this->attackDelta : this->releaseDelta;
+
+            if (this->isInRelease)
+            {
+                // The last sample rendered is the one after which the level drops below zero
+                const int samplesUntilSilence = jmax(1, int(std::ceil(this->attackReleaseLevel / -delta)));
+
+                if (samplesUntilSilence <= numToRender)
+                {
+                    numToRender = samplesUntilSilence;
+                    shouldStop = true;
+                }
+            }
+
+            for (int i = 0; i < numToRender; ++i)
+            {
+                envelope[i] = jmin(1.f, this->attackReleaseLevel + delta * float(i));
+            }
+
+            FloatVectorOperations::multiply(chunkL, envelope, numToRender);
+
+            if (sourceR != nullptr)
+            {
+                FloatVectorOperations::multiply(chunkR, envelope, numToRender);
+            }
+
+            this->attackReleaseLevel += delta * float(numToRender);
+
+            if (this->isInAttack && this->attackReleaseLevel >= 1.f)
+            {
+                this->attackReleaseLevel = 1.f;
+                this->isInAttack = false;
+            }
+        }
+
+        if (outR != nullptr)
+        {
+            FloatVectorOperations::addWithMultiply(outL, chunkL, this->lgain, numToRender);
+            FloatVectorOperations::addWithMultiply(outR, renderedR, this->rgain, numToRender);
+            outR += numToRender;
+        }
+        else
+        {
+            FloatVectorOperations::addWithMultiply(outL, chunkL, this->lgain * 0.5f, numToRender);
+            FloatVectorOperations::addWithMultiply(outL, renderedR, this->rgain * 0.5f, numToRender);
+        }
+
+        outL += numToRender;
+        numSamples -= numToRender;
+        this->sourceSamplePosition += this->pitchRatio * numToRender;
+
+        if (shouldStop)
+        {
+            this->stopNote(0.f, false);
+            break;
+        }
+    }
+}
+
+// Positions are computed from the start of the chunk rather than accumulated,
+// so that there are no dependencies between iterations, and compilers can vectorize the loops
+void BuiltInSynthVoice::interpolate(const float *source, double startPosition,
+                                    float *dest, int numSamples) const noexcept
+{
+    const double ratio = this->pitchRatio;
+
+    if (ratio == 1.0)
+    {
+        // Not transposed, the fractional part is the same for the whole chunk
+        const int pos = int(startPosition);
+        const float alpha = float(startPosition - pos);
+        FloatVectorOperations::copyWithMultiply(dest, source + pos, 1.f - alpha, numSamples);
+        FloatVectorOperations::addWithMultiply(dest, source + pos + 1, alpha, numSamples);
+        return;
+    }
+
+    if (this->interpolation == cubicInterpolation)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double position = startPosition + ratio * i;
+            const int pos = int(position);
+            const float t = float(position - pos);
+
+            const float xm1 = source[jmax(0, pos - 1)];
+            const float x0 = source[pos];
+            const float x1 = source[pos + 1];
+            const float x2 = source[pos + 2];
+
+            const float c = (x1 - xm1) * 0.5f;
+            const float v = x0 - x1;
+            const float w = c + v;
+            const float a = w + v + (x2 - x0) * 0.5f;
+            const float b = w + a;
+
+            dest[i] = (((a * t) - b) * t + c) * t + x0;
+        }
+
+        return;
+    }
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const double position = startPosition + ratio * i;
+        const int pos = int(position);
+        const float alpha = float(position - pos);
+        dest[i] = source[pos] + (source[pos + 1] - source[pos]) * alpha;
+    }
+}
+
+
+//===----------------------------------------------------------------------===//
+// Synthesiser
+//===----------------------------------------------------------------------===//
+
+BuiltInSynthesiser::BuiltInSynthesiser() :
+    interpolation(BuiltInSynthVoice::linearInterpolation),
+    voiceStealing(defaultStealing) {}
+
+void BuiltInSynthesiser::setInterpolation(BuiltInSynthVoice::Interpolation newInterpolation)
+{
+    const ScopedLock sl(this->lock);
+    this->interpolation = newInterpolation;
+
+    for (auto voice : this->voices)
+    {
+        if (auto builtInVoice = dynamic_cast<BuiltInSynthVoice *>(voice))
+        {
+            builtInVoice->setInterpolation(newInterpolation);
+        }
+    }
+}
+
+SynthesiserVoice *BuiltInSynthesiser::findVoiceToSteal(SynthesiserSound *soundToPlay,
+                                                       int midiChannel, int midiNoteNumber) const
+{
+    if (this->voiceStealing == defaultStealing)
+    {
+        return Synthesiser::findVoiceToSteal(soundToPlay, midiChannel, midiNoteNumber);
+    }
+
+    SynthesiserVoice *bestVoice = nullptr;
+    float bestLevel = std::numeric_limits<float>::max();
+
+    for (auto voice : this->voices)
+    {
+        if (! voice->canPlaySound(soundToPlay))
+        {
+            continue;
+        }
+
+        if (this->voiceStealing == oldestNoteStealing)
+        {
+            if (bestVoice == nullptr)
+            {
+                bestVoice = voice;
+            }
+            else if (voice->isPlayingButReleased() != bestVoice->isPlayingButReleased())
+            {
+                bestVoice = voice->isPlayingButReleased() ? voice : bestVoice;
+            }
+            else if (voice->wasStartedBefore(*bestVoice))
+            {
+                bestVoice = voice;
+            }
+        }
+        else if (this->voiceStealing == quietestNoteStealing)
+        {
+            const auto builtInVoice = dynamic_cast<BuiltInSynthVoice *>(voice);
+            const float level = (builtInVoice != nullptr) ? builtInVoice->getCurrentLevel() : 1.f;
+
+            if (level < bestLevel)
+            {
+                bestLevel = level;
+                bestVoice = voice;
+            }
+        }
+    }
+
+    return bestVoice;
+}
@@ -0,0 +1,158 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "BuiltInSynthSamplesPool.h"
+#include "BuiltInSynthStreamer.h"
+
+// Pretty much the same as JUCE's SamplerSound and SamplerVoice,
+// except that the sample data is not owned by the sound, but shared via the samples pool,
+// and voices are rendered in chunks with vector operations instead of sample by sample.
+
+#define BUILTIN_SYNTH_RENDER_CHUNK_SIZE 64
+
+// Streamed voices gather the source frames of each chunk in a buffer on stack,
+// that is enough for transposing an octave up and more
+#define BUILTIN_SYNTH_STREAMING_SCRATCH_SIZE (BUILTIN_SYNTH_RENDER_CHUNK_SIZE * 8 + 8)
+
+class BuiltInSynthSound : public SynthesiserSound
+{
+public:
+
+    BuiltInSynthSound(const String &name,
+                      BuiltInSynthSamplesPool::Sample::Ptr sample,
+                      const BigInteger &midiNotes,
+                      int midiNoteForNormalPitch,
+                      double attackTimeSecs,
+                      double releaseTimeSecs,
+                      int streamedFileId = -1);
+
+    const String &getName() const noexcept
+    { return this->name; }
+
+    const BuiltInSynthSamplesPool::Sample *getSample() const noexcept
+    { return this->sample.get(); }
+
+    // The sample data only has the beginning of the sound,
+    // and the rest is streamed from the file registered in BuiltInSynthStreamer
+    bool isStreamed() const noexcept
+    { return this->streamedFileId >= 0; }
+
+    bool appliesToNote(int midiNoteNumber) override;
+
+    bool appliesToChannel(int midiChannel) override;
+
+private:
+
+    friend class BuiltInSynthVoice;
+
+    String name;
+    BuiltInSynthSamplesPool::Sample::Ptr sample;
+    BigInteger midiNotes;
+    int midiRootNote;
+    int attackSamples;
+    int releaseSamples;
+    int streamedFileId;
+
+    JUCE_LEAK_DETECTOR(BuiltInSynthSound)
+};
+
+class BuiltInSynthVoice : public SynthesiserVoice
+{
+public:
+
+    enum Interpolation
+    {
+        linearInterpolation,    // cheap, a bit of aliasing on the transposed notes
+        cubicInterpolation      // 4-point hermite, about twice as expensive
+    };
+
+    // Streaming voices own a ring buffer, which is filled by the streaming thread;
+    // non-streaming ones only play the preloaded part of the streamed sounds
+    explicit BuiltInSynthVoice(bool supportsStreaming = false);
+
+    void setInterpolation(Interpolation newInterpolation) noexcept
+    { this->interpolation = newInterpolation; }
+
+    // Velocity times the envelope level, used to pick a voice to steal
+    float getCurrentLevel() const noexcept;
+
+    bool canPlaySound(SynthesiserSound *sound) override;
+
+    void startNote(int midiNoteNumber, float velocity, SynthesiserSound *sound, int pitchWheel) override;
+
+    void stopNote(float velocity, bool allowTailOff) override;
+
+    void pitchWheelMoved(int newValue) override;
+
+    void controllerMoved(int controllerNumber, int newValue) override;
+
+    void renderNextBlock(AudioSampleBuffer &outputBuffer, int startSample, int numSamples) override;
+
+private:
+
+    void interpolate(const float *source, double startPosition,
+                     float *dest, int numSamples) const noexcept;
+
+    Interpolation interpolation;
+    ScopedPointer<BuiltInSynthStream> stream;
+    bool isStreaming;
+
+    double pitchRatio;
+    double sourceSamplePosition;
+    float lgain;
+    float rgain;
+    float attackReleaseLevel;
+    float attackDelta;
+    float releaseDelta;
+    bool isInAttack;
+    bool isInRelease;
+
+    JUCE_LEAK_DETECTOR(BuiltInSynthVoice)
+};
+
+class BuiltInSynthesiser : public Synthesiser
+{
+public:
+
+    enum VoiceStealing
+    {
+        defaultStealing,        // JUCE's heuristics: keeps the lowest and the highest notes
+        oldestNoteStealing,     // released voices first, then the oldest one
+        quietestNoteStealing    // the one with the lowest velocity times envelope level
+    };
+
+    BuiltInSynthesiser();
+
+    void setInterpolation(BuiltInSynthVoice::Interpolation newInterpolation);
+
+    void setVoiceStealing(VoiceStealing newVoiceStealing) noexcept
+    { this->voiceStealing = newVoiceStealing; }
+
+protected:
+
+    SynthesiserVoice *findVoiceToSteal(SynthesiserSound *soundToPlay,
+                                       int midiChannel, int midiNoteNumber) const override;
+
+private:
+
+    BuiltInSynthVoice::Interpolation interpolation;
+    VoiceStealing voiceStealing;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthesiser)
+};
@@ -0,0 +1,196 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "BuiltInSynthSamplesCache.h"
+#include "FileUtils.h"
+
+#define SAMPLES_CACHE_SUBFOLDER "Samples"
+#define SAMPLES_CACHE_EXTENSION ".wav"
+#define SAMPLES_CACHE_BITS_PER_SAMPLE 32
+
+// Bump this whenever the cached data layout changes
+#define SAMPLES_CACHE_VERSION 1
+
+AudioFormatReader *BuiltInSynthSamplesCache::createReaderFor(const String &sampleName,
+                                                             const void *sourceData,
+                                                             size_t sourceDataSize,
+                                                             bool *wasCached)
+{
+    if (wasCached != nullptr)
+    { *wasCached = false; }
+
+    // Only parses the headers, no decoding here:
+    OggVorbisAudioFormat ogg;
+    ScopedPointer<AudioFormatReader> oggReader(ogg.createReaderFor(new MemoryInputStream(sourceData, sourceDataSize, false), true));
+
+    if (oggReader == nullptr)
+    {
+        return nullptr;
+    }
+
+    const uint64 dataHash = getDataHash(sourceData, sourceDataSize);
+    const File cacheFile(getCacheFileFor(sampleName, dataHash, oggReader->sampleRate));
+    const bool cacheFileExists = cacheFile.existsAsFile();
+
+    if (cacheFileExists || writeCacheFile(*oggReader, cacheFile))
+    {
+        WavAudioFormat wav;
+        ScopedPointer<MemoryMappedAudioFormatReader> mappedReader(wav.createMemoryMappedReader(cacheFile));
+
+        if (mappedReader != nullptr &&
+            mappedReader->lengthInSamples == oggReader->lengthInSamples &&
+            mappedReader->numChannels == oggReader->numChannels &&
+            mappedReader->mapEntireFile())
+        {
+            if (wasCached != nullptr)
+            { *wasCached = cacheFileExists; }
+
+            return mappedReader.release();
+        }
+
+        // Something is wrong with the cached file, so it will be re-created next time
+        Logger::writeToLog("BuiltInSynthSamplesCache: invalid cache file " + cacheFile.getFileName());
+        mappedReader = nullptr;
+        cacheFile.deleteFile();
+    }
+
+    return oggReader.release();
+}
+
+File BuiltInSynthSamplesCache::getCachedFileFor(const String &sampleName,
+                                                const void *sourceData,
+                                                size_t sourceDataSize)
+{
+    OggVorbisAudioFormat ogg;
+    ScopedPointer<AudioFormatReader> oggReader(ogg.createReaderFor(new MemoryInputStream(sourceData, sourceDataSize, false), true));
+
+    if (oggReader == nullptr)
+    {
+        return File();
+    }
+
+    const uint64 dataHash = getDataHash(sourceData, sourceDataSize);
+    const File cacheFile(getCacheFileFor(sampleName, dataHash, oggReader->sampleRate));
+
+    if (cacheFile.existsAsFile() || writeCacheFile(*oggReader, cacheFile))
+    {
+        return cacheFile;
+    }
+
+    return File();
+}
+
+File BuiltInSynthSamplesCache::getCacheFolder()
+{
+    const File samplesFolder(FileUtils::getCacheFolder().getChildFile(SAMPLES_CACHE_SUBFOLDER));
+
+    if (!samplesFolder.isDirectory())
+    { samplesFolder.createDirectory(); }
+
+    return samplesFolder;
+}
+
+int64 BuiltInSynthSamplesCache::getCacheSize()
+{
+    int64 result = 0;
+    Array<File> cachedFiles;
+    getCacheFolder().findChildFiles(cachedFiles, File::findFiles, false, "*" SAMPLES_CACHE_EXTENSION);
+
+    for (const auto &file : cachedFiles)
+    {
+        result += file.getSize();
+    }
+
+    return result;
+}
+
+void BuiltInSynthSamplesCache::clear()
+{
+    Array<File> cachedFiles;
+    getCacheFolder().findChildFiles(cachedFiles, File::findFiles, false);
+
+    for (const auto &file : cachedFiles)
+    {
+        file.deleteFile();
+    }
+}
+
+// FNV-1a, which is fast enough to hash all the built-in samples on every launch
+uint64 BuiltInSynthSamplesCache::getDataHash(const void *data, size_t size) noexcept
+{
+    uint64 hash = 14695981039346656037ULL;
+    const uint8 *bytes = static_cast<const uint8 *>(data);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+File BuiltInSynthSamplesCache::getCacheFileFor(const String &sampleName,
+                                               uint64 dataHash,
+                                               double sampleRate)
+{
+    const String fileName =
+        File::createLegalFileName(sampleName) + "_" +
+        String::toHexString(static_cast<int64>(dataHash)) + "_" +
+        String(roundToInt(sampleRate)) + "_v" +
+        String(SAMPLES_CACHE_VERSION) + SAMPLES_CACHE_EXTENSION;
+
+    return getCacheFolder().getChildFile(fileName);
+}
+
+bool BuiltInSynthSamplesCache::writeCacheFile(AudioFormatReader &sourceReader,
+                                              const File &targetFile)
+{
+    // Writes to a uniquely named temporary file first, so that a crash
+    // in the middle of writing never leaves a truncated cache file,
+    // and several instruments caching the same sample never write into one file
+    TemporaryFile tempFile(targetFile);
+
+    ScopedPointer<FileOutputStream> out(tempFile.getFile().createOutputStream());
+
+    if (out == nullptr || out->failedToOpen())
+    {
+        return false;
+    }
+
+    WavAudioFormat wav;
+    ScopedPointer<AudioFormatWriter> writer(wav.createWriterFor(out,
+                                                                sourceReader.sampleRate,
+                                                                sourceReader.numChannels,
+                                                                SAMPLES_CACHE_BITS_PER_SAMPLE,
+                                                                StringPairArray(), 0));
+
+    if (writer == nullptr)
+    {
+        return false;
+    }
+
+    // The writer owns the stream now
+    out.release();
+
+    const bool written = writer->writeFromAudioReader(sourceReader, 0, -1);
+    writer = nullptr;
+
+    // The temporary file is deleted in its destructor, if not moved
+    return written && tempFile.overwriteTargetFileWithTemporary();
+}
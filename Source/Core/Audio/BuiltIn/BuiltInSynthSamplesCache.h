@@ -0,0 +1,61 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Keeps decoded PCM of the built-in compressed samples on disk,
+// as 32-bit float wav files, which can be memory-mapped on the next launches
+// instead of decoding ogg data again (that is what makes built-in instruments slow to init).
+// Cached files are keyed by the source data hash and the sample rate.
+
+class BuiltInSynthSamplesCache
+{
+public:
+
+    // Returns a reader for the decoded sample: either a memory-mapped reader
+    // of the cached copy, or, if there's none yet, decodes the source and caches it.
+    // Falls back to the plain ogg reader if the cache folder is not writable.
+    // @param wasCached: optional, set to true if the cached copy was used
+    static AudioFormatReader *createReaderFor(const String &sampleName,
+                                              const void *sourceData,
+                                              size_t sourceDataSize,
+                                              bool *wasCached = nullptr);
+
+    // Makes sure the decoded copy is on disk, so that it can be streamed,
+    // returns File() if the source is not valid or the cache folder is not writable
+    static File getCachedFileFor(const String &sampleName,
+                                 const void *sourceData,
+                                 size_t sourceDataSize);
+
+    static File getCacheFolder();
+
+    static int64 getCacheSize();
+
+    static void clear();
+
+    static uint64 getDataHash(const void *data, size_t size) noexcept;
+
+private:
+
+    static File getCacheFileFor(const String &sampleName,
+                                uint64 dataHash,
+                                double sampleRate);
+
+    static bool writeCacheFile(AudioFormatReader &sourceReader,
+                               const File &targetFile);
+
+};
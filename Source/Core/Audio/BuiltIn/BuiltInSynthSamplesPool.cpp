@@ -0,0 +1,174 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "BuiltInSynthSamplesPool.h"
+#include "BuiltInSynthSamplesCache.h"
+
+// Voices interpolate between neighbouring samples
+#define SAMPLE_TAIL_PADDING 4
+
+//===----------------------------------------------------------------------===//
+// Sample
+//===----------------------------------------------------------------------===//
+
+BuiltInSynthSamplesPool::Sample::Sample(uint64 key,
+                                        AudioFormatReader &source,
+                                        double maxLengthSeconds) :
+    key(key),
+    sampleRate(source.sampleRate),
+    length(0),
+    sourceLength(source.lengthInSamples)
+{
+    if (source.sampleRate > 0 && source.lengthInSamples > 0)
+    {
+        this->length = jmin(int(source.lengthInSamples),
+                            int(maxLengthSeconds * source.sampleRate));
+
+        this->data.setSize(jmin(2, int(source.numChannels)), this->length + SAMPLE_TAIL_PADDING);
+        source.read(&this->data, 0, this->length + SAMPLE_TAIL_PADDING, 0, true, true);
+    }
+}
+
+int64 BuiltInSynthSamplesPool::Sample::getSizeInBytes() const noexcept
+{
+    return int64(this->data.getNumChannels()) * this->data.getNumSamples() * sizeof(float);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Pool
+//===----------------------------------------------------------------------===//
+
+BuiltInSynthSamplesPool::Sample::Ptr BuiltInSynthSamplesPool::getSample(const String &name,
+                                                                        const void *sourceData,
+                                                                        size_t sourceDataSize,
+                                                                        double maxLengthSeconds)
+{
+    const uint64 key = BuiltInSynthSamplesCache::getDataHash(sourceData, sourceDataSize) ^
+                       uint64(String(maxLengthSeconds).hashCode64());
+
+    PendingSample::Ptr pending;
+
+    {
+        const ScopedLock lock(this->samplesLock);
+
+        for (auto sample : this->samples)
+        {
+            if (sample->getKey() == key)
+            {
+                return sample;
+            }
+        }
+
+        // Two instruments created at the same time should never decode the same sample twice,
+        // so the one who came second just waits for the first one's result
+        for (auto loading : this->pendingSamples)
+        {
+            if (loading->key == key)
+            {
+                pending = loading;
+                break;
+            }
+        }
+
+        if (pending == nullptr)
+        {
+            this->pendingSamples.add(new PendingSample(key));
+        }
+    }
+
+    if (pending != nullptr)
+    {
+        pending->loaded.wait();
+        return pending->result;
+    }
+
+    // Decoding is done without holding the lock,
+    // so that it never blocks the other samples lookups
+    Sample::Ptr sample;
+    ScopedPointer<AudioFormatReader> reader(
+        BuiltInSynthSamplesCache::createReaderFor(name, sourceData, sourceDataSize));
+
+    if (reader != nullptr)
+    {
+        sample = new Sample(key, *reader, maxLengthSeconds);
+
+        if (sample->getLength() == 0)
+        {
+            sample = nullptr;
+        }
+    }
+
+    {
+        const ScopedLock lock(this->samplesLock);
+
+        for (int i = this->pendingSamples.size(); --i >= 0;)
+        {
+            if (this->pendingSamples.getObjectPointerUnchecked(i)->key == key)
+            {
+                pending = this->pendingSamples.getObjectPointerUnchecked(i);
+                this->pendingSamples.remove(i);
+                break;
+            }
+        }
+
+        if (sample != nullptr)
+        {
+            this->samples.add(sample);
+        }
+    }
+
+    jassert(pending != nullptr);
+    pending->result = sample;
+    pending->loaded.signal();
+
+    return sample;
+}
+
+void BuiltInSynthSamplesPool::purge()
+{
+    const ScopedLock lock(this->samplesLock);
+
+    for (int i = this->samples.size(); --i >= 0;)
+    {
+        // The pool's own reference is the only one left
+        if (this->samples.getObjectPointerUnchecked(i)->getReferenceCount() == 1)
+        {
+            this->samples.remove(i);
+        }
+    }
+}
+
+BuiltInSynthSamplesPool::Statistics BuiltInSynthSamplesPool::getStatistics() const
+{
+    const ScopedLock lock(this->samplesLock);
+
+    Statistics stats = { 0, 0, 0, 0 };
+
+    for (auto sample : this->samples)
+    {
+        // Not counting the pool's own reference
+        const int numUsers = sample->getReferenceCount() - 1;
+        stats.numSamples++;
+        stats.numReferences += numUsers;
+        stats.bytesUsed += sample->getSizeInBytes();
+        stats.bytesSaved += sample->getSizeInBytes() * jmax(0, numUsers - 1);
+    }
+
+    return stats;
+}
@@ -0,0 +1,122 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A process-wide pool of decoded samples, shared between all built-in instrument instances.
+// Identical sources are decoded once and are kept while any sound references them.
+
+class BuiltInSynthSamplesPool
+{
+public:
+
+    static BuiltInSynthSamplesPool &getInstance()
+    {
+        static BuiltInSynthSamplesPool Instance;
+        return Instance;
+    }
+
+    class Sample : public ReferenceCountedObject
+    {
+    public:
+
+        typedef ReferenceCountedObjectPtr<Sample> Ptr;
+
+        Sample(uint64 key, AudioFormatReader &source, double maxLengthSeconds);
+
+        uint64 getKey() const noexcept
+        { return this->key; }
+
+        const AudioSampleBuffer &getData() const noexcept
+        { return this->data; }
+
+        double getSampleRate() const noexcept
+        { return this->sampleRate; }
+
+        // The number of valid samples, the buffer itself is a bit longer
+        // so that interpolating voices can safely read past the end
+        int getLength() const noexcept
+        { return this->length; }
+
+        // The length of the whole source, which is longer than the data
+        // when only the beginning of the sample is preloaded for streaming
+        int64 getSourceLength() const noexcept
+        { return this->sourceLength; }
+
+        int64 getSizeInBytes() const noexcept;
+
+    private:
+
+        const uint64 key;
+        AudioSampleBuffer data;
+        double sampleRate;
+        int length;
+        int64 sourceLength;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Sample)
+    };
+
+    struct Statistics
+    {
+        int numSamples;
+        int numReferences;
+        int64 bytesUsed;
+        int64 bytesSaved; // what all the references would take without sharing, minus bytesUsed
+    };
+
+    // Returns the shared decoded copy of the source, decoding it (or mapping the cached PCM)
+    // if nobody holds it yet. Returns nullptr if the source is not a valid sample.
+    // Might block for a while, so never call it from the audio thread.
+    Sample::Ptr getSample(const String &name,
+                          const void *sourceData,
+                          size_t sourceDataSize,
+                          double maxLengthSeconds);
+
+    // Unloads the samples that are not referenced by anyone except the pool;
+    // deallocates, so never call it from the audio thread (or from the sound's destructor,
+    // as the last reference to a sound might be released by a voice in the audio thread)
+    void purge();
+
+    Statistics getStatistics() const;
+
+private:
+
+    BuiltInSynthSamplesPool() {}
+
+    ReferenceCountedArray<Sample> samples;
+
+    // A placeholder for the sample being decoded right now
+    struct PendingSample : public ReferenceCountedObject
+    {
+        typedef ReferenceCountedObjectPtr<PendingSample> Ptr;
+
+        explicit PendingSample(uint64 key) :
+            key(key),
+            loaded(true) {}
+
+        const uint64 key;
+        Sample::Ptr result;
+        WaitableEvent loaded;
+    };
+
+    ReferenceCountedArray<PendingSample> pendingSamples;
+
+    CriticalSection samplesLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthSamplesPool)
+
+};
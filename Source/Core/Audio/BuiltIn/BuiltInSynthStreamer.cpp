@@ -0,0 +1,311 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "BuiltInSynthStreamer.h"
+
+#define STREAMING_READ_BLOCK_SIZE 4096
+#define STREAMING_IDLE_WAIT_MS 2
+#define STREAMING_SLEEP_WAIT_MS 1000
+#define STREAMING_NO_FILE -1
+
+//===----------------------------------------------------------------------===//
+// Stream
+//===----------------------------------------------------------------------===//
+
+BuiltInSynthStream::BuiltInSynthStream() :
+    fifo(BUILTIN_SYNTH_STREAMING_RING_SIZE),
+    requestedFileId(STREAMING_NO_FILE),
+    requestedStartFrame(0),
+    ringStartFrame(0),
+    nextFrameToRead(0),
+    readerFileId(STREAMING_NO_FILE)
+{
+    BuiltInSynthStreamer::getInstance().addStream(this);
+}
+
+BuiltInSynthStream::~BuiltInSynthStream()
+{
+    BuiltInSynthStreamer::getInstance().removeStream(this);
+}
+
+void BuiltInSynthStream::start(int fileId, int64 firstStreamedFrame) noexcept
+{
+    this->requestedFileId = fileId;
+    this->requestedStartFrame = firstStreamedFrame;
+    ++this->requestedGeneration;
+    BuiltInSynthStreamer::getInstance().notifyStreamRequested();
+}
+
+void BuiltInSynthStream::stop() noexcept
+{
+    this->requestedFileId = STREAMING_NO_FILE;
+    ++this->requestedGeneration;
+}
+
+bool BuiltInSynthStream::read(const AudioSampleBuffer &preloadedData,
+                              int64 firstFrame, int numFrames,
+                              float *destL, float *destR) noexcept
+{
+    // Preloaded part first
+    const int numPreloaded = preloadedData.getNumSamples();
+    const int numFromPreload = int(jlimit(int64(0), int64(numFrames), numPreloaded - firstFrame));
+
+    if (numFromPreload > 0)
+    {
+        const int rightChannel = jmin(1, preloadedData.getNumChannels() - 1);
+        FloatVectorOperations::copy(destL, preloadedData.getReadPointer(0, int(firstFrame)), numFromPreload);
+        FloatVectorOperations::copy(destR, preloadedData.getReadPointer(rightChannel, int(firstFrame)), numFromPreload);
+    }
+
+    const int numFromRing = numFrames - numFromPreload;
+
+    if (numFromRing <= 0)
+    {
+        return true;
+    }
+
+    destL += numFromPreload;
+    destR += numFromPreload;
+    const int64 firstRingFrame = firstFrame + numFromPreload;
+
+    const bool isPrepared = (this->preparedGeneration.get() == this->requestedGeneration.get());
+
+    if (isPrepared)
+    {
+        // Drop the frames the voice has already played
+        const int numToSkip = int(jmin(int64(this->fifo.getNumReady()), firstRingFrame - this->ringStartFrame));
+
+        if (numToSkip > 0)
+        {
+            this->fifo.finishedRead(numToSkip);
+            this->ringStartFrame += numToSkip;
+        }
+
+        if (this->ring != nullptr &&
+            this->ringStartFrame == firstRingFrame &&
+            this->fifo.getNumReady() >= numFromRing)
+        {
+            // Only peeking here, the frames are dropped when the voice moves past them
+            int start1, size1, start2, size2;
+            this->fifo.prepareToRead(numFromRing, start1, size1, start2, size2);
+
+            FloatVectorOperations::copy(destL, this->ring->getReadPointer(0, start1), size1);
+            FloatVectorOperations::copy(destR, this->ring->getReadPointer(1, start1), size1);
+
+            if (size2 > 0)
+            {
+                FloatVectorOperations::copy(destL + size1, this->ring->getReadPointer(0, start2), size2);
+                FloatVectorOperations::copy(destR + size1, this->ring->getReadPointer(1, start2), size2);
+            }
+
+            return true;
+        }
+    }
+
+    FloatVectorOperations::clear(destL, numFromRing);
+    FloatVectorOperations::clear(destR, numFromRing);
+    ++BuiltInSynthStreamer::getInstance().numUnderruns;
+    return false;
+}
+
+bool BuiltInSynthStream::fillRing(BuiltInSynthStreamer &streamer)
+{
+    const int generation = this->requestedGeneration.get();
+
+    if (generation != this->preparedGeneration.get())
+    {
+        const int fileId = this->requestedFileId.get();
+        const int64 startFrame = this->requestedStartFrame.get();
+
+        if (fileId != this->readerFileId)
+        {
+            this->reader = (fileId == STREAMING_NO_FILE) ? nullptr : streamer.createReaderFor(fileId);
+            this->readerFileId = fileId;
+        }
+
+        // The audio thread doesn't touch the ring until the generation is published
+        if (fileId == STREAMING_NO_FILE && this->ring != nullptr)
+        {
+            streamer.returnRing(this->ring.release());
+        }
+        else if (fileId != STREAMING_NO_FILE && this->ring == nullptr)
+        {
+            this->ring = streamer.takeRing();
+        }
+
+        this->fifo.reset();
+        this->ringStartFrame = startFrame;
+        this->nextFrameToRead = startFrame;
+
+        // Give the voice a head start before publishing
+        this->readNextBlock();
+
+        this->preparedGeneration = generation;
+        return true;
+    }
+
+    return this->readNextBlock();
+}
+
+bool BuiltInSynthStream::readNextBlock()
+{
+    if (this->reader == nullptr || this->ring == nullptr || this->readerFileId == STREAMING_NO_FILE)
+    {
+        return false;
+    }
+
+    const int numToRead = jmin(this->fifo.getFreeSpace(), STREAMING_READ_BLOCK_SIZE);
+
+    if (numToRead <= 0)
+    {
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    this->fifo.prepareToWrite(numToRead, start1, size1, start2, size2);
+
+    // Reading past the end of file just gives silence, which is fine,
+    // since the voice stops at the end of the sample anyway
+    this->reader->read(this->ring, start1, size1, this->nextFrameToRead, true, true);
+
+    if (size2 > 0)
+    {
+        this->reader->read(this->ring, start2, size2, this->nextFrameToRead + size1, true, true);
+    }
+
+    this->fifo.finishedWrite(size1 + size2);
+    this->nextFrameToRead += (size1 + size2);
+    return true;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Streamer
+//===----------------------------------------------------------------------===//
+
+BuiltInSynthStreamer::BuiltInSynthStreamer() :
+    thread("Helio Samples Streaming") {}
+
+BuiltInSynthStreamer::~BuiltInSynthStreamer()
+{
+    this->thread.removeTimeSliceClient(this);
+    this->thread.stopThread(500);
+}
+
+int BuiltInSynthStreamer::registerFile(const File &file)
+{
+    const ScopedLock lock(this->filesLock);
+
+    const int existingId = this->files.indexOf(file);
+
+    if (existingId >= 0)
+    {
+        return existingId;
+    }
+
+    this->files.add(file);
+    return this->files.size() - 1;
+}
+
+void BuiltInSynthStreamer::addStream(BuiltInSynthStream *stream)
+{
+    {
+        const ScopedLock lock(this->streamsLock);
+        this->streams.addIfNotAlreadyThere(stream);
+    }
+
+    // Streaming thread is only started when somebody actually needs it
+    if (! this->thread.isThreadRunning())
+    {
+        this->thread.addTimeSliceClient(this);
+        this->thread.startThread(9);
+    }
+}
+
+void BuiltInSynthStreamer::removeStream(BuiltInSynthStream *stream)
+{
+    const ScopedLock lock(this->streamsLock);
+    this->streams.removeFirstMatchingValue(stream);
+
+    // The streaming thread is not using the stream while the lock is held
+    if (stream->ring != nullptr)
+    {
+        this->freeRings.add(stream->ring.release());
+    }
+}
+
+AudioSampleBuffer *BuiltInSynthStreamer::takeRing()
+{
+    if (this->freeRings.size() > 0)
+    {
+        return this->freeRings.removeAndReturn(this->freeRings.size() - 1);
+    }
+
+    return new AudioSampleBuffer(2, BUILTIN_SYNTH_STREAMING_RING_SIZE);
+}
+
+void BuiltInSynthStreamer::returnRing(AudioSampleBuffer *ring)
+{
+    this->freeRings.add(ring);
+}
+
+void BuiltInSynthStreamer::notifyStreamRequested() const noexcept
+{
+    this->thread.notify();
+}
+
+AudioFormatReader *BuiltInSynthStreamer::createReaderFor(int fileId)
+{
+    File file;
+
+    {
+        const ScopedLock lock(this->filesLock);
+        file = this->files[fileId];
+    }
+
+    if (! file.existsAsFile())
+    {
+        return nullptr;
+    }
+
+    WavAudioFormat wav;
+    return wav.createReaderFor(new FileInputStream(file), true);
+}
+
+int BuiltInSynthStreamer::useTimeSlice()
+{
+    bool hasReadAnything = false;
+    bool hasActiveStreams = false;
+
+    const ScopedLock lock(this->streamsLock);
+
+    for (auto stream : this->streams)
+    {
+        hasReadAnything = stream->fillRing(*this) || hasReadAnything;
+        hasActiveStreams = hasActiveStreams || (stream->readerFileId != STREAMING_NO_FILE);
+    }
+
+    // Keep reading while there's something to read, poll the playing voices' rings,
+    // and sleep when nothing is playing, until a voice wakes the thread up
+    if (hasReadAnything)
+    {
+        return 0;
+    }
+
+    return hasActiveStreams ? STREAMING_IDLE_WAIT_MS : STREAMING_SLEEP_WAIT_MS;
+}
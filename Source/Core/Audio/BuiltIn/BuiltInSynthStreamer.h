@@ -0,0 +1,148 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Disk streaming for the built-in samplers.
+// Only the attack part of each sample is kept in memory (see BuiltInSynthSamplesPool),
+// the rest is read from a local file by a background thread into ring buffers, which are
+// taken from a shared pool when a voice starts streaming, and returned when it stops,
+// so that only the voices that are actually playing hold the memory.
+
+#define BUILTIN_SYNTH_STREAMING_PRELOAD_SECONDS 0.5
+#define BUILTIN_SYNTH_STREAMING_RING_SIZE 32768
+
+class BuiltInSynthStreamer;
+
+class BuiltInSynthStream
+{
+public:
+
+    BuiltInSynthStream();
+
+    ~BuiltInSynthStream();
+
+    //===------------------------------------------------------------------===//
+    // Audio thread
+    //===------------------------------------------------------------------===//
+
+    // Asks the streaming thread to start reading the file from the given frame,
+    // never blocks, the ring becomes available a couple of milliseconds later
+    void start(int fileId, int64 firstStreamedFrame) noexcept;
+
+    void stop() noexcept;
+
+    // Fills the destination with the source frames [firstFrame, firstFrame + numFrames),
+    // taking them from the preloaded data where possible, and from the ring otherwise.
+    // Frames that are not streamed yet are zeroed, and that is counted as an underrun.
+    // Returns false on underrun.
+    bool read(const AudioSampleBuffer &preloadedData,
+              int64 firstFrame, int numFrames,
+              float *destL, float *destR) noexcept;
+
+private:
+
+    friend class BuiltInSynthStreamer;
+
+    //===------------------------------------------------------------------===//
+    // Streaming thread
+    //===------------------------------------------------------------------===//
+
+    // Returns true if anything has been read
+    bool fillRing(BuiltInSynthStreamer &streamer);
+
+    bool readNextBlock();
+
+    AbstractFifo fifo;
+
+    // Taken from the streamer's pool and returned by the streaming thread only,
+    // the audio thread doesn't touch it until the generation is published
+    ScopedPointer<AudioSampleBuffer> ring;
+
+    // Written by the audio thread, then published by bumping the generation;
+    // the streaming thread might read the newer values with the older generation,
+    // which is harmless, since the newer generation will be prepared again anyway
+    Atomic<int> requestedFileId;
+    Atomic<int64> requestedStartFrame;
+    Atomic<int> requestedGeneration;
+
+    // Written by the streaming thread before the generation is published
+    Atomic<int> preparedGeneration;
+    int64 ringStartFrame;       // the first frame in the ring, owned by the audio thread once prepared
+    int64 nextFrameToRead;      // owned by the streaming thread
+
+    int readerFileId;
+    ScopedPointer<AudioFormatReader> reader;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthStream)
+};
+
+class BuiltInSynthStreamer : private TimeSliceClient
+{
+public:
+
+    static BuiltInSynthStreamer &getInstance()
+    {
+        static BuiltInSynthStreamer Instance;
+        return Instance;
+    }
+
+    // Returns an id to pass to the streams; thread-safe,
+    // but takes a lock, so never call it from the audio thread
+    int registerFile(const File &file);
+
+    void addStream(BuiltInSynthStream *stream);
+
+    void removeStream(BuiltInSynthStream *stream);
+
+    int getNumUnderruns() const noexcept
+    { return this->numUnderruns.get(); }
+
+private:
+
+    friend class BuiltInSynthStream;
+
+    BuiltInSynthStreamer();
+
+    ~BuiltInSynthStreamer();
+
+    int useTimeSlice() override;
+
+    AudioFormatReader *createReaderFor(int fileId);
+
+    // Streaming thread, with the streams lock held
+    AudioSampleBuffer *takeRing();
+    void returnRing(AudioSampleBuffer *ring);
+
+    // Audio thread: wakes up the streaming thread, which sleeps while there's nothing to stream
+    void notifyStreamRequested() const noexcept;
+
+    TimeSliceThread thread;
+
+    Array<File> files;
+    CriticalSection filesLock;
+
+    Array<BuiltInSynthStream *> streams;
+    CriticalSection streamsLock;
+
+    // Guarded by the streams lock as well
+    OwnedArray<AudioSampleBuffer> freeRings;
+
+    Atomic<int> numUnderruns;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuiltInSynthStreamer)
+};
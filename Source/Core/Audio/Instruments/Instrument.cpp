@@ -24,19 +24,226 @@
 
 const int Instrument::midiChannelNumber = 0x1000;
 
-Instrument::Instrument(AudioPluginFormatManager &formatManager, String name) :
+// How often the changed plugins' states are re-captured in background
+#define INSTRUMENT_STATE_CAPTURE_INTERVAL_MS 3000
+#define INSTRUMENT_STATE_CAPTURE_POLL_MS 20
+
+// Capturing the plugins' state is what takes most of the time on saving a project
+// (sample libraries, wavetables and so on), and that can be done in background,
+// unless the format is known to want the message thread
+static bool canAccessStateInBackground(AudioPluginFormatManager &formatManager,
+                                        const PluginDescription &pd)
+{
+    for (int i = 0; i < formatManager.getNumFormats(); ++i)
+    {
+        AudioPluginFormat *format = formatManager.getFormat(i);
+
+        if (format->getName() == pd.pluginFormatName)
+        {
+            return ! format->requiresUnblockedMessageThreadDuringCreation(pd) &&
+                   format->getName() != "AudioUnit";
+        }
+    }
+
+    return false;
+}
+
+//===----------------------------------------------------------------------===//
+// NodeStateWatcher
+//===----------------------------------------------------------------------===//
+
+// Holds the last captured state of a node, and marks it dirty
+// as soon as the plugin reports any change of parameters or state
+class Instrument::NodeStateWatcher :
+    public ReferenceCountedObject,
+    private AudioProcessorListener
+{
+public:
+
+    typedef ReferenceCountedObjectPtr<NodeStateWatcher> Ptr;
+
+    NodeStateWatcher(AudioProcessorGraph::Node *targetNode,
+                     const String &knownState,
+                     bool canCaptureInBackground) :
+        node(targetNode),
+        backgroundCaptureAllowed(canCaptureInBackground),
+        state(knownState),
+        stateVersion(0),
+        hadOpenWindow(false)
+    {
+        this->isDirty = knownState.isEmpty() ? 1 : 0;
+        this->node->getProcessor()->addListener(this);
+    }
+
+    ~NodeStateWatcher() override
+    {
+        this->node->getProcessor()->removeListener(this);
+    }
+
+    AudioProcessorGraph::Node *getNode() const noexcept
+    { return this->node; }
+
+    bool canCaptureInBackground() const noexcept
+    { return this->backgroundCaptureAllowed; }
+
+    // Only the changes reported by the plugin count here
+    bool needsCapture() const
+    {
+        return this->isDirty.get() != 0;
+    }
+
+    // Not every plugin reports the changes made in its editor,
+    // so closing the editor marks the state dirty once; message thread only
+    void checkEditorWindow()
+    {
+        const bool hasOpenWindow = PluginWindow::hasOpenWindowFor(this->node);
+
+        if (this->hadOpenWindow && ! hasOpenWindow)
+        {
+            this->isDirty = 1;
+        }
+
+        this->hadOpenWindow = hasOpenWindow;
+    }
+
+    bool hasOpenEditorWindow() const
+    {
+        return PluginWindow::hasOpenWindowFor(this->node);
+    }
+
+    // Can be called from any thread; of the concurrent captures,
+    // the one started last wins, whichever of them finishes first
+    void capture()
+    {
+        const int version = ++this->lastStartedVersion;
+        this->isDirty = 0;
+
+        MemoryBlock m;
+        this->node->getProcessor()->getStateInformation(m);
+        const String encodedState(m.toBase64Encoding());
+
+        const ScopedLock lock(this->stateLock);
+
+        if (version > this->stateVersion)
+        {
+            this->state = encodedState;
+            this->stateVersion = version;
+        }
+    }
+
+    String getState() const
+    {
+        const ScopedLock lock(this->stateLock);
+        return this->state;
+    }
+
+    void onBackgroundCaptureFinished()
+    {
+        this->isCapturing = 0;
+        this->captureFinished.signal();
+    }
+
+    void waitForBackgroundCapture()
+    {
+        while (this->isCapturing.get() != 0)
+        {
+            this->captureFinished.wait(INSTRUMENT_STATE_CAPTURE_POLL_MS);
+        }
+    }
+
+    // Only one background capture per node at a time
+    Atomic<int> isCapturing;
+
+private:
+
+    // Might be called from the audio thread, so only the flag is set here
+    void audioProcessorParameterChanged(AudioProcessor *, int, float) override
+    { this->isDirty = 1; }
+
+    void audioProcessorChanged(AudioProcessor *) override
+    { this->isDirty = 1; }
+
+    const AudioProcessorGraph::Node::Ptr node;
+    const bool backgroundCaptureAllowed;
+
+    Atomic<int> isDirty;
+    Atomic<int> lastStartedVersion;
+
+    String state;
+    int stateVersion;
+    CriticalSection stateLock;
+
+    WaitableEvent captureFinished;
+    bool hadOpenWindow;
+
+    JUCE_DECLARE_NON_COPYABLE(NodeStateWatcher)
+};
+
+//===----------------------------------------------------------------------===//
+// StateCaptureJob
+//===----------------------------------------------------------------------===//
+
+class Instrument::StateCaptureJob : public ThreadPoolJob
+{
+public:
+
+    explicit StateCaptureJob(NodeStateWatcher *targetWatcher) :
+        ThreadPoolJob("Plugin state capture"),
+        watcher(targetWatcher) {}
+
+    JobStatus runJob() override
+    {
+        this->watcher->capture();
+        this->watcher->onBackgroundCaptureFinished();
+
+        // The watcher might be the last one holding the node, which then
+        // should be deleted on the message thread, as plugins expect it
+        ScopedPointer<ReleaseMessage> message(new ReleaseMessage());
+        message->watcher = this->watcher;
+        this->watcher = nullptr;
+        message.release()->post();
+
+        return jobHasFinished;
+    }
+
+private:
+
+    struct ReleaseMessage : public CallbackMessage
+    {
+        void messageCallback() override {}
+        NodeStateWatcher::Ptr watcher;
+    };
+
+    NodeStateWatcher::Ptr watcher;
+
+    JUCE_DECLARE_NON_COPYABLE(StateCaptureJob)
+};
+
+
+//===----------------------------------------------------------------------===//
+// Instrument
+//===----------------------------------------------------------------------===//
+
+Instrument::Instrument(AudioPluginFormatManager &formatManager, ThreadPool &loadingPool, String name) :
     formatManager(formatManager),
+    loadingPool(loadingPool),
     instrumentName(std::move(name)),
     lastUID(0),
+    loadingStartTime(0.0),
+    loadingGeneration(0),
     instrumentID()
 {
     this->processorGraph = new AudioProcessorGraph();
     this->initializeDefaultNodes();
     this->processorPlayer.setProcessor(this->processorGraph);
+
+    this->startTimer(INSTRUMENT_STATE_CAPTURE_INTERVAL_MS);
 }
 
 Instrument::~Instrument()
 {
+    this->stopTimer();
+    this->stateWatchers.clear();
     this->masterReference.clear();
     this->processorPlayer.setProcessor(nullptr);
     
@@ -91,10 +298,31 @@ String Instrument::getIdAndHash() const
     return this->getInstrumentID() + this->getInstrumentHash();
 }
 
+bool Instrument::isReady() const noexcept
+{
+    return this->numNodesLoading.get() <= 0;
+}
+
+void Instrument::onNodeLoaded(int generation)
+{
+    // A late callback from the previous deserialization
+    if (generation != this->loadingGeneration || this->numNodesLoading.get() <= 0)
+    {
+        return;
+    }
+
+    if (--this->numNodesLoading == 0)
+    {
+        Logger::writeToLog("Instrument " + this->instrumentName + " is ready in " +
+                           String(int(Time::getMillisecondCounterHiRes() - this->loadingStartTime)) + " ms");
+    }
+}
+
 
 void Instrument::initializeFrom(const PluginDescription &pluginDescription)
 {
     this->processorGraph->clear();
+    this->stateWatchers.clear();
     this->initializeDefaultNodes();
     
     this->addNodeAsync(pluginDescription, 0.5f, 0.5f, [&](AudioProcessorGraph::Node *instrument)
@@ -215,6 +443,7 @@ void Instrument::removeNode(const uint32 id)
 {
     PluginWindow::closeCurrentlyOpenWindowsFor(id);
     this->processorGraph->removeNode(id);
+    this->updateStateWatchers();
     this->sendChangeMessage();
 }
 
@@ -350,12 +579,115 @@ void Instrument::removeConnection(uint32 sourceFilterUID, int sourceFilterChanne
 
 void Instrument::reset()
 {
+    // The nodes still being created are not needed anymore
+    ++this->loadingGeneration;
+    this->numNodesLoading = 0;
+
     PluginWindow::closeAllCurrentlyOpenWindows();
     this->processorGraph->clear();
+    this->stateWatchers.clear();
     this->sendChangeMessage();
 }
 
 
+//===----------------------------------------------------------------------===//
+// Plugins' states cache
+//===----------------------------------------------------------------------===//
+
+Instrument::NodeStateWatcher *Instrument::findStateWatcher(const AudioProcessorGraph::Node *node) const
+{
+    for (auto watcher : this->stateWatchers)
+    {
+        if (watcher->getNode() == node)
+        {
+            return watcher;
+        }
+    }
+
+    return nullptr;
+}
+
+void Instrument::watchNodeState(AudioProcessorGraph::Node *node, const String &knownState) const
+{
+    if (node == nullptr || this->findStateWatcher(node) != nullptr)
+    {
+        return;
+    }
+
+    bool canCaptureInBackground = false;
+
+    if (AudioPluginInstance *plugin = dynamic_cast<AudioPluginInstance *>(node->getProcessor()))
+    {
+        PluginDescription pd;
+        plugin->fillInPluginDescription(pd);
+        canCaptureInBackground = canAccessStateInBackground(this->formatManager, pd);
+    }
+
+    this->stateWatchers.add(new NodeStateWatcher(node, knownState, canCaptureInBackground));
+}
+
+void Instrument::updateStateWatchers() const
+{
+    for (int i = this->stateWatchers.size(); --i >= 0;)
+    {
+        const AudioProcessorGraph::Node *node = this->stateWatchers.getUnchecked(i)->getNode();
+
+        if (this->processorGraph->getNodeForId(node->nodeId) != node)
+        {
+            this->stateWatchers.remove(i);
+        }
+    }
+
+    const int numNodes = this->processorGraph->getNumNodes();
+
+    for (int i = 0; i < numNodes; ++i)
+    {
+        this->watchNodeState(this->processorGraph->getNode(i), String());
+    }
+}
+
+String Instrument::getNodeState(AudioProcessorGraph::Node *node) const
+{
+    this->watchNodeState(node, String());
+    NodeStateWatcher *watcher = this->findStateWatcher(node);
+
+    // Its result is up to date, unless anything has changed since it has started,
+    // which makes the watcher dirty again
+    watcher->waitForBackgroundCapture();
+
+    // The editor might have changed something without telling
+    if (watcher->needsCapture() || watcher->hasOpenEditorWindow())
+    {
+        watcher->capture();
+    }
+
+    return watcher->getState();
+}
+
+void Instrument::timerCallback()
+{
+    if (! this->isReady())
+    {
+        return;
+    }
+
+    this->updateStateWatchers();
+
+    for (auto watcher : this->stateWatchers)
+    {
+        watcher->checkEditorWindow();
+
+        if (watcher->canCaptureInBackground() &&
+            watcher->isCapturing.get() == 0 &&
+            watcher->needsCapture())
+        {
+            watcher->isCapturing = 1;
+            this->loadingPool.addJob(new StateCaptureJob(watcher), true);
+        }
+    }
+}
+
+
 //===----------------------------------------------------------------------===//
 // Serializable
 //===----------------------------------------------------------------------===//
@@ -426,9 +758,21 @@ void Instrument::deserialize(const XmlElement &xml)
         });
     }
     
+    int numNodes = 0;
+    forEachXmlChildElementWithTagName(*mainSlot, e, Serialization::Core::instrumentNode)
+    {
+        ++numNodes;
+    }
+
+    // Plugins are created asynchronously, so the instrument gets ready
+    // when the last one of its nodes is in the graph, not the last one requested
+    const int generation = this->loadingGeneration;
+    this->numNodesLoading = numNodes;
+    this->loadingStartTime = Time::getMillisecondCounterHiRes();
+
     forEachXmlChildElementWithTagName(*mainSlot, e, Serialization::Core::instrumentNode)
     {
-        this->createNodeFromXmlAsync(*e, [this, connectionDescriptions](AudioProcessorGraph::Node *)
+        this->createNodeFromXmlAsync(*e, [this, connectionDescriptions, generation](AudioProcessorGraph::Node *)
                                      {
                                          // Try to create as many connections as possible
                                          for (const auto &connectionInfo : connectionDescriptions)
@@ -438,6 +782,7 @@ void Instrument::deserialize(const XmlElement &xml)
                                          }
                                          
                                          this->processorGraph->removeIllegalConnections();
+                                         this->onNodeLoaded(generation);
                                          this->sendChangeMessage();
                                      });
     }
@@ -473,10 +818,7 @@ XmlElement *Instrument::createNodeXml(AudioProcessorGraph::Node *const node) con
         e->addChildElement(pd.createXml());
 
         auto state = new XmlElement(Serialization::Core::pluginState);
-
-        MemoryBlock m;
-        node->getProcessor()->getStateInformation(m);
-        state->addTextElement(m.toBase64Encoding());
+        state->addTextElement(this->getNodeState(node));
         e->addChildElement(state);
 
         return e;
@@ -497,10 +839,12 @@ void Instrument::createNodeFromXmlAsync(const XmlElement &xml,
     }
     
     MemoryBlock nodeStateBlock;
+    String encodedState;
     const XmlElement *const state = xml.getChildByName(Serialization::Core::pluginState);
     if (state != nullptr)
     {
-        nodeStateBlock.fromBase64Encoding(state->getAllSubText());
+        encodedState = state->getAllSubText();
+        nodeStateBlock.fromBase64Encoding(encodedState);
     }
     
     const uint32 nodeUid = xml.getIntAttribute("uid");
@@ -509,29 +853,41 @@ void Instrument::createNodeFromXmlAsync(const XmlElement &xml,
     const double nodeY = xml.getDoubleAttribute("y");
     const double nodeLastX = xml.getDoubleAttribute("uiLastX");
     const double nodeLastY = xml.getDoubleAttribute("uiLastY");
+    const int generation = this->loadingGeneration;
     
     formatManager.
     createPluginInstanceAsync(pd,
                               this->processorGraph->getSampleRate(),
                               this->processorGraph->getBlockSize(),
-                              [this, nodeStateBlock, nodeUid, nodeHash, nodeX, nodeY, nodeLastX, nodeLastY, f]
+                              [this, nodeStateBlock, encodedState, nodeUid, nodeHash, nodeX, nodeY, nodeLastX, nodeLastY, generation, f]
                               (AudioPluginInstance *instance, const String &error)
                               {
+                                  // The instrument has been reset or deserialized again meanwhile
+                                  if (generation != this->loadingGeneration)
+                                  {
+                                      delete instance;
+                                      return;
+                                  }
+                                  
                                   if (instance == nullptr)
                                   {
                                       f(nullptr);
                                       return;
                                   }
                                   
-                                  AudioProcessorGraph::Node::Ptr node(this->processorGraph->addNode(instance, nodeUid));
-                                  
+                                  // Restoring on the message thread, as plugins expect it;
+                                  // the playback doesn't wait for this, the instrument just stays silent
                                   if (nodeStateBlock.getSize() > 0)
                                   {
-                                      node->getProcessor()->
-                                      setStateInformation(nodeStateBlock.getData(),
-                                                          static_cast<int>(nodeStateBlock.getSize()));
+                                      instance->setStateInformation(nodeStateBlock.getData(),
+                                                                    static_cast<int>(nodeStateBlock.getSize()));
                                   }
                                   
+                                  AudioProcessorGraph::Node::Ptr node(this->processorGraph->addNode(instance, nodeUid));
+                                  
+                                  // Nothing has changed since the project was saved
+                                  this->watchNodeState(node, encodedState);
+                                  
                                   Uuid fallbackRandomHash;
                                   node->properties.set("x", nodeX);
                                   node->properties.set("y", nodeY);
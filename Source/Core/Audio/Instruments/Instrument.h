@@ -25,11 +25,12 @@ class Instrument;
 
 class Instrument :
     public Serializable,
-    public ChangeBroadcaster // уведомляет InstrumentEditorPanel
+    public ChangeBroadcaster, // уведомляет InstrumentEditorPanel
+    private Timer
 {
 public:
 
-    Instrument(AudioPluginFormatManager &formatManager, String name);
+    Instrument(AudioPluginFormatManager &formatManager, ThreadPool &loadingPool, String name);
 
     ~Instrument() override;
 
@@ -38,6 +39,11 @@ public:
     void setName(const String &name);
 
     String getIdAndHash() const; // эта строчка назначается слоям
+
+    // False while the deserialized nodes are still being created and restored;
+    // a change message is sent as each of them gets into the graph.
+    // Safe to call from any thread
+    bool isReady() const noexcept;
     
     
     void initializeFrom(const PluginDescription &pluginDescription);
@@ -168,6 +174,41 @@ private:
 
     AudioPluginFormatManager &formatManager;
 
+    // Shared by all instruments, see AudioCore
+    ThreadPool &loadingPool;
+
+    Atomic<int> numNodesLoading;
+    double loadingStartTime;
+
+    // Bumped on every reset, so that the nodes requested before are dropped,
+    // and don't count towards the readiness; message thread only
+    int loadingGeneration;
+
+    void onNodeLoaded(int generation);
+
+    //===------------------------------------------------------------------===//
+    // Plugins' states cache
+    //===------------------------------------------------------------------===//
+
+    // Each plugin's state is kept as of the last capture, so that saving
+    // doesn't need to ask the unchanged plugins for megabytes of their states;
+    // changed ones are re-captured in background, where the format allows
+    class NodeStateWatcher;
+    class StateCaptureJob;
+
+    mutable ReferenceCountedArray<NodeStateWatcher> stateWatchers;
+
+    NodeStateWatcher *findStateWatcher(const AudioProcessorGraph::Node *node) const;
+
+    void watchNodeState(AudioProcessorGraph::Node *node, const String &knownState) const;
+
+    // Adds the watchers for new nodes and forgets the removed ones
+    void updateStateWatchers() const;
+
+    String getNodeState(AudioProcessorGraph::Node *node) const;
+
+    void timerCallback() override;
+
     AudioProcessorPlayer processorPlayer;
 
     ScopedPointer<AudioProcessorGraph> processorGraph;
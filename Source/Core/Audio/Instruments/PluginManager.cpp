@@ -17,7 +17,6 @@
 
 #include "Common.h"
 #include "PluginManager.h"
-#include "DataEncoder.h"
 #include "AudioCore.h"
 #include "FileUtils.h"
 #include "Config.h"
@@ -29,10 +28,12 @@
 PluginManager::PluginManager() :
 Thread("Plugin Scanner Thread"),
 working(false),
-usingExternalProcess(false)
+usingExternalProcess(false),
+lastScanTimeMs(0)
 {
     this->startThread(0);
     Config::load(Serialization::Core::pluginManager, this);
+    Config::load(Serialization::Core::pluginScanCache, &this->scanCache);
 }
 
 PluginManager::~PluginManager()
@@ -44,8 +45,20 @@ PluginManager::~PluginManager()
 
 void PluginManager::removeListItem(int index)
 {
-    const ScopedWriteLock lock(this->pluginsListLock);
-    return this->pluginsList.removeType(index);
+    {
+        const ScopedWriteLock lock(this->pluginsListLock);
+
+        if (const PluginDescription *type = this->pluginsList.getType(index))
+        {
+            // Not a blacklist: the next scan (which is always started by user)
+            // or adding its folder will probe the file again and bring it back
+            this->scanCache.update(type->fileOrIdentifier, PluginScanCache::removedByUser, 0);
+        }
+
+        this->pluginsList.removeType(index);
+    }
+
+    Config::save(Serialization::Core::pluginScanCache, &this->scanCache);
 }
 
 const KnownPluginList &PluginManager::getList()
@@ -72,6 +85,11 @@ bool PluginManager::isWorking() const
     return this->working;
 }
 
+double PluginManager::getLastScanTimeMs() const noexcept
+{
+    return double(this->lastScanTimeMs.get());
+}
+
 
 
 void PluginManager::runInitialScan()
@@ -88,40 +106,69 @@ void PluginManager::runInitialScan()
     
     FileSearchPath pathToScan = this->getTypicalFolders();
 
+    StringArray allFiles;
+    //allFiles.add(BuiltInSynth::sineId); // add built-in synths
+    allFiles.add(BuiltInSynth::pianoId); // add built-in synths
+
+    // проверить на валидность все имеющиеся плагины
+    for (auto & it : this->getList())
     {
-        ScopedWriteLock filesLock(this->filesListLock);
-        //this->filesToScan.addIfNotAlreadyThere(BuiltInSynth::sineId); // add built-in synths
-        this->filesToScan.addIfNotAlreadyThere(BuiltInSynth::pianoId); // add built-in synths
+        const String &fileOrIdentifier = it->fileOrIdentifier;
 
-        // проверить на валидность все имеющиеся плагины
-        for (auto & it : this->getList())
+        if (! File::isAbsolutePath(fileOrIdentifier) || File(fileOrIdentifier).exists())
         {
-            this->filesToScan.addIfNotAlreadyThere(it->fileOrIdentifier);
+            allFiles.addIfNotAlreadyThere(fileOrIdentifier);
         }
+    }
 
+    AudioPluginFormatManager formatManager;
+    AudioCore::initAudioFormats(formatManager);
+
+    for (int i = 0; i < formatManager.getNumFormats(); ++i)
+    {
+        AudioPluginFormat *format = formatManager.getFormat(i);
+        FileSearchPath defaultLocations = format->getDefaultLocationsToSearch();
+
+        for (int j = 0; j < defaultLocations.getNumPaths(); ++j)
         {
-            const ScopedWriteLock pluginsLock(this->pluginsListLock);
-            this->pluginsList.clear();
+            pathToScan.addIfNotAlreadyThere(defaultLocations[j]);
         }
 
-        AudioPluginFormatManager formatManager;
-        AudioCore::initAudioFormats(formatManager);
+        StringArray foundPlugins = format->searchPathsForPlugins(pathToScan, true, true);
+        allFiles.addArray(foundPlugins);
+    }
 
-        for (int i = 0; i < formatManager.getNumFormats(); ++i)
+    allFiles.removeDuplicates(false);
+
+    const StringArray filesToProbe(this->getFilesToProbe(allFiles));
+
+    {
+        // Only keeping the types of the files that are unchanged and still there
+        const ScopedWriteLock pluginsLock(this->pluginsListLock);
+
+        for (int i = this->pluginsList.getNumTypes(); --i >= 0;)
         {
-            AudioPluginFormat *format = formatManager.getFormat(i);
-            FileSearchPath defaultLocations = format->getDefaultLocationsToSearch();
+            const String &fileOrIdentifier = this->pluginsList.getType(i)->fileOrIdentifier;
 
-            for (int j = 0; j < defaultLocations.getNumPaths(); ++j)
+            if (filesToProbe.contains(fileOrIdentifier) || ! allFiles.contains(fileOrIdentifier))
             {
-                pathToScan.addIfNotAlreadyThere(defaultLocations[j]);
+                this->pluginsList.removeType(i);
             }
-
-            StringArray foundPlugins = format->searchPathsForPlugins(pathToScan, true, true);
-            this->filesToScan.addArray(foundPlugins);
         }
     }
 
+    this->scanCache.removeAllExcept(allFiles);
+
+    Logger::writeToLog("Found " + String(allFiles.size()) + " plugin files, " +
+                       String(filesToProbe.size()) + " of them are new or changed");
+
+    {
+        ScopedWriteLock filesLock(this->filesListLock);
+        this->filesToScan.addArray(filesToProbe);
+        this->filesToScan.removeDuplicates(false);
+    }
+
+    this->sendChangeMessage();
     this->signal();
 }
 
@@ -155,8 +202,10 @@ void PluginManager::scanFolderAndAddResults(const File &dir)
         {
             AudioPluginFormat *format = formatManager.getFormat(i);
             StringArray foundPlugins = format->searchPathsForPlugins(pathToScan, true);
-            this->filesToScan.addArray(foundPlugins);
+            this->filesToScan.addArray(this->getFilesToProbe(foundPlugins));
         }
+
+        this->filesToScan.removeDuplicates(false);
     }
 
     this->signal();
@@ -182,59 +231,22 @@ void PluginManager::run()
         }
         
         StringArray uncheckedList = this->getFilesToScan();
+        const uint32 scanStartTime = Time::getMillisecondCounter();
 
         try
         {
-            for (const auto & i : uncheckedList)
+            if (this->usingExternalProcess)
             {
-                Logger::writeToLog(i);
-                if (this->usingExternalProcess)
-                {
-                    const Uuid tempFileName;
-                    const File tempFile(FileUtils::getTempSlot(tempFileName.toString()));
-                    tempFile.replaceWithText(i);
-                    
-                    const String myself = File::getSpecialLocation(File::currentExecutableFile).getFullPathName();
-                    
-                    ChildProcess checkerProcess;
-                    String commandLine(myself + " " + tempFileName.toString());
-                    checkerProcess.start(commandLine);
-                    
-                    if (!checkerProcess.waitForProcessToFinish(3000))
-                    {
-                        checkerProcess.kill();
-                    }
-                    else
-                    {
-                        if (tempFile.existsAsFile())
-                        {
-                            try
-                            {
-                                ScopedPointer<XmlElement> xml(DataEncoder::loadObfuscated(tempFile));
-                                
-                                // todo as Serialization::Core::smartPluginDescription
-                                if (xml)
-                                {
-                                    forEachXmlChildElementWithTagName(*xml, e, "PLUGIN")
-                                    {
-                                        const ScopedWriteLock lock(this->pluginsListLock);
-                                        PluginDescription pluginDescription;
-                                        pluginDescription.loadFromXml(*e);
-                                        this->pluginsList.addType(pluginDescription);
-                                    }
-                                    
-                                    this->sendChangeMessage();
-                                }
-                            }
-                            catch (...)
-                            { }
-                        }
-                    }
-                    
-                    tempFile.deleteFile();
-                }
-                else
+                // Scans in parallel, the results come back in the order they are ready
+                PluginScanner scanner;
+                scanner.scan(uncheckedList, *this, *this);
+            }
+            else
+            {
+                for (const auto & i : uncheckedList)
                 {
+                    Logger::writeToLog(i);
+
                     const String pluginPath(i);
                     //const File pluginFile(pluginPath);
                     
@@ -261,21 +273,30 @@ void PluginManager::run()
                         }
                     }
                     
+                    this->scanCache.update(pluginPath, PluginScanCache::scanned, typesFound.size());
                     this->sendChangeMessage();
-                    Thread::sleep(150);
                 }
             }
 
+            {
+                ScopedWriteLock lock(this->filesListLock);
+                this->filesToScan.removeStrings(uncheckedList);
+            }
+
             Config::save(Serialization::Core::pluginManager, this);
+            Config::save(Serialization::Core::pluginScanCache, &this->scanCache);
             Supervisor::track(Serialization::Activities::scanPlugins);
         }
         catch (...) { }
 
+        this->lastScanTimeMs = int(Time::getMillisecondCounter() - scanStartTime);
+
         {
             ScopedWriteLock lock(this->workingFlagLock);
             this->working = false;
             
-            Logger::writeToLog("Done scanning for audio plugins");
+            Logger::writeToLog("Done scanning for audio plugins, " + String(uncheckedList.size()) +
+                               " files in " + String(this->getLastScanTimeMs() / 1000.0, 2) + "s");
             this->sendChangeMessage();
         }
         
@@ -284,6 +305,93 @@ void PluginManager::run()
 }
 
 
+//===----------------------------------------------------------------------===//
+// PluginScanner::Listener
+//===----------------------------------------------------------------------===//
+
+void PluginManager::pluginScanned(const String &fileOrIdentifier,
+                                  const Array<PluginDescription> &typesFound)
+{
+    this->scanCache.update(fileOrIdentifier, PluginScanCache::scanned, typesFound.size());
+
+    if (typesFound.size() != 0)
+    {
+        const ScopedWriteLock lock(this->pluginsListLock);
+
+        for (const auto &type : typesFound)
+        {
+            this->pluginsList.addType(type);
+        }
+    }
+
+    this->sendChangeMessage();
+}
+
+void PluginManager::pluginScanFailed(const String &fileOrIdentifier)
+{
+    // Won't be probed again until the file changes
+    this->scanCache.update(fileOrIdentifier, PluginScanCache::failed, 0);
+    this->sendChangeMessage();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Scan cache
+//===----------------------------------------------------------------------===//
+
+bool PluginManager::isScannedAndUpToDate(const String &fileOrIdentifier)
+{
+    PluginScanCache::Status status;
+    int numTypes = 0;
+
+    if (! this->scanCache.isUpToDate(fileOrIdentifier, status, numTypes))
+    {
+        return false;
+    }
+
+    // Crashed ones are skipped as long as they don't change
+    if (status == PluginScanCache::failed)
+    {
+        return true;
+    }
+
+    // Removed ones are only hidden until user asks to scan again
+    if (status == PluginScanCache::removedByUser)
+    {
+        return false;
+    }
+
+    // The list might have lost some types, if the settings were reset
+    const ScopedReadLock lock(this->pluginsListLock);
+    int numKnownTypes = 0;
+
+    for (int i = 0; i < this->pluginsList.getNumTypes(); ++i)
+    {
+        if (this->pluginsList.getType(i)->fileOrIdentifier == fileOrIdentifier)
+        {
+            ++numKnownTypes;
+        }
+    }
+
+    return numKnownTypes >= numTypes;
+}
+
+StringArray PluginManager::getFilesToProbe(const StringArray &allFiles)
+{
+    StringArray result;
+
+    for (const auto &file : allFiles)
+    {
+        if (! this->isScannedAndUpToDate(file))
+        {
+            result.add(file);
+        }
+    }
+
+    return result;
+}
+
+
 FileSearchPath PluginManager::getTypicalFolders()
 {
     FileSearchPath folders;
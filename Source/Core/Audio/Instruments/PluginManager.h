@@ -18,12 +18,15 @@
 #pragma once
 
 #include "Serializable.h"
+#include "PluginScanner.h"
+#include "PluginScanCache.h"
 
 class PluginManager :
     public Serializable,
     public Thread,
     public WaitableEvent, // засыпает после поиска
-    public ChangeBroadcaster // оповещает о том, что найден новый плагин
+    public ChangeBroadcaster, // оповещает о том, что найден новый плагин
+    private PluginScanner::Listener
 {
 public:
 
@@ -34,6 +37,9 @@ public:
     
     bool isWorking() const;
 
+    // How long the last complete scan took
+    double getLastScanTimeMs() const noexcept;
+
     void removeListItem(int index);
 
     const KnownPluginList &getList();
@@ -64,12 +70,30 @@ public:
 
     void reset() override;
 
+private:
+
+    //===------------------------------------------------------------------===//
+    // PluginScanner::Listener
+    //===------------------------------------------------------------------===//
+
+    void pluginScanned(const String &fileOrIdentifier,
+                       const Array<PluginDescription> &typesFound) override;
+
+    void pluginScanFailed(const String &fileOrIdentifier) override;
+
 private:
 
     ReadWriteLock pluginsListLock;
 
     KnownPluginList pluginsList;
 
+    PluginScanCache scanCache;
+
+    // False for the files that have to be probed (again)
+    bool isScannedAndUpToDate(const String &fileOrIdentifier);
+
+    StringArray getFilesToProbe(const StringArray &allFiles);
+
 
     ReadWriteLock filesListLock;
 
@@ -82,6 +106,8 @@ private:
     
     bool usingExternalProcess;
 
+    Atomic<int> lastScanTimeMs;
+
     
     FileSearchPath getTypicalFolders();
 
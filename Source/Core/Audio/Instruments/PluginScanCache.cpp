@@ -0,0 +1,193 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "PluginScanCache.h"
+#include "SerializationKeys.h"
+
+// Enough to tell apart two builds with the same size and date
+#define SCAN_CACHE_HASHED_PREFIX_SIZE 16384
+
+PluginScanCache::PluginScanCache() {}
+
+bool PluginScanCache::Entry::hasSameIdentity(const Entry &other) const noexcept
+{
+    return this->size == other.size &&
+           this->modificationTime == other.modificationTime &&
+           this->hashPrefix == other.hashPrefix;
+}
+
+bool PluginScanCache::isUpToDate(const String &fileOrIdentifier, Status &status, int &numTypes) const
+{
+    Entry current;
+
+    if (! getIdentity(fileOrIdentifier, current))
+    {
+        return false;
+    }
+
+    const ScopedLock lock(this->entriesLock);
+
+    if (! this->entries.contains(fileOrIdentifier))
+    {
+        return false;
+    }
+
+    const Entry stored(this->entries[fileOrIdentifier]);
+
+    if (! stored.hasSameIdentity(current))
+    {
+        return false;
+    }
+
+    status = stored.status;
+    numTypes = stored.numTypes;
+    return true;
+}
+
+void PluginScanCache::update(const String &fileOrIdentifier, Status status, int numTypes)
+{
+    Entry entry;
+
+    if (! getIdentity(fileOrIdentifier, entry))
+    {
+        return;
+    }
+
+    entry.status = status;
+    entry.numTypes = numTypes;
+
+    const ScopedLock lock(this->entriesLock);
+    this->entries.set(fileOrIdentifier, entry);
+}
+
+void PluginScanCache::removeAllExcept(const StringArray &existingFiles)
+{
+    const ScopedLock lock(this->entriesLock);
+
+    StringArray filesToRemove;
+
+    for (HashMap<String, Entry>::Iterator i(this->entries); i.next();)
+    {
+        if (! existingFiles.contains(i.getKey()))
+        {
+            filesToRemove.add(i.getKey());
+        }
+    }
+
+    for (const auto &file : filesToRemove)
+    {
+        this->entries.remove(file);
+    }
+}
+
+bool PluginScanCache::getIdentity(const String &fileOrIdentifier, Entry &result)
+{
+    if (! File::isAbsolutePath(fileOrIdentifier))
+    {
+        return false;
+    }
+
+    const File file(fileOrIdentifier);
+
+    if (! file.exists())
+    {
+        return false;
+    }
+
+    result.size = file.getSize();
+    result.modificationTime = file.getLastModificationTime().toMilliseconds();
+    result.hashPrefix = String();
+    result.status = scanned;
+    result.numTypes = 0;
+
+    // Bundles only have the date to rely on
+    if (file.existsAsFile())
+    {
+        FileInputStream in(file);
+
+        if (in.openedOk())
+        {
+            HeapBlock<char> prefix(SCAN_CACHE_HASHED_PREFIX_SIZE);
+            const int numRead = in.read(prefix, SCAN_CACHE_HASHED_PREFIX_SIZE);
+            result.hashPrefix = MD5(prefix, size_t(jmax(0, numRead))).toHexString();
+        }
+    }
+
+    return true;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Serializable
+//===----------------------------------------------------------------------===//
+
+XmlElement *PluginScanCache::serialize() const
+{
+    const ScopedLock lock(this->entriesLock);
+    auto xml = new XmlElement(Serialization::Core::pluginScanCache);
+
+    for (HashMap<String, Entry>::Iterator i(this->entries); i.next();)
+    {
+        const Entry entry(i.getValue());
+        auto child = xml->createNewChildElement(Serialization::Core::scannedFile);
+        child->setAttribute(Serialization::Core::scannedFilePath, i.getKey());
+        child->setAttribute(Serialization::Core::scannedFileSize, String(entry.size));
+        child->setAttribute(Serialization::Core::scannedFileTime, String(entry.modificationTime));
+        child->setAttribute(Serialization::Core::scannedFileHash, entry.hashPrefix);
+        child->setAttribute(Serialization::Core::scannedFileStatus, int(entry.status));
+        child->setAttribute(Serialization::Core::scannedFileTypes, entry.numTypes);
+    }
+
+    return xml;
+}
+
+void PluginScanCache::deserialize(const XmlElement &xml)
+{
+    this->reset();
+
+    const XmlElement *root = xml.hasTagName(Serialization::Core::pluginScanCache) ?
+                             &xml : xml.getChildByName(Serialization::Core::pluginScanCache);
+
+    if (root == nullptr) { return; }
+
+    const ScopedLock lock(this->entriesLock);
+
+    forEachXmlChildElementWithTagName(*root, child, Serialization::Core::scannedFile)
+    {
+        const String path(child->getStringAttribute(Serialization::Core::scannedFilePath));
+
+        if (path.isEmpty())
+        {
+            continue;
+        }
+
+        Entry entry;
+        entry.size = child->getStringAttribute(Serialization::Core::scannedFileSize).getLargeIntValue();
+        entry.modificationTime = child->getStringAttribute(Serialization::Core::scannedFileTime).getLargeIntValue();
+        entry.hashPrefix = child->getStringAttribute(Serialization::Core::scannedFileHash);
+        entry.status = Status(jlimit(int(scanned), int(removedByUser), child->getIntAttribute(Serialization::Core::scannedFileStatus)));
+        entry.numTypes = child->getIntAttribute(Serialization::Core::scannedFileTypes);
+        this->entries.set(path, entry);
+    }
+}
+
+void PluginScanCache::reset()
+{
+    const ScopedLock lock(this->entriesLock);
+    this->entries.clear();
+}
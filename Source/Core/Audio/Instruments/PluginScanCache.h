@@ -0,0 +1,80 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Serializable.h"
+
+// Remembers which plugin files have already been probed, and what came out of it,
+// so that rescans only need to probe new or changed files.
+// Files are identified by path, size, modification time and a hash of the first bytes;
+// identifiers that are not files (like the built-in instruments) are always probed.
+
+class PluginScanCache : public Serializable
+{
+public:
+
+    enum Status
+    {
+        scanned,        // has been probed, numTypes types found
+        failed,         // crashed or hung up the scanner
+        removedByUser   // removed from the list by user, until the next explicit scan
+    };
+
+    PluginScanCache();
+
+    // True if the file is unchanged since it was probed last time;
+    // the status and the number of types found are returned in that case
+    bool isUpToDate(const String &fileOrIdentifier, Status &status, int &numTypes) const;
+
+    void update(const String &fileOrIdentifier, Status status, int numTypes);
+
+    // Forgets the files that are not there anymore
+    void removeAllExcept(const StringArray &existingFiles);
+
+    //===------------------------------------------------------------------===//
+    // Serializable
+    //===------------------------------------------------------------------===//
+
+    XmlElement *serialize() const override;
+
+    void deserialize(const XmlElement &xml) override;
+
+    void reset() override;
+
+private:
+
+    struct Entry
+    {
+        int64 size;
+        int64 modificationTime;
+        String hashPrefix;
+        Status status;
+        int numTypes;
+
+        bool hasSameIdentity(const Entry &other) const noexcept;
+    };
+
+    // Returns false for anything that is not a file or a bundle
+    static bool getIdentity(const String &fileOrIdentifier, Entry &result);
+
+    HashMap<String, Entry> entries;
+
+    CriticalSection entriesLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginScanCache)
+};
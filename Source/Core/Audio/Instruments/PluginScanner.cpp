@@ -0,0 +1,412 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "PluginScanner.h"
+#include "AudioCore.h"
+
+#if JUCE_WINDOWS
+#   include <windows.h>
+#else
+#   include <signal.h>
+#   include <unistd.h>
+#endif
+
+#define PLUGIN_SCANNER_POLL_MS 50
+#define PLUGIN_SCANNER_WATCHDOG_MS 500
+#define PLUGIN_SCANNER_PROCESS_ID_MESSAGE "helio-plugin-scanner-pid"
+
+// Messages are just the file name from the host,
+// and the file name, the number of types found and every type as a one-line xml from the worker.
+// Before the first result, the worker also sends the special marker and its process id.
+
+static int getCurrentProcessId()
+{
+#if JUCE_WINDOWS
+    return int(GetCurrentProcessId());
+#else
+    return int(getpid());
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// Host side
+//===----------------------------------------------------------------------===//
+
+class PluginScanner::Worker : public ChildProcessMaster
+{
+public:
+
+    explicit Worker(PluginScanner &scanner) :
+        isBusy(false),
+        isLost(false),
+        scanStartTime(0),
+        processId(0),
+        owner(scanner) {}
+
+    void handleMessageFromSlave(const MemoryBlock &message) override
+    {
+        this->owner.handleResult(*this, message);
+    }
+
+    void handleConnectionLost() override
+    {
+        this->owner.handleWorkerLost(*this);
+    }
+
+    // All of these are guarded by the owner's resultsLock
+    String currentFile;
+    bool isBusy;
+    bool isLost;
+    uint32 scanStartTime;
+    int processId;
+
+private:
+
+    PluginScanner &owner;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Worker)
+};
+
+PluginScanner::PluginScanner() {}
+
+PluginScanner::~PluginScanner()
+{
+    this->workers.clear();
+}
+
+bool PluginScanner::isWorkerCommandLine(const String &commandLine)
+{
+    return commandLine.contains(PLUGIN_SCANNER_PROCESS_ID);
+}
+
+void PluginScanner::scan(const StringArray &files, Thread &callingThread, Listener &listener)
+{
+    const File executable(File::getSpecialLocation(File::currentExecutableFile));
+    const int numWorkers = jlimit(1, PLUGIN_SCANNER_MAX_WORKERS, jmin(SystemStats::getNumCpus(), files.size()));
+
+    StringArray queue(files);
+    int numDone = 0;
+
+    while (numDone < files.size() && ! callingThread.threadShouldExit())
+    {
+        Array<Result> newResults;
+        OwnedArray<Worker> lostWorkers;
+
+        {
+            const ScopedLock lock(this->resultsLock);
+            newResults.swapWith(this->results);
+
+            for (int i = this->workers.size(); --i >= 0;)
+            {
+                Worker *worker = this->workers.getUnchecked(i);
+
+                if (worker->isBusy &&
+                    Time::getMillisecondCounter() - worker->scanStartTime > PLUGIN_SCANNER_HOST_TIMEOUT_MS)
+                {
+                    Result timeout = { worker->currentFile, {}, true };
+                    newResults.add(timeout);
+                    worker->isBusy = false;
+                    worker->isLost = true;
+
+                    // Deleting the ChildProcessMaster only asks the worker to quit,
+                    // which a hung up plugin would never let it do
+                    killProcess(worker->processId);
+                }
+
+                if (worker->isLost)
+                {
+                    lostWorkers.add(this->workers.removeAndReturn(i));
+                }
+            }
+        }
+
+        // Killing the lost workers outside of the lock,
+        // since their connection threads might be waiting for it
+        lostWorkers.clear();
+
+        for (const auto &result : newResults)
+        {
+            if (result.failed)
+            {
+                Logger::writeToLog("Plugin crashed or timed out: " + result.fileOrIdentifier);
+                listener.pluginScanFailed(result.fileOrIdentifier);
+            }
+            else
+            {
+                listener.pluginScanned(result.fileOrIdentifier, result.typesFound);
+            }
+
+            ++numDone;
+        }
+
+        // (Re)starting the workers, if there's something left to scan
+        while (this->workers.size() < numWorkers && queue.size() > 0)
+        {
+            ScopedPointer<Worker> worker(new Worker(*this));
+
+            if (! worker->launchSlaveProcess(executable, PLUGIN_SCANNER_PROCESS_ID))
+            {
+                break;
+            }
+
+            this->workers.add(worker.release());
+        }
+
+        if (this->workers.size() == 0 && queue.size() > 0)
+        {
+            Logger::writeToLog("Failed to launch plugin scanner processes");
+
+            for (const auto &file : queue)
+            {
+                listener.pluginScanFailed(file);
+            }
+
+            break;
+        }
+
+        {
+            const ScopedLock lock(this->resultsLock);
+
+            for (auto worker : this->workers)
+            {
+                if (worker->isBusy || worker->isLost || queue.size() == 0)
+                {
+                    continue;
+                }
+
+                MemoryOutputStream request;
+                request.writeString(queue[0]);
+
+                if (worker->sendMessageToSlave(request.getMemoryBlock()))
+                {
+                    worker->currentFile = queue[0];
+                    worker->isBusy = true;
+                    worker->scanStartTime = Time::getMillisecondCounter();
+                    queue.remove(0);
+                }
+                else
+                {
+                    // Not the plugin's fault, the file stays in the queue for another worker
+                    worker->isLost = true;
+                }
+            }
+        }
+
+        this->resultsEvent.wait(PLUGIN_SCANNER_POLL_MS);
+    }
+
+    this->workers.clear();
+}
+
+void PluginScanner::handleResult(Worker &worker, const MemoryBlock &message)
+{
+    MemoryInputStream in(message, false);
+
+    Result result;
+    result.fileOrIdentifier = in.readString();
+    result.failed = false;
+
+    if (result.fileOrIdentifier == PLUGIN_SCANNER_PROCESS_ID_MESSAGE)
+    {
+        const ScopedLock lock(this->resultsLock);
+        worker.processId = in.readInt();
+        return;
+    }
+
+    const int numTypes = in.readCompressedInt();
+
+    for (int i = 0; i < numTypes && ! in.isExhausted(); ++i)
+    {
+        ScopedPointer<XmlElement> xml(XmlDocument::parse(in.readString()));
+        PluginDescription description;
+
+        if (xml != nullptr && description.loadFromXml(*xml))
+        {
+            result.typesFound.add(description);
+        }
+    }
+
+    const ScopedLock lock(this->resultsLock);
+
+    // Might be too late, if the host has already given up on this one
+    if (! worker.isBusy || worker.isLost || worker.currentFile != result.fileOrIdentifier)
+    {
+        return;
+    }
+
+    worker.isBusy = false;
+    this->results.add(result);
+    this->resultsEvent.signal();
+}
+
+void PluginScanner::handleWorkerLost(Worker &worker)
+{
+    const ScopedLock lock(this->resultsLock);
+
+    if (worker.isLost)
+    {
+        return;
+    }
+
+    worker.isLost = true;
+
+    // Whatever the worker was scanning has crashed it
+    if (worker.isBusy)
+    {
+        Result crash = { worker.currentFile, {}, true };
+        this->results.add(crash);
+        worker.isBusy = false;
+    }
+
+    this->resultsEvent.signal();
+}
+
+void PluginScanner::killProcess(int processId)
+{
+    if (processId <= 0)
+    {
+        return;
+    }
+
+#if JUCE_WINDOWS
+    if (HANDLE process = OpenProcess(PROCESS_TERMINATE, FALSE, DWORD(processId)))
+    {
+        TerminateProcess(process, 1);
+        CloseHandle(process);
+    }
+#else
+    kill(pid_t(processId), SIGKILL);
+#endif
+}
+
+
+//===----------------------------------------------------------------------===//
+// Worker process side
+//===----------------------------------------------------------------------===//
+
+PluginScannerWorker::PluginScannerWorker() :
+    Thread("Plugin Scanner Watchdog")
+{
+    AudioCore::initAudioFormats(this->formatManager);
+    this->startThread(5);
+}
+
+PluginScannerWorker::~PluginScannerWorker()
+{
+    this->cancelPendingUpdate();
+    this->stopThread(1000);
+}
+
+void PluginScannerWorker::handleMessageFromMaster(const MemoryBlock &message)
+{
+    // Called from the connection thread; not scanning right here,
+    // so that the connection keeps responding to pings
+    MemoryInputStream in(message, false);
+
+    if (this->hasSentProcessId.compareAndSetBool(1, 0))
+    {
+        MemoryOutputStream hello;
+        hello.writeString(PLUGIN_SCANNER_PROCESS_ID_MESSAGE);
+        hello.writeInt(getCurrentProcessId());
+        this->sendMessageToMaster(hello.getMemoryBlock());
+    }
+
+    {
+        const ScopedLock lock(this->requestsLock);
+        this->requests.add(in.readString());
+    }
+
+    this->triggerAsyncUpdate();
+}
+
+void PluginScannerWorker::handleConnectionLost()
+{
+    JUCEApplication::quit();
+}
+
+void PluginScannerWorker::handleAsyncUpdate()
+{
+    while (true)
+    {
+        String fileOrIdentifier;
+
+        {
+            const ScopedLock lock(this->requestsLock);
+
+            if (this->requests.size() == 0)
+            {
+                return;
+            }
+
+            fileOrIdentifier = this->requests[0];
+            this->requests.remove(0);
+        }
+
+        this->scan(fileOrIdentifier);
+    }
+}
+
+void PluginScannerWorker::scan(const String &fileOrIdentifier)
+{
+    this->scanStartTime = jmax(uint32(1), Time::getMillisecondCounter());
+
+    KnownPluginList knownPluginList;
+    OwnedArray<PluginDescription> typesFound;
+
+    try
+    {
+        for (int i = 0; i < this->formatManager.getNumFormats(); ++i)
+        {
+            AudioPluginFormat *format = this->formatManager.getFormat(i);
+            knownPluginList.scanAndAddFile(fileOrIdentifier, false, typesFound, *format);
+        }
+    }
+    catch (...) {}
+
+    this->scanStartTime = 0;
+
+    MemoryOutputStream response;
+    response.writeString(fileOrIdentifier);
+    response.writeCompressedInt(typesFound.size());
+
+    for (auto type : typesFound)
+    {
+        ScopedPointer<XmlElement> xml(type->createXml());
+        response.writeString(xml->createDocument(String(), true, false));
+    }
+
+    this->sendMessageToMaster(response.getMemoryBlock());
+}
+
+void PluginScannerWorker::run()
+{
+    // Not a timer, since the message thread is the one that hangs up
+    while (! this->threadShouldExit())
+    {
+        this->wait(PLUGIN_SCANNER_WATCHDOG_MS);
+
+        const uint32 startTime = this->scanStartTime.get();
+
+        // The plugin has hung up, the host will find out from the lost connection
+        if (startTime != 0 &&
+            Time::getMillisecondCounter() - startTime > PLUGIN_SCANNER_WORKER_TIMEOUT_MS)
+        {
+            Process::terminate();
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Out-of-process plugins scanning.
+// The host keeps a pool of long-lived worker processes (the app itself, launched with
+// a special command line), sends them plugin files one by one over the pipes,
+// and gets the found descriptions back. A plugin that crashes or hangs
+// only takes its worker down, which is then restarted for the rest of the files.
+
+#define PLUGIN_SCANNER_PROCESS_ID "helio-plugin-scanner"
+#define PLUGIN_SCANNER_MAX_WORKERS 8
+
+// A worker kills itself, if a plugin takes longer than that to load,
+// the host waits a bit longer before giving up on the worker
+#define PLUGIN_SCANNER_WORKER_TIMEOUT_MS 10000
+#define PLUGIN_SCANNER_HOST_TIMEOUT_MS 15000
+
+class PluginScanner
+{
+public:
+
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+    private:
+        virtual void pluginScanned(const String &fileOrIdentifier,
+                                   const Array<PluginDescription> &typesFound) = 0;
+        virtual void pluginScanFailed(const String &fileOrIdentifier) = 0;
+        friend class PluginScanner;
+    };
+
+    PluginScanner();
+
+    ~PluginScanner();
+
+    // Blocks until all the files are scanned, or the calling thread is asked to exit.
+    // Listener callbacks are done from the calling thread.
+    void scan(const StringArray &files, Thread &callingThread, Listener &listener);
+
+    // Should be called by the app when running in a worker process
+    static bool isWorkerCommandLine(const String &commandLine);
+
+private:
+
+    class Worker;
+    friend class Worker;
+
+    struct Result
+    {
+        String fileOrIdentifier;
+        Array<PluginDescription> typesFound;
+        bool failed;
+    };
+
+    void handleResult(Worker &worker, const MemoryBlock &message);
+
+    void handleWorkerLost(Worker &worker);
+
+    static void killProcess(int processId);
+
+    OwnedArray<Worker> workers;
+
+    Array<Result> results;
+    CriticalSection resultsLock;
+    WaitableEvent resultsEvent;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginScanner)
+};
+
+// Lives in the worker process and does the actual scanning on the message thread,
+// since many plugins expect to be instantiated there; the connection keeps answering
+// the host's pings from its own thread, and a watchdog thread kills the process on hang-ups
+class PluginScannerWorker :
+    public ChildProcessSlave,
+    private Thread,
+    private AsyncUpdater
+{
+public:
+
+    PluginScannerWorker();
+
+    ~PluginScannerWorker() override;
+
+    void handleMessageFromMaster(const MemoryBlock &message) override;
+
+    void handleConnectionLost() override;
+
+private:
+
+    // Watchdog
+    void run() override;
+
+    // Scanning
+    void handleAsyncUpdate() override;
+
+    void scan(const String &fileOrIdentifier);
+
+    AudioPluginFormatManager formatManager;
+
+    StringArray requests;
+    CriticalSection requestsLock;
+
+    // The host needs it to kill the process, if the plugin hangs up
+    Atomic<int> hasSentProcessId;
+
+    // Zero while idle, otherwise the time the current scan has started at
+    Atomic<uint32> scanStartTime;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginScannerWorker)
+};
@@ -0,0 +1,364 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "ParallelAudioCallback.h"
+
+// About a hundred microseconds of spinning on the modern CPUs,
+// so that the workers are still awake for the next block on small buffer sizes
+#define PARALLEL_AUDIO_SPIN_COUNT 20000
+
+// How long adding or removing a callback waits for the audio thread to pick up the changes
+#define PARALLEL_AUDIO_PUBLISH_TIMEOUT_MS 1000
+
+static inline int64 makeJobClaims(int generation, int numJobs, int nextJob) noexcept
+{
+    return (int64(uint32(generation)) << 32) | (int64(numJobs & 0xffff) << 16) | int64(nextJob & 0xffff);
+}
+
+//===----------------------------------------------------------------------===//
+// Worker
+//===----------------------------------------------------------------------===//
+
+class ParallelAudioCallback::Worker : public Thread
+{
+public:
+
+    Worker(ParallelAudioCallback &parent, int index) :
+        Thread("Helio Audio Worker " + String(index)),
+        owner(parent) {}
+
+    ~Worker() override
+    {
+        this->signalThreadShouldExit();
+        this->wakeUp.signal();
+        this->stopThread(1000);
+    }
+
+    void wakeUpIfSleeping() noexcept
+    {
+        if (this->isSleeping.get() != 0)
+        {
+            this->wakeUp.signal();
+        }
+    }
+
+    void run() override
+    {
+        int lastGeneration = this->owner.generation.get();
+
+        while (! this->threadShouldExit())
+        {
+            for (int i = 0; i < PARALLEL_AUDIO_SPIN_COUNT &&
+                 this->owner.generation.get() == lastGeneration; ++i) {}
+
+            if (this->owner.generation.get() == lastGeneration)
+            {
+                this->isSleeping = 1;
+
+                // The audio thread checks the flag after it bumps the generation,
+                // so either it wakes us up, or we see the new generation here
+                if (this->owner.generation.get() == lastGeneration)
+                {
+                    this->wakeUp.wait(-1);
+                }
+
+                this->isSleeping = 0;
+                continue;
+            }
+
+            lastGeneration = this->owner.generation.get();
+            this->owner.runJobs();
+        }
+    }
+
+private:
+
+    ParallelAudioCallback &owner;
+
+    Atomic<int> isSleeping;
+    WaitableEvent wakeUp;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Worker)
+};
+
+
+//===----------------------------------------------------------------------===//
+// ParallelAudioCallback
+//===----------------------------------------------------------------------===//
+
+ParallelAudioCallback::ParallelAudioCallback() :
+    currentInputs(nullptr),
+    currentNumInputs(0),
+    currentNumOutputs(0),
+    currentNumSamples(0),
+    currentJobs(nullptr),
+    currentDevice(nullptr)
+{
+    this->publishedJobs = new JobList();
+
+    // The audio thread itself does a share of work too
+    const int numWorkers = jlimit(0, PARALLEL_AUDIO_MAX_WORKERS, SystemStats::getNumCpus() - 1);
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        Worker *worker = new Worker(*this, i);
+        this->workers.add(worker);
+        worker->startThread(10);
+    }
+
+    Logger::writeToLog("ParallelAudioCallback: " + String(numWorkers) + " audio workers");
+}
+
+ParallelAudioCallback::~ParallelAudioCallback()
+{
+    this->workers.clear();
+    delete this->publishedJobs.get();
+}
+
+void ParallelAudioCallback::addCallback(AudioIODeviceCallback *callback)
+{
+    jassert(callback != nullptr);
+
+    ScopedPointer<Job> job(new Job());
+    job->callback = callback;
+
+    if (this->currentDevice != nullptr)
+    {
+        callback->audioDeviceAboutToStart(this->currentDevice);
+
+        // Allocating here rather than on the first block
+        job->buffer.setSize(this->currentDevice->getActiveOutputChannels().countNumberOfSetBits(),
+                            this->currentDevice->getCurrentBufferSizeSamples());
+    }
+
+    const ScopedLock lock(this->jobsLock);
+
+    for (auto existingJob : this->jobs)
+    {
+        if (existingJob->callback == callback)
+        {
+            return;
+        }
+    }
+
+    this->jobs.add(job.release());
+    this->publishJobs();
+}
+
+void ParallelAudioCallback::removeCallback(AudioIODeviceCallback *callback)
+{
+    ScopedPointer<Job> removedJob;
+
+    {
+        const ScopedLock lock(this->jobsLock);
+
+        for (int i = 0; i < this->jobs.size(); ++i)
+        {
+            if (this->jobs.getUnchecked(i)->callback == callback)
+            {
+                removedJob = this->jobs.removeAndReturn(i);
+                break;
+            }
+        }
+
+        if (removedJob == nullptr)
+        {
+            return;
+        }
+
+        if (! this->publishJobs())
+        {
+            // The audio thread might still be holding it
+            this->retiredJobs.add(removedJob.release());
+        }
+    }
+
+    if (this->currentDevice != nullptr)
+    {
+        callback->audioDeviceStopped();
+    }
+}
+
+bool ParallelAudioCallback::publishJobs()
+{
+    ScopedPointer<JobList> newJobs(new JobList());
+
+    for (auto job : this->jobs)
+    {
+        newJobs->jobs.add(job);
+    }
+
+    JobList *const publishedList = newJobs.release();
+    ScopedPointer<JobList> oldJobs(this->publishedJobs.exchange(publishedList));
+
+    if (this->isDeviceRunning.get() == 0)
+    {
+        return true;
+    }
+
+    // The audio thread acknowledges the list at the start of the block;
+    // since it never goes back to the older one, after that the older one is free
+    const uint32 startTime = Time::getMillisecondCounter();
+
+    while (this->acknowledgedJobs.get() != publishedList)
+    {
+        if (Time::getMillisecondCounter() - startTime > PARALLEL_AUDIO_PUBLISH_TIMEOUT_MS)
+        {
+            Logger::writeToLog("ParallelAudioCallback: the audio thread has not picked up the changes in time");
+            this->retiredJobLists.add(oldJobs.release());
+            return false;
+        }
+
+        Thread::sleep(1);
+    }
+
+    return true;
+}
+
+void ParallelAudioCallback::audioDeviceIOCallback(const float **inputChannelData,
+                                                  int numInputChannels,
+                                                  float **outputChannelData,
+                                                  int numOutputChannels,
+                                                  int numSamples)
+{
+    JobList *jobList = this->publishedJobs.get();
+    this->acknowledgedJobs = jobList;
+
+    for (int i = 0; i < numOutputChannels; ++i)
+    {
+        if (outputChannelData[i] != nullptr)
+        {
+            FloatVectorOperations::clear(outputChannelData[i], numSamples);
+        }
+    }
+
+    const int numJobs = jobList->jobs.size();
+
+    if (numJobs == 0)
+    {
+        return;
+    }
+
+    for (auto job : jobList->jobs)
+    {
+        // Doesn't reallocate, unless the device has changed the block size on the fly
+        job->buffer.setSize(numOutputChannels, numSamples, false, false, true);
+    }
+
+    this->currentInputs = inputChannelData;
+    this->currentNumInputs = numInputChannels;
+    this->currentNumOutputs = numOutputChannels;
+    this->currentNumSamples = numSamples;
+    this->currentJobs = jobList;
+    this->numJobsDone = 0;
+
+    // Everything above is set up before the claims are published
+    const int blockGeneration = this->generation.get() + 1;
+    this->jobClaims = makeJobClaims(blockGeneration, numJobs, 0);
+
+    if (numJobs > 1)
+    {
+        this->generation = blockGeneration;
+
+        for (auto worker : this->workers)
+        {
+            worker->wakeUpIfSleeping();
+        }
+    }
+
+    this->runJobs();
+
+    // The slowest callback might still be in progress on some worker
+    while (this->numJobsDone.get() < numJobs) {}
+
+    // Nothing to claim until the next block
+    this->jobClaims = makeJobClaims(blockGeneration, 0, 0);
+
+    for (int i = 0; i < numOutputChannels; ++i)
+    {
+        if (outputChannelData[i] != nullptr)
+        {
+            for (auto job : jobList->jobs)
+            {
+                FloatVectorOperations::add(outputChannelData[i], job->buffer.getReadPointer(i), numSamples);
+            }
+        }
+    }
+}
+
+void ParallelAudioCallback::runJobs() noexcept
+{
+    for (;;)
+    {
+        // The whole word is compared, so the claim fails, if the block has changed meanwhile
+        const int64 claims = this->jobClaims.get();
+        const int numJobs = int((claims >> 16) & 0xffff);
+        const int jobIndex = int(claims & 0xffff);
+
+        if (jobIndex >= numJobs)
+        {
+            return;
+        }
+
+        if (! this->jobClaims.compareAndSetBool(claims + 1, claims))
+        {
+            continue;
+        }
+
+        // The audio thread doesn't change the block's parameters until this job is done
+        Job *job = this->currentJobs->jobs.getUnchecked(jobIndex);
+
+        job->callback->audioDeviceIOCallback(this->currentInputs,
+                                             this->currentNumInputs,
+                                             job->buffer.getArrayOfWritePointers(),
+                                             this->currentNumOutputs,
+                                             this->currentNumSamples);
+
+        ++this->numJobsDone;
+    }
+}
+
+void ParallelAudioCallback::audioDeviceAboutToStart(AudioIODevice *device)
+{
+    const ScopedLock lock(this->jobsLock);
+
+    this->currentDevice = device;
+    this->isDeviceRunning = 1;
+
+    const int numOutputs = device->getActiveOutputChannels().countNumberOfSetBits();
+    const int blockSize = device->getCurrentBufferSizeSamples();
+
+    for (auto job : this->jobs)
+    {
+        job->callback->audioDeviceAboutToStart(device);
+        job->buffer.setSize(numOutputs, blockSize);
+    }
+}
+
+void ParallelAudioCallback::audioDeviceStopped()
+{
+    const ScopedLock lock(this->jobsLock);
+
+    for (auto job : this->jobs)
+    {
+        job->callback->audioDeviceStopped();
+    }
+
+    this->currentDevice = nullptr;
+    this->isDeviceRunning = 0;
+}
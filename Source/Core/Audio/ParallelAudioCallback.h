@@ -0,0 +1,118 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// A device callback which runs a number of independent callbacks
+// (i.e. instruments' processor players) in parallel and sums their outputs.
+// The audio thread hands the callbacks out to a pool of worker threads through
+// an atomic counter, processes them along with the workers, and spins until all are done.
+// Workers spin for a while after each block, and only then fall asleep.
+//
+// The audio thread never locks: adding or removing a callback publishes a new immutable
+// list of jobs, which the audio thread picks up at the start of the next block,
+// and the old list is only deleted once the audio thread has acknowledged the new one.
+
+#define PARALLEL_AUDIO_MAX_WORKERS 7
+
+class ParallelAudioCallback : public AudioIODeviceCallback
+{
+public:
+
+    ParallelAudioCallback();
+
+    ~ParallelAudioCallback() override;
+
+    void addCallback(AudioIODeviceCallback *callback);
+
+    void removeCallback(AudioIODeviceCallback *callback);
+
+    int getNumWorkers() const noexcept
+    { return this->workers.size(); }
+
+    //===------------------------------------------------------------------===//
+    // AudioIODeviceCallback
+    //===------------------------------------------------------------------===//
+
+    void audioDeviceIOCallback(const float **inputChannelData,
+                               int numInputChannels,
+                               float **outputChannelData,
+                               int numOutputChannels,
+                               int numSamples) override;
+
+    void audioDeviceAboutToStart(AudioIODevice *device) override;
+
+    void audioDeviceStopped() override;
+
+private:
+
+    class Worker;
+    friend class Worker;
+
+    struct Job
+    {
+        AudioIODeviceCallback *callback;
+        AudioSampleBuffer buffer;
+    };
+
+    // Never changes once published
+    struct JobList
+    {
+        Array<Job *> jobs;
+    };
+
+    // Called by both the audio thread and the workers
+    void runJobs() noexcept;
+
+    // Makes the audio thread use the current jobs from the next block on,
+    // and waits for that, so that the old list and the removed jobs can be deleted
+    // Returns false if the audio thread has not picked up the changes in time
+    bool publishJobs();
+
+    // Owned by the message thread
+    OwnedArray<Job> jobs;
+    CriticalSection jobsLock;
+
+    Atomic<JobList *> publishedJobs;
+    Atomic<JobList *> acknowledgedJobs;
+    Atomic<int> isDeviceRunning;
+
+    // Lists and jobs the audio thread has failed to let go in time,
+    // deleted along with the callback itself
+    OwnedArray<JobList> retiredJobLists;
+    OwnedArray<Job> retiredJobs;
+
+    OwnedArray<Worker> workers;
+
+    // The current block's parameters and jobs, written by the audio thread
+    // before the new block's claims are published, and not changed until all of them are done
+    const float **currentInputs;
+    int currentNumInputs;
+    int currentNumOutputs;
+    int currentNumSamples;
+    const JobList *currentJobs;
+
+    // The block generation, the number of jobs and the next job index in one word,
+    // so that a worker which is late for a block can never claim a job of the next one
+    Atomic<int64> jobClaims;
+    Atomic<int> numJobsDone;
+    Atomic<int> generation;
+
+    AudioIODevice *currentDevice;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ParallelAudioCallback)
+};
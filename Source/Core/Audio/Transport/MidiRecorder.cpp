@@ -0,0 +1,232 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiRecorder.h"
+#include "Transport.h"
+#include "PianoLayer.h"
+#include "Note.h"
+
+#include "App.h"
+#include "Workspace.h"
+#include "AudioCore.h"
+
+MidiRecorder::MidiRecorder(Transport &parentTransport) :
+    transport(parentTransport),
+    targetLayer(nullptr),
+    fifo(MIDI_RECORDER_FIFO_SIZE),
+    events(MIDI_RECORDER_FIFO_SIZE),
+    lastEventBeat(0.0)
+{
+    zeromem(this->heldNotes, sizeof(this->heldNotes));
+}
+
+MidiRecorder::~MidiRecorder()
+{
+    // The target layer might be gone at this point
+    this->cancelRecording();
+}
+
+void MidiRecorder::startRecording(PianoLayer *layer)
+{
+    this->stopRecording();
+
+    if (layer == nullptr)
+    {
+        return;
+    }
+
+    // All the batches will make a single undo action
+    this->targetLayer = layer;
+    this->targetLayer->checkpoint();
+
+    zeromem(this->heldNotes, sizeof(this->heldNotes));
+    this->fifo.reset();
+    this->numDroppedEvents = 0;
+    this->lastEventBeat = 0.0;
+
+    if (! this->transport.isPlaying())
+    {
+        this->transport.startPlayback();
+    }
+
+    this->recording = 1;
+    App::Workspace().getAudioCore().getDevice().addMidiInputCallback(String(), this);
+    this->startTimer(MIDI_RECORDER_COMMIT_INTERVAL_MS);
+}
+
+void MidiRecorder::stopRecording()
+{
+    this->finishRecording(true);
+}
+
+void MidiRecorder::cancelRecording()
+{
+    this->finishRecording(false);
+}
+
+void MidiRecorder::finishRecording(bool shouldCommitPendingEvents)
+{
+    if (this->recording.get() == 0)
+    {
+        return;
+    }
+
+    // Once removed, the callback is guaranteed not to be in progress
+    this->recording = 0;
+    App::Workspace().getAudioCore().getDevice().removeMidiInputCallback(String(), this);
+    this->stopTimer();
+
+    if (shouldCommitPendingEvents)
+    {
+        this->commitPendingEvents(true);
+        this->targetLayer->checkpoint();
+    }
+
+    this->targetLayer = nullptr;
+
+    if (this->numDroppedEvents.get() > 0)
+    {
+        Logger::writeToLog("MidiRecorder: " + String(this->numDroppedEvents.get()) + " events dropped");
+    }
+}
+
+bool MidiRecorder::isRecording() const noexcept
+{
+    return this->recording.get() != 0;
+}
+
+const PianoLayer *MidiRecorder::getTargetLayer() const noexcept
+{
+    return this->targetLayer;
+}
+
+int MidiRecorder::getNumDroppedEvents() const noexcept
+{
+    return this->numDroppedEvents.get();
+}
+
+
+//===----------------------------------------------------------------------===//
+// MidiInputCallback
+//===----------------------------------------------------------------------===//
+
+void MidiRecorder::handleIncomingMidiMessage(MidiInput *source, const MidiMessage &message)
+{
+    if (this->recording.get() == 0 ||
+        ! message.isNoteOnOrOff())
+    {
+        return;
+    }
+
+    // Device timestamps are based on the same hi-res counter the player uses
+    double beat = 0.0;
+
+    if (! this->transport.getBeatAtTime(message.getTimeStamp() * 1000.0, beat))
+    {
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    this->fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 + size2 == 0)
+    {
+        ++this->numDroppedEvents;
+        return;
+    }
+
+    CapturedEvent &event = this->events[(size1 > 0) ? start1 : start2];
+    event.beat = beat;
+    event.key = uint8(message.getNoteNumber());
+    event.velocity = message.getVelocity();
+    event.isNoteOn = message.isNoteOn();
+
+    this->fifo.finishedWrite(1);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Committing
+//===----------------------------------------------------------------------===//
+
+void MidiRecorder::timerCallback()
+{
+    this->commitPendingEvents(false);
+}
+
+void MidiRecorder::commitPendingEvents(bool shouldReleaseHeldNotes)
+{
+    if (this->targetLayer == nullptr)
+    {
+        return;
+    }
+
+    Array<Note> notes;
+
+    int start1, size1, start2, size2;
+    this->fifo.prepareToRead(this->fifo.getNumReady(), start1, size1, start2, size2);
+
+    for (int i = 0; i < size1 + size2; ++i)
+    {
+        const CapturedEvent &event = this->events[(i < size1) ? (start1 + i) : (start2 + i - size1)];
+        HeldNote &heldNote = this->heldNotes[event.key & 127];
+        this->lastEventBeat = jmax(this->lastEventBeat, event.beat);
+
+        // Repeated note-on releases the note held on the same key
+        if (heldNote.isHeld)
+        {
+            this->addNote(event.key, heldNote, event.beat, notes);
+            heldNote.isHeld = false;
+        }
+
+        if (event.isNoteOn)
+        {
+            heldNote.beat = event.beat;
+            heldNote.velocity = event.velocity / 127.f;
+            heldNote.isHeld = true;
+        }
+    }
+
+    this->fifo.finishedRead(size1 + size2);
+
+    if (shouldReleaseHeldNotes)
+    {
+        double endBeat = this->lastEventBeat;
+        this->transport.getBeatAtTime(Time::getMillisecondCounterHiRes(), endBeat);
+
+        for (int key = 0; key < 128; ++key)
+        {
+            if (this->heldNotes[key].isHeld)
+            {
+                this->addNote(key, this->heldNotes[key], endBeat, notes);
+                this->heldNotes[key].isHeld = false;
+            }
+        }
+    }
+
+    if (notes.size() > 0)
+    {
+        this->targetLayer->insertGroup(notes, true);
+    }
+}
+
+void MidiRecorder::addNote(int key, const HeldNote &heldNote, double endBeat, Array<Note> &result)
+{
+    const float length = jmax(MIDI_RECORDER_MIN_NOTE_LENGTH, float(endBeat - heldNote.beat));
+    result.add(Note(this->targetLayer, key, float(heldNote.beat), length, heldNote.velocity));
+}
@@ -0,0 +1,106 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class Transport;
+class PianoLayer;
+class Note;
+
+// Records the notes performed on the MIDI input devices into a piano layer,
+// while the playback runs.
+// The device callback only converts the message timestamp into beats, using the
+// clock published by the player thread, and pushes it into a fifo: it never locks
+// or allocates. The notes are assembled and committed into the layer in batches,
+// on the message thread, so a dense performance never blocks the MIDI or audio threads.
+
+#define MIDI_RECORDER_FIFO_SIZE 4096
+#define MIDI_RECORDER_COMMIT_INTERVAL_MS 100
+#define MIDI_RECORDER_MIN_NOTE_LENGTH 0.0625f
+
+class MidiRecorder :
+    public MidiInputCallback,
+    private Timer
+{
+public:
+
+    explicit MidiRecorder(Transport &parentTransport);
+
+    ~MidiRecorder() override;
+
+    // Starts the playback as well, if it's not running
+    void startRecording(PianoLayer *layer);
+
+    void stopRecording();
+
+    // Stops without touching the target layer, dropping the notes not committed yet
+    void cancelRecording();
+
+    bool isRecording() const noexcept;
+
+    const PianoLayer *getTargetLayer() const noexcept;
+
+    // Events lost because the fifo was full
+    int getNumDroppedEvents() const noexcept;
+
+    //===------------------------------------------------------------------===//
+    // MidiInputCallback
+    //===------------------------------------------------------------------===//
+
+    void handleIncomingMidiMessage(MidiInput *source, const MidiMessage &message) override;
+
+private:
+
+    void timerCallback() override;
+
+    void commitPendingEvents(bool shouldReleaseHeldNotes);
+
+    void finishRecording(bool shouldCommitPendingEvents);
+
+    struct CapturedEvent
+    {
+        double beat;
+        uint8 key;
+        uint8 velocity;
+        bool isNoteOn;
+    };
+
+    struct HeldNote
+    {
+        double beat;
+        float velocity;
+        bool isHeld;
+    };
+
+    void addNote(int key, const HeldNote &heldNote, double endBeat, Array<Note> &result);
+
+    Transport &transport;
+
+    PianoLayer *targetLayer;
+
+    // Written by the MIDI thread only, read by the message thread only
+    AbstractFifo fifo;
+    HeapBlock<CapturedEvent> events;
+
+    Atomic<int> recording;
+    Atomic<int> numDroppedEvents;
+
+    HeldNote heldNotes[128];
+    double lastEventBeat;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MidiRecorder)
+};
@@ -97,8 +97,10 @@ void PlayerThread::run()
         }
     };
 
-    auto sendHoldingNotesOffAndMidiStop = [&holdingNotes, &uniqueInstruments]()
+    auto sendHoldingNotesOffAndMidiStop = [this, &holdingNotes, &uniqueInstruments]()
     {
+        this->transport.resetPlaybackClock();
+        
         for (const auto &holding : holdingNotes)
         {
             MidiMessage noteOff(MidiMessage::noteOff(holding.channel, holding.key, 0.f));
@@ -127,6 +129,7 @@ void PlayerThread::run()
     };
     
     // And here we go.
+    this->transport.publishPlaybackClock(startPositionInTime, msPerTick);
     sendMidiStart();
     
     while (1)
@@ -174,6 +177,7 @@ void PlayerThread::run()
                 //Logger::writeToLog("Sekk to time " + String(startPositionInTime));
                 sequences.seekToTime(startPositionInTime);
                 prevTimeStamp = startPositionInTime;
+                this->transport.publishPlaybackClock(prevTimeStamp, msPerTick);
                 continue;
             }
             else
@@ -245,6 +249,7 @@ void PlayerThread::run()
         {
             sequences.seekToTime(startPositionInTime);
             prevTimeStamp = startPositionInTime;
+            this->transport.publishPlaybackClock(prevTimeStamp, msPerTick);
         }
         else
         {
@@ -257,10 +262,18 @@ void PlayerThread::run()
             {
                 msPerTick = wrapper.message.getTempoSecondsPerQuarterNote() * 1000.f / TPQN;
                 this->transport.broadcastTempoChanged(msPerTick);
+                this->transport.publishPlaybackClock(prevTimeStamp, msPerTick);
                 
                 // Sends this to everybody (need to do that for drum-machines) - TODO test
                 sendTempoChangeToEverybody(wrapper.message);
             }
+            else if (wrapper.message.isNoteOn() &&
+                     wrapper.instrument != nullptr && ! wrapper.instrument->isReady())
+            {
+                // Instruments might still be loading right after the project is opened;
+                // the playback doesn't wait for them, they are just muted until ready
+                continue;
+            }
             else
             {
                 wrapper.listener->addMessageToQueue(wrapper.message);
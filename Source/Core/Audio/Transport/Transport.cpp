@@ -21,7 +21,9 @@
 #include "OrchestraPit.h"
 #include "PlayerThread.h"
 #include "RendererThread.h"
+#include "MidiRecorder.h"
 #include "MidiLayer.h"
+#include "PianoLayer.h"
 #include "MidiEvent.h"
 
 #include "App.h"
@@ -50,6 +52,7 @@ Transport::Transport(OrchestraPit &orchestraPit) :
 {
     this->player = new PlayerThread(*this);
     this->renderer = new RendererThread(*this);
+    this->recorder = new MidiRecorder(*this);
 
     this->orchestra.addOrchestraListener(this);
 }
@@ -57,6 +60,12 @@ Transport::Transport(OrchestraPit &orchestraPit) :
 Transport::~Transport()
 {
     this->orchestra.removeOrchestraListener(this);
+
+    // The project is expected to stop the playback (and commit the recorded notes)
+    // while its layers are still there, see ProjectTreeItem's destructor;
+    // anything left at this point is dropped
+    this->recorder->cancelRecording();
+    this->recorder = nullptr;
     
     if (this->player->isThreadRunning())
     {
@@ -160,6 +169,58 @@ void Transport::rebuildSequencesInRealtime()
     //this->sequences.seekToTime(this->lastSeekTimeStamp);
 }
 
+bool Transport::getBeatAtTime(double timeMs, double &outBeat) const
+{
+    double anchorTimeMs, anchorTick, msPerTick;
+
+    for (;;)
+    {
+        const int version = this->clockVersion.get();
+
+        if ((version & 1) != 0)
+        {
+            continue;
+        }
+
+        anchorTimeMs = this->clockTimeMs.get();
+        anchorTick = this->clockTick.get();
+        msPerTick = this->clockMsPerTick.get();
+
+        if (this->clockVersion.get() == version)
+        {
+            break;
+        }
+    }
+
+    if (msPerTick <= 0.0)
+    {
+        return false;
+    }
+
+    const double tick = anchorTick + (timeMs - anchorTimeMs) / msPerTick;
+    outBeat = this->projectFirstBeat + tick / Transport::millisecondsPerBeat;
+    return true;
+}
+
+void Transport::publishPlaybackClock(const double tick, const double msPerTick)
+{
+    ++this->clockVersion;
+    this->clockTimeMs = Time::getMillisecondCounterHiRes();
+    this->clockTick = tick;
+    this->clockMsPerTick = msPerTick;
+    ++this->clockVersion;
+}
+
+void Transport::resetPlaybackClock()
+{
+    this->publishPlaybackClock(0.0, 0.0);
+}
+
+MidiRecorder &Transport::getMidiRecorder() const noexcept
+{
+    return *this->recorder;
+}
+
 void Transport::seekToPosition(double absPosition)
 {
     double timeMs = 0.0;
@@ -242,10 +303,13 @@ void Transport::startPlaybackLooped(double absLoopStart, double absLoopEnd)
 
 void Transport::stopPlayback()
 {
+    this->recorder->stopRecording();
+
     if (this->player->isThreadRunning() &&
         !this->player->threadShouldExit())
     {
         this->player->stopThread(PLAYER_THREAD_STOP_TIME_MS);
+        this->resetPlaybackClock();
         this->allNotesControllersAndSoundOff();
         this->loopedMode = false;
         this->seekToPosition(this->getSeekPosition());
@@ -450,7 +514,11 @@ void Transport::onEventAdded(const MidiEvent &event)
 {
     // todo stop playback only if the event is in future and getControllerNumber == 0 (not an automation)
 
-    if (this->player->isThreadRunning())
+    // The notes being recorded are always in the past
+    const bool isBeingRecorded = (this->recorder->isRecording() &&
+                                  event.getLayer() == this->recorder->getTargetLayer());
+
+    if (this->player->isThreadRunning() && ! isBeingRecorded)
     { this->stopPlayback(); }
     
     // a hack
@@ -486,6 +554,28 @@ void Transport::onEventRemovedPostAction(const MidiLayer *layer)
     this->sequencesAreOutdated = true;
 }
 
+void Transport::onChangesBatch(const LayerChangeSet &changes)
+{
+    const MidiLayer *layer = changes.getLayer();
+
+    // Same as for the single events, but stops and seeks only once for the whole batch
+    const bool isBeingRecorded = (this->recorder->isRecording() &&
+                                  layer == this->recorder->getTargetLayer() &&
+                                  changes.getRemovedEvents().isEmpty() &&
+                                  changes.getChangedEventsBefore().isEmpty());
+
+    if (this->player->isThreadRunning() && ! isBeingRecorded)
+    { this->stopPlayback(); }
+
+    // a hack
+    if (layer->getControllerNumber() == MidiLayer::tempoController)
+    {
+        this->seekToPosition(this->getSeekPosition());
+    }
+
+    this->sequencesAreOutdated = true;
+}
+
 void Transport::onLayerChanged(const MidiLayer *layer)
 {
     if (this->player->isThreadRunning())
@@ -507,6 +597,9 @@ void Transport::onLayerAdded(const MidiLayer *layer)
 
 void Transport::onLayerRemoved(const MidiLayer *layer)
 {
+    if (layer == this->recorder->getTargetLayer())
+    { this->recorder->stopRecording(); }
+    
     if (this->player->isThreadRunning())
     {this->stopPlayback(); }
     
@@ -517,7 +610,8 @@ void Transport::onLayerRemoved(const MidiLayer *layer)
 
 void Transport::onProjectBeatRangeChanged(float firstBeat, float lastBeat)
 {
-    if (this->player->isThreadRunning())
+    if (this->player->isThreadRunning() &&
+        ! this->recorder->isRecording())
     {
         this->stopPlayback();
     }
@@ -631,19 +725,33 @@ void Transport::rebuildSequencesIfNeeded()
     if (this->sequencesAreOutdated)
     {
         this->sequences.clear();
+
+        // The player thread may get here too, and it should not touch
+        // the layers' sequence caches, which are patched on the message thread
+        const bool isMessageThread = MessageManager::getInstance()->isThisTheMessageThread();
         
         for (int i = 0; i < this->layersCache.size(); ++i)
         {
             const MidiLayer *layer = this->layersCache.getUnchecked(i);
-            MidiMessageSequence sequence(layer->exportMidi());
-            sequence.addTimeToMessages(-this->trackStartMs);
+
+            SequenceWrapper::Ptr wrapper(new SequenceWrapper());
+
+            // The only copy of the layer's sequence, since the offset is applied to it
+            if (isMessageThread)
+            {
+                wrapper->sequence = layer->exportMidi();
+            }
+            else if (! layer->isMuted())
+            {
+                wrapper->sequence = layer->getSnapshot()->exportMidi();
+            }
+
+            wrapper->sequence.addTimeToMessages(-this->trackStartMs);
             
-            if (sequence.getNumEvents() > 0)
+            if (wrapper->sequence.getNumEvents() > 0)
             {
                 Instrument *targetInstrument = this->linksCache[layer->getLayerId().toString()];
-                auto wrapper = new SequenceWrapper();
                 wrapper->layer = layer;
-                wrapper->sequence = sequence;
                 wrapper->currentIndex = 0;
                 wrapper->instrument = targetInstrument;
                 wrapper->listener = &targetInstrument->getProcessorPlayer().getMidiMessageCollector();
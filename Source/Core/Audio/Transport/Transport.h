@@ -21,6 +21,7 @@ class Instrument;
 class OrchestraPit;
 class PlayerThread;
 class RendererThread;
+class MidiRecorder;
 
 #include "TransportListener.h"
 #include "ProjectSequencesWrapper.h"
@@ -77,6 +78,12 @@ public:
 
     void rebuildSequencesInRealtime();
 
+    // Converts the hi-res counter time into the project beat, while playing;
+    // safe to call from any thread, never blocks
+    bool getBeatAtTime(double timeMs, double &outBeat) const;
+
+    MidiRecorder &getMidiRecorder() const noexcept;
+
     
     //===------------------------------------------------------------------===//
     // Sending messages at realtime
@@ -112,6 +119,8 @@ public:
     
     void onEventRemovedPostAction(const MidiLayer *layer) override;
 
+    void onChangesBatch(const LayerChangeSet &changes) override;
+
     void onLayerChanged(const MidiLayer *layer) override;
     
     void onLayerAdded(const MidiLayer *layer) override;
@@ -142,12 +151,17 @@ protected:
                        const double currentTimeMs,
                        const double totalTimeMs);
 
+    // Called by the player thread, as it sends the events out
+    void publishPlaybackClock(const double tick, const double msPerTick);
+    void resetPlaybackClock();
+
 private:
     
     OrchestraPit &orchestra;
 
     ScopedPointer<PlayerThread> player;
     ScopedPointer<RendererThread> renderer;
+    ScopedPointer<MidiRecorder> recorder;
     
     friend class PlayerThread;
     friend class RendererThread;
@@ -182,6 +196,15 @@ private:
     
     double trackStartMs;
     double trackEndMs;
+
+    // The playback position as of the last event sent by the player, with the tempo
+    // to extrapolate it; written by one thread at a time, and the version is odd
+    // while writing, so that readers can retry instead of locking.
+    // The fields are atomics too, so that their accesses are ordered with the version's ones
+    Atomic<int> clockVersion;
+    Atomic<double> clockTimeMs;
+    Atomic<double> clockTick;
+    Atomic<double> clockMsPerTick;
     
     float projectFirstBeat;
     float projectLastBeat;
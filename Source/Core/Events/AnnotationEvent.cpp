@@ -22,17 +22,16 @@
 #include "SerializationKeys.h"
 
 
-AnnotationEvent::AnnotationEvent() : MidiEvent(nullptr, 0.f)
+AnnotationEvent::AnnotationEvent() : MidiEvent(nullptr, 0, 0)
 {
     //jassertfalse;
 }
 
 AnnotationEvent::AnnotationEvent(const AnnotationEvent &other) :
-    MidiEvent(other.layer, other.beat),
+    MidiEvent(other.layer, other.id, other.tick),
     description(other.description),
     colour(other.colour)
 {
-    this->id = other.getID();
 }
 
 AnnotationEvent::AnnotationEvent(MidiLayer *owner,
@@ -49,11 +48,16 @@ AnnotationEvent::~AnnotationEvent()
 {
 }
 
+MidiEvent *AnnotationEvent::copy() const
+{
+    return new AnnotationEvent(*this);
+}
+
 Array<MidiMessage> AnnotationEvent::getSequence() const
 {
 	Array<MidiMessage> result;
     MidiMessage event(MidiMessage::textMetaEvent(1, this->getDescription()));
-    event.setTimeStamp(this->beat * Transport::millisecondsPerBeat);
+    event.setTimeStamp(MidiEvent::tickToBeat(this->tick) * Transport::millisecondsPerBeat);
     result.add(event);
     return result;
 }
@@ -61,14 +65,14 @@ Array<MidiMessage> AnnotationEvent::getSequence() const
 AnnotationEvent AnnotationEvent::withDeltaBeat(float beatOffset) const
 {
     AnnotationEvent ae(*this);
-    ae.beat = ae.beat + beatOffset;
+    ae.tick = ae.tick + MidiEvent::beatToTick(beatOffset);
     return ae;
 }
 
 AnnotationEvent AnnotationEvent::withBeat(float newBeat) const
 {
     AnnotationEvent ae(*this);
-    ae.beat = newBeat;
+    ae.tick = MidiEvent::beatToTick(newBeat);
     return ae;
 }
 
@@ -125,8 +129,8 @@ XmlElement *AnnotationEvent::serialize() const
     auto xml = new XmlElement(Serialization::Core::annotation);
     xml->setAttribute("text", this->description);
     xml->setAttribute("col", this->colour.toString());
-    xml->setAttribute("beat", this->beat);
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("beat", MidiEvent::tickToBeat(this->tick));
+    xml->setAttribute("id", MidiEvent::idToString(this->id));
     return xml;
 }
 
@@ -137,8 +141,8 @@ void AnnotationEvent::deserialize(const XmlElement &xml)
     // здесь никаких проверок. посмотри, как быстро будет работать сериализация.
     this->description = xml.getStringAttribute("text");
     this->colour = Colour::fromString(xml.getStringAttribute("col"));
-    this->beat = float(xml.getDoubleAttribute("beat"));
-    this->id = xml.getStringAttribute("id");
+    this->tick = MidiEvent::beatToTick(xml.getDoubleAttribute("beat"));
+    this->id = MidiEvent::idFromString(xml.getStringAttribute("id"));
 }
 
 void AnnotationEvent::reset()
@@ -150,7 +154,7 @@ void AnnotationEvent::reset()
 int AnnotationEvent::hashCode() const noexcept
 {
     return this->getDescription().hashCode() +
-           this->getID().hashCode();
+           MidiEvent::hashId(this->getID());
 }
 
 AnnotationEvent &AnnotationEvent::operator=(const AnnotationEvent &right)
@@ -159,7 +163,7 @@ AnnotationEvent &AnnotationEvent::operator=(const AnnotationEvent &right)
 
     //this->layer = *right.getLayer(); // never do this
     this->id = right.id;
-    this->beat = right.beat;
+    this->tick = right.tick;
     this->description = right.description;
     this->colour = right.colour;
 
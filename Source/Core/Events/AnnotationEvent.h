@@ -37,6 +37,8 @@ public:
 
 	Array<MidiMessage> getSequence() const override;
 
+    MidiEvent *copy() const override;
+
     
     AnnotationEvent copyWithNewId() const;
     
@@ -25,17 +25,16 @@
 #define MIN_INTERPOLATED_CONTROLLER_DELTA (0.01f)
 #define INTERPOLATED_EVENTS_STEP_MS (350)
 
-AutomationEvent::AutomationEvent() : MidiEvent(nullptr, 0.f)
+AutomationEvent::AutomationEvent() : MidiEvent(nullptr, 0, 0)
 {
     //jassertfalse;
 }
 
 AutomationEvent::AutomationEvent(const AutomationEvent &other) :
-    MidiEvent(other.layer, other.beat),
+    MidiEvent(other.layer, other.id, other.tick),
     controllerValue(other.controllerValue),
     curvature(other.curvature)
 {
-    this->id = other.getID();
 }
 
 AutomationEvent::AutomationEvent(MidiLayer *owner, float beatVal, float cValue) :
@@ -91,7 +90,25 @@ float exponentalInterpolation(float y0, float y1, float factor, float easing)
 }
 
 
+MidiEvent *AutomationEvent::copy() const
+{
+    return new AutomationEvent(*this);
+}
+
 Array<MidiMessage> AutomationEvent::getSequence() const
+{
+    const int indexOfThis = this->getLayer()->indexOfSorted(this);
+    const LayerParameters parameters(this->getLayer()->getEventParameters());
+
+    if (indexOfThis >= 0 && indexOfThis < (this->getLayer()->size() - 1))
+    {
+        return this->getSequenceFollowedBy(this->getLayer()->getUnchecked(indexOfThis + 1), parameters);
+    }
+
+    return this->getSequenceFollowedBy(nullptr, parameters);
+}
+
+Array<MidiMessage> AutomationEvent::getSequenceFollowedBy(const MidiEvent *next, const LayerParameters &parameters) const
 {
 	Array<MidiMessage> result;
     
@@ -100,34 +117,32 @@ Array<MidiMessage> AutomationEvent::getSequence() const
     {
         MidiMessage cc;
         
-        if (this->getLayer()->isTempoLayer())
+        if (parameters.isTempoLayer)
         {
             cc = MidiMessage::tempoMetaEvent(int((1.f - this->controllerValue) * Transport::millisecondsPerBeat * 1000));
         }
         else
         {
-            cc = MidiMessage::controllerEvent(this->layer->getChannel(),
-                                              this->getLayer()->getControllerNumber(),
+            cc = MidiMessage::controllerEvent(parameters.channel,
+                                              parameters.controllerNumber,
                                               int(this->controllerValue * 127));
         
         }
 
-        const float &startTime = this->beat * Transport::millisecondsPerBeat;
+        const float startTime = float(MidiEvent::tickToBeat(this->tick) * Transport::millisecondsPerBeat);
         cc.setTimeStamp(startTime);
         result.add(cc);
 
         
         // добавить интерполированные события, если таковые должны быть
-        const int indexOfThis = this->getLayer()->indexOfSorted(this);
-        
-        if (indexOfThis >= 0 && indexOfThis < (this->getLayer()->size() - 1))
+        if (next != nullptr)
         {
-            const AutomationEvent *nextEvent = static_cast<AutomationEvent *>(this->getLayer()->getUnchecked(indexOfThis + 1));
+            const AutomationEvent *nextEvent = static_cast<const AutomationEvent *>(next);
             const float controllerDelta = fabs(this->controllerValue - nextEvent->controllerValue);
             
             if (controllerDelta > MIN_INTERPOLATED_CONTROLLER_DELTA)
             {
-                const float nextTime = nextEvent->beat * Transport::millisecondsPerBeat;
+                const float nextTime = float(MidiEvent::tickToBeat(nextEvent->tick) * Transport::millisecondsPerBeat);
                 float interpolatedEventTimeStamp = startTime + INTERPOLATED_EVENTS_STEP_MS;
                 
                 while (interpolatedEventTimeStamp < nextTime)
@@ -144,7 +159,7 @@ Array<MidiMessage> AutomationEvent::getSequence() const
                     
                     //Logger::writeToLog(String(this->controllerValue) + " - " + String(interpolatedControllerValue) + " - " + String(nextEvent->controllerValue));
                     
-                    if (this->getLayer()->isTempoLayer())
+                    if (parameters.isTempoLayer)
                     {
                         MidiMessage ci(MidiMessage::tempoMetaEvent(int((1.f - interpolatedControllerValue) * Transport::millisecondsPerBeat * 1000)));
                         ci.setTimeStamp(interpolatedEventTimeStamp);
@@ -152,8 +167,8 @@ Array<MidiMessage> AutomationEvent::getSequence() const
                     }
                     else
                     {
-                        MidiMessage ci(MidiMessage::controllerEvent(this->getLayer()->getChannel(),
-                                                                    this->getLayer()->getControllerNumber(),
+                        MidiMessage ci(MidiMessage::controllerEvent(parameters.channel,
+                                                                    parameters.controllerNumber,
                                                                     int(this->controllerValue * 127)));
                         ci.setTimeStamp(interpolatedEventTimeStamp);
                         result.add(ci);
@@ -175,24 +190,17 @@ AutomationEvent AutomationEvent::copyWithNewId() const
     return ae;
 }
 
-static float roundBeat(float beat)
-{
-    return roundf(beat * 1000.f) / 1000.f;
-}
-
 AutomationEvent AutomationEvent::withBeat(float newBeat) const
 {
     AutomationEvent ae(*this);
-    //ae.beat = newBeat;
-    ae.beat = roundBeat(newBeat);
+    ae.tick = MidiEvent::beatToTick(newBeat);
     return ae;
 }
 
 AutomationEvent AutomationEvent::withDeltaBeat(float deltaBeat) const
 {
     AutomationEvent ae(*this);
-    //ae.beat = this->beat + deltaBeat;
-    ae.beat = roundBeat(this->beat + deltaBeat);
+    ae.tick = this->tick + MidiEvent::beatToTick(deltaBeat);
     return ae;
 }
 
@@ -206,7 +214,7 @@ AutomationEvent AutomationEvent::withInvertedControllerValue() const
 AutomationEvent AutomationEvent::withParameters(float newBeat, float newControllerValue) const
 {
     AutomationEvent ae(*this);
-    ae.beat = newBeat;
+    ae.tick = MidiEvent::beatToTick(newBeat);
     ae.controllerValue = newControllerValue;
     return ae;
 }
@@ -277,10 +285,10 @@ XmlElement *AutomationEvent::serialize() const
 {
     auto xml = new XmlElement(Serialization::Core::event);
     xml->setAttribute("val", this->controllerValue);
-    xml->setAttribute("beat", this->beat);
+    xml->setAttribute("beat", MidiEvent::tickToBeat(this->tick));
     xml->setAttribute("curve", this->curvature);
     //xml->setAttribute("id", this->id.toString());
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("id", MidiEvent::idToString(this->id));
     return xml;
 }
 
@@ -291,8 +299,8 @@ void AutomationEvent::deserialize(const XmlElement &xml)
     // здесь никаких проверок. посмотри, как быстро будет работать сериализация.
     this->controllerValue = float(xml.getDoubleAttribute("val"));
     this->curvature = float(xml.getDoubleAttribute("curve", AUTOEVENT_DEFAULT_CURVATURE));
-    this->beat = float(xml.getDoubleAttribute("beat"));
-    this->id = xml.getStringAttribute("id");
+    this->tick = MidiEvent::beatToTick(xml.getDoubleAttribute("beat"));
+    this->id = MidiEvent::idFromString(xml.getStringAttribute("id"));
 }
 
 void AutomationEvent::reset()
@@ -307,8 +315,8 @@ int AutomationEvent::hashCode() const noexcept
     //       roundFloatToInt(this->getBeat() * 1000) +
     //       this->getID().toString().hashCode();
     return roundFloatToInt(this->getControllerValue() * 1000) +
-           roundFloatToInt(this->getBeat() * 1000) +
-           this->getID().hashCode();
+           int(this->tick) +
+           MidiEvent::hashId(this->getID());
 }
 
 AutomationEvent &AutomationEvent::operator=(const AutomationEvent &right)
@@ -317,7 +325,7 @@ AutomationEvent &AutomationEvent::operator=(const AutomationEvent &right)
 
     //this->layer = right.layer; // never do this
     this->id = right.id;
-    this->beat = right.beat;
+    this->tick = right.tick;
     this->curvature = right.curvature;
     this->controllerValue = right.controllerValue;
 
@@ -37,6 +37,11 @@ public:
 
 	Array<MidiMessage> getSequence() const override;
 
+    Array<MidiMessage> getSequenceFollowedBy(const MidiEvent *nextEvent,
+                                             const LayerParameters &parameters) const override;
+
+    MidiEvent *copy() const override;
+
     
     AutomationEvent copyWithNewId() const;
 
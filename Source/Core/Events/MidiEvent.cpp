@@ -22,11 +22,18 @@
 
 MidiEvent::MidiEvent(MidiLayer *owner, float beatVal) :
     layer(owner),
-    beat(beatVal)
+    tick(MidiEvent::beatToTick(beatVal))
 {
     this->id = this->createId();
 }
 
+MidiEvent::MidiEvent(MidiLayer *owner, Id existingId, Tick tickVal) :
+    layer(owner),
+    tick(tickVal),
+    id(existingId)
+{
+}
+
 MidiEvent::~MidiEvent()
 {
 
@@ -46,15 +53,31 @@ MidiEvent::Id MidiEvent::getID() const noexcept
 
 float MidiEvent::getBeat() const noexcept
 {
-    return this->beat;
+    return float(MidiEvent::tickToBeat(this->tick));
+}
+
+MidiEvent::Tick MidiEvent::getTick() const noexcept
+{
+    return this->tick;
 }
 
 //static MidiEvent::Id recentId = 0;
 
 MidiEvent::Id MidiEvent::createId() noexcept
 {
+    // The same half of the uuid as it used to be, so the text form is the same as well
     Uuid uuid;
-    return uuid.toString().substring(16, 32);
+    return static_cast<Id>(ByteOrder::bigEndianInt64(uuid.getRawData() + 8));
 //    return ++recentId;
 }
 
+String MidiEvent::idToString(const Id id)
+{
+    return String::toHexString(id).paddedLeft('0', 16);
+}
+
+MidiEvent::Id MidiEvent::idFromString(const String &text)
+{
+    return static_cast<Id>(text.getHexValue64());
+}
+
@@ -21,18 +21,25 @@
 
 class MidiLayer;
 
+// Events are positioned in whole ticks, so that sorting and equality checks stay exact
+// however far from the start they are; beats are only used at the boundaries
+// (UI, import/export and documents)
+#define MIDI_EVENT_TICKS_PER_BEAT 960
+
 class MidiEvent : public Serializable
 {
 public:
 
-    using Id = String;
-
     // 128 бит нам ни к чему, пусть будет 64,
     // с моими раскладами остается вероятность коллизии где-то 10^-8 .. 10^-11
     // при самых пессимистичных прогнозах,
     // а так, если на одном слое будет ~4000 нот, эта вероятность будет 4 * 10^-13
 
-    //using Id = int64;
+    // Kept as a number, so that comparing, hashing and copying events is cheap;
+    // documents still have it as 16 hex digits, see idToString/idFromString
+    using Id = int64;
+
+    using Tick = int64;
 
     MidiEvent(MidiLayer *owner, float beat);
 
@@ -40,6 +47,23 @@ public:
 
     virtual Array<MidiMessage> getSequence() const = 0;
 
+    // The owner layer's settings which the messages depend on
+    struct LayerParameters
+    {
+        int channel;
+        int controllerNumber;
+        bool isTempoLayer;
+    };
+
+    // Same, but with the next event of the layer (nullptr for the last one) and the
+    // layer's parameters passed in instead of read from the owner layer, so that
+    // snapshots can export their events without touching the live layer
+    virtual Array<MidiMessage> getSequenceFollowedBy(const MidiEvent *, const LayerParameters &) const
+    { return this->getSequence(); }
+
+    // A copy of the same type, with the same id and owner, for the layer snapshots
+    virtual MidiEvent *copy() const = 0;
+
 
     //===------------------------------------------------------------------===//
     // Accessors
@@ -51,6 +75,18 @@ public:
 
     float getBeat() const noexcept;
 
+    Tick getTick() const noexcept;
+
+    static Tick beatToTick(double beat) noexcept
+    {
+        return static_cast<Tick>(std::llround(beat * MIDI_EVENT_TICKS_PER_BEAT));
+    }
+
+    static double tickToBeat(Tick tick) noexcept
+    {
+        return double(tick) / MIDI_EVENT_TICKS_PER_BEAT;
+    }
+
     // эта штука используется для сортировки списка событий:
     // сортировка списка событий нужна в двух целях
     // для бинарного поиска конкретного элемента по отсортированному списку
@@ -62,18 +98,39 @@ public:
     {
         if (first == second) { return 0; }
         
-        const float diff = first->getBeat() - second->getBeat();
-        const int diffResult = (diff > 0.f) - (diff < 0.f);
-        if (diffResult != 0) { return diffResult; }
+        const int tickResult = MidiEvent::compareTicks(first->getTick(), second->getTick());
+        if (tickResult != 0) { return tickResult; }
         
-        return first->getID().compare(second->getID());
+        return MidiEvent::compareIds(first->getID(), second->getID());
+    }
+
+    static int compareTicks(const Tick first, const Tick second) noexcept
+    {
+        return (first > second) - (first < second);
+    }
+
+    static int compareIds(const Id first, const Id second) noexcept
+    {
+        return (first > second) - (first < second);
     }
 
+    static int hashId(const Id id) noexcept
+    {
+        return static_cast<int>(id ^ (id >> 32));
+    }
+
+    static String idToString(const Id id);
+
+    static Id idFromString(const String &text);
+
 protected:
 
+    // Copies keep the id, so there's no need to generate a new one
+    MidiEvent(MidiLayer *owner, Id existingId, Tick tick);
+
     MidiLayer *layer;
 
-    float beat;
+    Tick tick;
 
     static Id createId() noexcept;
 
@@ -22,7 +22,7 @@
 #include "SerializationKeys.h"
 
 
-Note::Note() : MidiEvent(nullptr, 0.f)
+Note::Note() : MidiEvent(nullptr, 0, 0)
 {
     // needed for juce's Array
     // should never be called.
@@ -32,41 +32,49 @@ Note::Note() : MidiEvent(nullptr, 0.f)
 Note::Note(MidiLayer *owner, int keyVal, float beatVal, float lengthVal, float velocityVal) :
     MidiEvent(owner, beatVal),
     key(keyVal),
-    length(lengthVal),
+    length(MidiEvent::beatToTick(lengthVal)),
     velocity(velocityVal)
 {
 
 }
 
 Note::Note(const Note &other) :
-    MidiEvent(other.layer, other.beat),
+    MidiEvent(other.layer, other.id, other.tick),
     key(other.key),
     length(other.length),
     velocity(other.velocity)
 {
-    this->id = other.getID();
 }
 
 Note::Note(MidiLayer *newOwner, const Note &parametersToCopy) :
-    MidiEvent(newOwner, parametersToCopy.beat),
+    MidiEvent(newOwner, parametersToCopy.id, parametersToCopy.tick),
     key(parametersToCopy.key),
     length(parametersToCopy.length),
     velocity(parametersToCopy.velocity)
 {
-    this->id = parametersToCopy.getID();
 }
 
 
+MidiEvent *Note::copy() const
+{
+    return new Note(*this);
+}
+
 Array<MidiMessage> Note::getSequence() const
+{
+    return this->getSequenceFollowedBy(nullptr, this->layer->getEventParameters());
+}
+
+Array<MidiMessage> Note::getSequenceFollowedBy(const MidiEvent *, const LayerParameters &parameters) const
 {
 	Array<MidiMessage> result;
 
-    MidiMessage eventNoteOn(MidiMessage::noteOn(this->layer->getChannel(), this->key, velocity));
-    const float &startTime = this->beat * Transport::millisecondsPerBeat;
+    MidiMessage eventNoteOn(MidiMessage::noteOn(parameters.channel, this->key, velocity));
+    const double startTime = MidiEvent::tickToBeat(this->tick) * Transport::millisecondsPerBeat;
     eventNoteOn.setTimeStamp(startTime);
 
-    MidiMessage eventNoteOff(MidiMessage::noteOff(this->layer->getChannel(), this->key));
-    const float &endTime = (this->beat + this->length) * Transport::millisecondsPerBeat;
+    MidiMessage eventNoteOff(MidiMessage::noteOff(parameters.channel, this->key));
+    const double endTime = MidiEvent::tickToBeat(this->tick + this->length) * Transport::millisecondsPerBeat;
     eventNoteOff.setTimeStamp(endTime);
 
     result.add(eventNoteOn);
@@ -89,18 +97,18 @@ Note Note::copyWithNewId(MidiLayer *newOwner) const
 }
 
 
-static float roundBeat(float beat)
+// Notes are snapped to 1/16 of a beat
+#define NOTE_SNAP_TICKS (MIDI_EVENT_TICKS_PER_BEAT / 16)
+
+static MidiEvent::Tick roundTick(MidiEvent::Tick tick)
 {
-    //return beat;
-    return roundf(beat * 16.f) / 16.f;
-    //return roundf(beat * 1000.f) / 1000.f;
+    return static_cast<MidiEvent::Tick>(std::llround(double(tick) / NOTE_SNAP_TICKS)) * NOTE_SNAP_TICKS;
 }
 
 Note Note::withBeat(float newBeat) const
 {
     Note other(*this);
-    //other.beat = newBeat;
-    other.beat = roundBeat(newBeat);
+    other.tick = roundTick(MidiEvent::beatToTick(newBeat));
     return other;
 }
 
@@ -108,16 +116,14 @@ Note Note::withKeyBeat(int newKey, float newBeat) const
 {
     Note other(*this);
     other.key = jmin(jmax(newKey, 0), 128);
-    //other.beat = newBeat;
-    other.beat = roundBeat(newBeat);
+    other.tick = roundTick(MidiEvent::beatToTick(newBeat));
     return other;
 }
 
 Note Note::withDeltaBeat(float deltaPosition) const
 {
     Note other(*this);
-    //other.beat = other.beat + deltaPosition;
-    other.beat = roundBeat(other.beat + deltaPosition);
+    other.tick = roundTick(other.tick + MidiEvent::beatToTick(deltaPosition));
     return other;
 }
 
@@ -128,21 +134,19 @@ Note Note::withDeltaKey(int deltaKey) const
     return other;
 }
 
-#define MIN_LENGTH 0.5f
+#define MIN_LENGTH (MIDI_EVENT_TICKS_PER_BEAT / 2)
 
 Note Note::withLength(float newLength) const
 {
     Note other(*this);
-    //other.length = jmax(MIN_LENGTH, newLength);
-    other.length = jmax(MIN_LENGTH, roundBeat(newLength));
+    other.length = jmax(Tick(MIN_LENGTH), roundTick(MidiEvent::beatToTick(newLength)));
     return other;
 }
 
 Note Note::withDeltaLength(float deltaLength) const
 {
     Note other(*this);
-    //other.length = jmax(MIN_LENGTH, other.length + deltaLength);
-    other.length = jmax(MIN_LENGTH, roundBeat(other.length + deltaLength));
+    other.length = jmax(Tick(MIN_LENGTH), roundTick(other.length + MidiEvent::beatToTick(deltaLength)));
     return other;
 }
 
@@ -160,6 +164,17 @@ Note Note::withParameters(const XmlElement &xml) const
     return n;
 }
 
+Note Note::withExactParameters(Tick newTick, int newKey,
+                               Tick newLength, float newVelocity) const
+{
+    Note other(*this);
+    other.tick = newTick;
+    other.key = newKey;
+    other.length = newLength;
+    other.velocity = newVelocity;
+    return other;
+}
+
 //===----------------------------------------------------------------------===//
 // Accessors
 //===----------------------------------------------------------------------===//
@@ -170,6 +185,11 @@ int Note::getKey() const noexcept
 }
 
 float Note::getLength() const noexcept
+{
+    return float(MidiEvent::tickToBeat(this->length));
+}
+
+MidiEvent::Tick Note::getLengthInTicks() const noexcept
 {
     return this->length;
 }
@@ -190,10 +210,10 @@ XmlElement *Note::serialize() const
 {
     auto xml = new XmlElement(Serialization::Core::note);
     xml->setAttribute("key", this->key);
-    xml->setAttribute("beat", this->beat);
-    xml->setAttribute("len", this->length);
+    xml->setAttribute("beat", MidiEvent::tickToBeat(this->tick));
+    xml->setAttribute("len", MidiEvent::tickToBeat(this->length));
     xml->setAttribute("vel", roundFloatToInt(this->velocity * VELOCITY_SAVE_ACCURACY));
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("id", MidiEvent::idToString(this->id));
     return xml;
 }
 
@@ -205,13 +225,13 @@ void Note::deserialize(const XmlElement &xml)
 
     // здесь никаких проверок. посмотри, как быстро будет работать сериализация.
     const int xmlKey = xml.getIntAttribute("key");
-    const float xmlBeat = float(xml.getDoubleAttribute("beat"));
-    const float xmlLength = float(xml.getDoubleAttribute("len"));
+    const Tick xmlTick = MidiEvent::beatToTick(xml.getDoubleAttribute("beat"));
+    const Tick xmlLength = MidiEvent::beatToTick(xml.getDoubleAttribute("len"));
     const float xmlVelocity = float(xml.getIntAttribute("vel")) / VELOCITY_SAVE_ACCURACY;
-    const String& xmlId = xml.getStringAttribute("id");
+    const Id xmlId = MidiEvent::idFromString(xml.getStringAttribute("id"));
 
     this->key = xmlKey;
-    this->beat = xmlBeat;
+    this->tick = xmlTick;
     this->length = xmlLength;
     this->velocity = jmax(jmin(xmlVelocity, 1.f), 0.f);
     this->id = xmlId;
@@ -227,7 +247,7 @@ Note &Note::operator=(const Note &right)
     //if (this == &right) { return *this; }
     //this->layer = right.layer; // never do this
     this->id = right.id;
-    this->beat = right.beat;
+    this->tick = right.tick;
     this->key = right.key;
     this->length = right.length;
     this->velocity = right.velocity;
@@ -236,5 +256,5 @@ Note &Note::operator=(const Note &right)
 
 int Note::hashCode() const noexcept
 {
-    return this->getID().hashCode();
+    return MidiEvent::hashId(this->getID());
 }
@@ -40,6 +40,11 @@ public:
     ~Note() override {}
 
 	Array<MidiMessage> getSequence() const override;
+
+    Array<MidiMessage> getSequenceFollowedBy(const MidiEvent *nextEvent,
+                                             const LayerParameters &parameters) const override;
+
+    MidiEvent *copy() const override;
     
     
     Note copyWithNewId(MidiLayer *newOwner = nullptr) const;
@@ -59,6 +64,11 @@ public:
     Note withVelocity(float newVelocity) const;
 
     Note withParameters(const XmlElement &xml) const;
+
+    // No snapping or clamping here, so that undo actions
+    // could restore the notes exactly as they were
+    Note withExactParameters(Tick newTick, int newKey,
+                             Tick newLength, float newVelocity) const;
     
 
     //===------------------------------------------------------------------===//
@@ -69,6 +79,8 @@ public:
 
     float getLength() const noexcept;
 
+    Tick getLengthInTicks() const noexcept;
+
     float getVelocity() const noexcept;
 
 
@@ -101,47 +113,46 @@ public:
     {
         if (first == second) { return 0; }
         
-        const float diff = first->getBeat() - second->getBeat();
-        const int diffResult = (diff > 0.f) - (diff < 0.f);
-        if (diffResult != 0) { return diffResult; }
+        const int tickResult = MidiEvent::compareTicks(first->getTick(), second->getTick());
+        if (tickResult != 0) { return tickResult; }
         
-        return first->getID().compare(second->getID());
+        return MidiEvent::compareIds(first->getID(), second->getID());
     }
     
     static int compareElements(Note *const first, Note *const second)
     {
         if (first == second) { return 0; }
         
-        const float beatDiff = first->getBeat() - second->getBeat();
-        const int beatResult = (beatDiff > 0.f) - (beatDiff < 0.f);
-        if (beatResult != 0) { return beatResult; }
+        const int tickResult = MidiEvent::compareTicks(first->getTick(), second->getTick());
+        if (tickResult != 0) { return tickResult; }
         
         const int keyDiff = first->getKey() - second->getKey();
         const int keyResult = (keyDiff > 0) - (keyDiff < 0);
         if (keyResult != 0) { return keyResult; }
         
-        return first->getID().compare(second->getID());
+        return MidiEvent::compareIds(first->getID(), second->getID());
     }
     
     static int compareElements(const Note &first, const Note &second)
     {
         if (&first == &second) { return 0; }
-        const float beatDiff = first.getBeat() - second.getBeat();
-        const int beatResult = (beatDiff > 0.f) - (beatDiff < 0.f);
-        if (beatResult != 0) { return beatResult; }
+        const int tickResult = MidiEvent::compareTicks(first.getTick(), second.getTick());
+        if (tickResult != 0) { return tickResult; }
         
         const int keyDiff = first.getKey() - second.getKey();
         const int keyResult = (keyDiff > 0) - (keyDiff < 0);
         if (keyResult != 0) { return keyResult; }
         
-        return first.getID().compare(second.getID());
+        return MidiEvent::compareIds(first.getID(), second.getID());
     }
 
 protected:
 
     int key;
 
-    float length, velocity;
+    Tick length;
+
+    float velocity;
 
 private:
 
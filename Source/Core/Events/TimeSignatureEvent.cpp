@@ -22,17 +22,16 @@
 #include "SerializationKeys.h"
 
 
-TimeSignatureEvent::TimeSignatureEvent() : MidiEvent(nullptr, 0.f)
+TimeSignatureEvent::TimeSignatureEvent() : MidiEvent(nullptr, 0, 0)
 {
     //jassertfalse;
 }
 
 TimeSignatureEvent::TimeSignatureEvent(const TimeSignatureEvent &other) :
-    MidiEvent(other.layer, other.beat),
+    MidiEvent(other.layer, other.id, other.tick),
     numerator(other.numerator),
     denominator(other.denominator)
 {
-    this->id = other.getID();
 }
 
 TimeSignatureEvent::TimeSignatureEvent(MidiLayer *owner,
@@ -70,11 +69,16 @@ void TimeSignatureEvent::parseString(const String &data, int &numerator, int &de
 }
 
 
+MidiEvent *TimeSignatureEvent::copy() const
+{
+    return new TimeSignatureEvent(*this);
+}
+
 Array<MidiMessage> TimeSignatureEvent::getSequence() const
 {
 	Array<MidiMessage> result;
     MidiMessage event(MidiMessage::timeSignatureMetaEvent(this->numerator, this->denominator));
-    event.setTimeStamp(this->beat * Transport::millisecondsPerBeat);
+    event.setTimeStamp(MidiEvent::tickToBeat(this->tick) * Transport::millisecondsPerBeat);
     result.add(event);
     return result;
 }
@@ -82,14 +86,14 @@ Array<MidiMessage> TimeSignatureEvent::getSequence() const
 TimeSignatureEvent TimeSignatureEvent::withDeltaBeat(float beatOffset) const
 {
     TimeSignatureEvent e(*this);
-    e.beat = e.beat + beatOffset;
+    e.tick = e.tick + MidiEvent::beatToTick(beatOffset);
     return e;
 }
 
 TimeSignatureEvent TimeSignatureEvent::withBeat(float newBeat) const
 {
     TimeSignatureEvent e(*this);
-    e.beat = newBeat;
+    e.tick = MidiEvent::beatToTick(newBeat);
     return e;
 }
 
@@ -151,8 +155,8 @@ XmlElement *TimeSignatureEvent::serialize() const
     auto xml = new XmlElement(Serialization::Core::timeSignature);
     xml->setAttribute("numerator", this->numerator);
     xml->setAttribute("denominator", this->denominator);
-    xml->setAttribute("beat", this->beat);
-    xml->setAttribute("id", this->id);
+    xml->setAttribute("beat", MidiEvent::tickToBeat(this->tick));
+    xml->setAttribute("id", MidiEvent::idToString(this->id));
     return xml;
 }
 
@@ -161,8 +165,8 @@ void TimeSignatureEvent::deserialize(const XmlElement &xml)
     this->reset();
     this->numerator = xml.getIntAttribute("numerator", TIME_SIGNATURE_DEFAULT_NUMERATOR);
     this->denominator = xml.getIntAttribute("denominator", TIME_SIGNATURE_DEFAULT_DENOMINATOR);
-    this->beat = float(xml.getDoubleAttribute("beat"));
-    this->id = xml.getStringAttribute("id");
+    this->tick = MidiEvent::beatToTick(xml.getDoubleAttribute("beat"));
+    this->id = MidiEvent::idFromString(xml.getStringAttribute("id"));
 }
 
 void TimeSignatureEvent::reset()
@@ -172,7 +176,7 @@ void TimeSignatureEvent::reset()
 
 int TimeSignatureEvent::hashCode() const noexcept
 {
-    return this->numerator + (100 * this->denominator) + this->id.hashCode();
+    return this->numerator + (100 * this->denominator) + MidiEvent::hashId(this->id);
 }
 
 TimeSignatureEvent &TimeSignatureEvent::operator=(const TimeSignatureEvent &right)
@@ -180,7 +184,7 @@ TimeSignatureEvent &TimeSignatureEvent::operator=(const TimeSignatureEvent &righ
     //if (this == &right) { return *this; }
     //this->layer = *right.getLayer(); // never do this
     this->id = right.id;
-    this->beat = right.beat;
+    this->tick = right.tick;
     this->numerator = right.numerator;
     this->denominator = right.denominator;
     return *this;
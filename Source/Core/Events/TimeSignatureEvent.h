@@ -43,6 +43,8 @@ public:
 	
 
 	Array<MidiMessage> getSequence() const override;
+
+    MidiEvent *copy() const override;
     
     TimeSignatureEvent copyWithNewId() const;
     
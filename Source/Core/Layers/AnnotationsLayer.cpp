@@ -78,6 +78,7 @@ void AnnotationsLayer::silentImport(const MidiEvent &eventToImport)
     this->midiEvents.addSorted(*storedAnnotation, storedAnnotation);
     //this->midiEvents.add(storedAnnotation);
     this->annotationsHashTable.set(annotation, storedAnnotation);
+    this->invalidateSequenceCache();
     
     this->updateBeatRange(false);
 }
@@ -78,6 +78,7 @@ void AutomationLayer::silentImport(const MidiEvent &eventToImport)
     
     this->midiEvents.addSorted(*storedEvent, storedEvent);
     this->eventsHashTable.set(autoEvent, storedEvent);
+    this->invalidateSequenceCache();
 
     this->updateBeatRange(false);
 }
@@ -154,13 +155,13 @@ bool AutomationLayer::change(const AutomationEvent &autoEvent, const AutomationE
     {
         if (AutomationEvent *matchingEvent = this->eventsHashTable[autoEvent])
         {
+            this->midiEvents.remove(this->indexOfSorted(matchingEvent), false);
             (*matchingEvent) = newAutoEvent;
+            this->midiEvents.addSorted(*matchingEvent, matchingEvent);
 
             this->eventsHashTable.removeValue(matchingEvent);
             this->eventsHashTable.set(newAutoEvent, matchingEvent);
             
-            this->sort();
-            
             this->notifyEventChanged(autoEvent, *matchingEvent);
             this->updateBeatRange(true);
             return true;
@@ -184,18 +185,30 @@ bool AutomationLayer::insertGroup(Array<AutomationEvent> &events, bool undoable)
     }
     else
     {
+        Array<MidiEvent *> storedEvents;
+        storedEvents.ensureStorageAllocated(events.size());
+
         for (int i = 0; i < events.size(); ++i)
         {
             const AutomationEvent &autoEvent = events.getUnchecked(i);
             auto storedEvent = new AutomationEvent(this);
             *storedEvent = autoEvent;
             
-            this->midiEvents.add(storedEvent); // sorted later
+            storedEvents.add(storedEvent);
             this->eventsHashTable.set(autoEvent, storedEvent);
-            this->notifyEventAdded(*storedEvent);
         }
         
-        this->sort();
+        this->mergeSorted(storedEvents);
+
+        LayerChangeSet changes(this);
+
+        for (auto storedEvent : storedEvents)
+        {
+            changes.eventAdded(*storedEvent);
+        }
+
+        this->notifyChangesBatch(changes);
+
         this->updateBeatRange(true);
     }
     
@@ -212,20 +225,35 @@ bool AutomationLayer::removeGroup(Array<AutomationEvent> &events, bool undoable)
     }
     else
     {
+        Array<MidiEvent *> removedEvents;
+        removedEvents.ensureStorageAllocated(events.size());
+
         for (int i = 0; i < events.size(); ++i)
         {
-            const AutomationEvent &autoEvent = events.getUnchecked(i);
-            
-            if (AutomationEvent *matchingEvent = this->eventsHashTable[autoEvent])
+            if (AutomationEvent *matchingEvent = this->eventsHashTable[events.getUnchecked(i)])
             {
-                this->notifyEventRemoved(*matchingEvent);
-                this->midiEvents.removeObject(matchingEvent);
-                this->eventsHashTable.removeValue(matchingEvent);
+                removedEvents.add(matchingEvent);
             }
         }
-        
+
+        this->detachSorted(removedEvents);
+
+        // The listeners still need the events to be alive, so they are deleted afterwards
+        OwnedArray<MidiEvent> eventsToDelete;
+        eventsToDelete.ensureStorageAllocated(removedEvents.size());
+        LayerChangeSet changes(this);
+
+        for (auto removedEvent : removedEvents)
+        {
+            AutomationEvent *autoEvent = static_cast<AutomationEvent *>(removedEvent);
+            this->eventsHashTable.removeValue(autoEvent);
+            eventsToDelete.add(autoEvent);
+            changes.eventRemoved(*autoEvent);
+        }
+
+        this->notifyChangesBatch(changes);
+        eventsToDelete.clear();
         this->updateBeatRange(true);
-        this->notifyEventRemovedPostAction();
     }
     
     return true;
@@ -246,16 +274,32 @@ bool AutomationLayer::changeGroup(const Array<AutomationEvent> eventsBefore,
     }
     else
     {
+        Array<AutomationEvent *> matchingEvents;
+        Array<MidiEvent *> movedEvents;
+        matchingEvents.ensureStorageAllocated(eventsBefore.size());
+        movedEvents.ensureStorageAllocated(eventsBefore.size());
+
+        for (int i = 0; i < eventsBefore.size(); ++i)
+        {
+            AutomationEvent *matchingEvent = this->eventsHashTable[eventsBefore.getUnchecked(i)];
+            matchingEvents.add(matchingEvent);
+
+            if (matchingEvent != nullptr)
+            {
+                movedEvents.add(matchingEvent);
+            }
+        }
+
+        this->detachSorted(movedEvents);
+
         for (int i = 0; i < eventsBefore.size(); ++i)
         {
             // doing this sucks
             //this->change(eventsBefore[i], eventsAfter[i], false);
             
-            const AutomationEvent &autoEvent = eventsBefore.getUnchecked(i);
-            const AutomationEvent &newAutoEvent = eventsAfter.getUnchecked(i);
-            
-            if (AutomationEvent *matchingEvent = this->eventsHashTable[autoEvent])
+            if (AutomationEvent *matchingEvent = matchingEvents.getUnchecked(i))
             {
+                const AutomationEvent &newAutoEvent = eventsAfter.getUnchecked(i);
                 (*matchingEvent) = newAutoEvent;
                 //this->eventsHashTable.removeValue(matchingEvent);
                 this->eventsHashTable.set(newAutoEvent, matchingEvent);
@@ -263,7 +307,7 @@ bool AutomationLayer::changeGroup(const Array<AutomationEvent> eventsBefore,
             }
         }
         
-        this->sort();
+        this->mergeSorted(movedEvents);
         this->notifyLayerChanged();
         this->updateBeatRange(true);
     }
@@ -0,0 +1,45 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "LayerChangeSet.h"
+
+LayerChangeSet::LayerChangeSet(const MidiLayer *targetLayer) :
+    layer(targetLayer) {}
+
+void LayerChangeSet::eventAdded(const MidiEvent &event)
+{
+    this->addedEvents.add(&event);
+}
+
+void LayerChangeSet::eventRemoved(const MidiEvent &event)
+{
+    this->removedEvents.add(&event);
+}
+
+void LayerChangeSet::eventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent)
+{
+    this->changedEventsBefore.add(&oldEvent);
+    this->changedEventsAfter.add(&newEvent);
+}
+
+bool LayerChangeSet::isEmpty() const noexcept
+{
+    return this->addedEvents.isEmpty() &&
+           this->removedEvents.isEmpty() &&
+           this->changedEventsBefore.isEmpty();
+}
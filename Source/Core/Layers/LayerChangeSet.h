@@ -0,0 +1,95 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+class MidiEvent;
+class MidiLayer;
+
+// All the events added, removed and changed in a layer by one group operation,
+// so that the listeners can handle them at once instead of one by one.
+// The events are only guaranteed to be alive while the change set is being delivered:
+// the removed ones are deleted right after that.
+
+class LayerChangeSet
+{
+public:
+
+    explicit LayerChangeSet(const MidiLayer *targetLayer);
+
+    void eventAdded(const MidiEvent &event);
+
+    void eventRemoved(const MidiEvent &event);
+
+    void eventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent);
+
+    const MidiLayer *getLayer() const noexcept
+    { return this->layer; }
+
+    bool isEmpty() const noexcept;
+
+    const Array<const MidiEvent *> &getAddedEvents() const noexcept
+    { return this->addedEvents; }
+
+    const Array<const MidiEvent *> &getRemovedEvents() const noexcept
+    { return this->removedEvents; }
+
+    // Both arrays are of the same size, and match each other by index
+    const Array<const MidiEvent *> &getChangedEventsBefore() const noexcept
+    { return this->changedEventsBefore; }
+
+    const Array<const MidiEvent *> &getChangedEventsAfter() const noexcept
+    { return this->changedEventsAfter; }
+
+    // Fallback for the listeners which don't handle the batches themselves:
+    // replays the changes one by one, in the same order as the single edits would do
+    template <typename Listener>
+    void sendTo(Listener &listener) const
+    {
+        for (auto event : this->removedEvents)
+        {
+            listener.onEventRemoved(*event);
+        }
+
+        if (this->removedEvents.size() > 0)
+        {
+            listener.onEventRemovedPostAction(this->layer);
+        }
+
+        for (int i = 0; i < this->changedEventsBefore.size(); ++i)
+        {
+            listener.onEventChanged(*this->changedEventsBefore.getUnchecked(i),
+                                    *this->changedEventsAfter.getUnchecked(i));
+        }
+
+        for (auto event : this->addedEvents)
+        {
+            listener.onEventAdded(*event);
+        }
+    }
+
+private:
+
+    const MidiLayer *layer;
+
+    Array<const MidiEvent *> addedEvents;
+    Array<const MidiEvent *> removedEvents;
+    Array<const MidiEvent *> changedEventsBefore;
+    Array<const MidiEvent *> changedEventsAfter;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LayerChangeSet)
+};
@@ -22,6 +22,7 @@
 #include "MidiRoll.h"
 #include "ProjectTreeItem.h"
 #include "UndoStack.h"
+#include "SerializationKeys.h"
 
 MidiLayer::MidiLayer(MidiLayerOwner &parent) :
     owner(parent),
@@ -31,10 +32,14 @@ MidiLayer::MidiLayer(MidiLayerOwner &parent) :
     cachedSequence(),
     lastStartBeat(0.f),
     cacheIsOutdated(false),
+    revision(0),
+    workingSnapshot(new MidiLayerSnapshot()),
+    snapshotIsOutdated(false),
     lastEndBeat(0.f),
     instrumentId(String::empty),
     controllerNumber(0)
 {
+    this->publishedSnapshot = this->workingSnapshot;
 }
 
 MidiLayer::~MidiLayer()
@@ -58,6 +63,108 @@ void MidiLayer::sort()
     {
         this->midiEvents.sort(*this->midiEvents.getUnchecked(0));
     }
+
+    this->invalidateSequenceCache();
+}
+
+void MidiLayer::detachSorted(Array<MidiEvent *> &events)
+{
+    Array<int> indices;
+    indices.ensureStorageAllocated(events.size());
+
+    for (auto event : events)
+    {
+        const int index = this->indexOfSorted(event);
+        jassert(index >= 0);
+
+        if (index >= 0)
+        {
+            indices.add(index);
+        }
+    }
+
+    events.clearQuick();
+
+    if (indices.size() == 0)
+    {
+        return;
+    }
+
+    DefaultElementComparator<int> comparator;
+    indices.sort(comparator);
+
+    MidiEvent **data = this->midiEvents.getRawDataPointer();
+    const int numEvents = this->midiEvents.size();
+    int numDetached = 0;
+
+    for (int i = indices.getFirst(), j = 0; i < numEvents; ++i)
+    {
+        if (j < indices.size() && indices.getUnchecked(j) == i)
+        {
+            events.add(data[i]);
+            ++numDetached;
+
+            while (j < indices.size() && indices.getUnchecked(j) == i) { ++j; }
+            continue;
+        }
+
+        data[i - numDetached] = data[i];
+    }
+
+    this->midiEvents.removeLast(numDetached, false);
+    this->incrementRevision();
+}
+
+void MidiLayer::mergeSorted(Array<MidiEvent *> &events)
+{
+    const int numNewEvents = events.size();
+
+    if (numNewEvents == 0)
+    {
+        return;
+    }
+
+    if (numNewEvents == 1)
+    {
+        MidiEvent *event = events.getFirst();
+        this->midiEvents.addSorted(*event, event);
+        this->incrementRevision();
+        return;
+    }
+
+    events.sort(*events.getFirst());
+
+    // Growing the array first, and then merging from its end,
+    // so that the existing events are only moved once
+    const int numOldEvents = this->midiEvents.size();
+    this->midiEvents.ensureStorageAllocated(numOldEvents + numNewEvents);
+
+    for (int i = 0; i < numNewEvents; ++i)
+    {
+        this->midiEvents.add(nullptr);
+    }
+
+    MidiEvent **data = this->midiEvents.getRawDataPointer();
+    int oldIndex = numOldEvents - 1;
+    int newIndex = numNewEvents - 1;
+    int targetIndex = numOldEvents + numNewEvents - 1;
+
+    while (newIndex >= 0)
+    {
+        MidiEvent *newEvent = events.getUnchecked(newIndex);
+
+        if (oldIndex >= 0 && MidiEvent::compareElements(data[oldIndex], newEvent) > 0)
+        {
+            data[targetIndex--] = data[oldIndex--];
+        }
+        else
+        {
+            data[targetIndex--] = newEvent;
+            --newIndex;
+        }
+    }
+
+    this->incrementRevision();
 }
 
 void MidiLayer::allNotesOff()
@@ -143,36 +250,44 @@ void MidiLayer::clearUndoHistory()
 // Import/export
 //
 
-MidiMessageSequence MidiLayer::exportMidi() const
+const MidiMessageSequence &MidiLayer::exportMidi() const
 {
     if (this->isMuted())
     {
-        return MidiMessageSequence();
+        static const MidiMessageSequence emptySequence;
+        return emptySequence;
     }
     
-    if (this->cacheIsOutdated)
+    if (this->cacheIsOutdated || ! this->patchSequence(this->cachedSequence))
     {
         this->cachedSequence.clear();
+        this->fillSequence(this->cachedSequence);
+        //this->cachedSequence.sort();
+        this->cacheIsOutdated = false;
+    }
 
-        for (auto event : this->midiEvents)
-        {
-			const Array<MidiMessage> &track = event->getSequence();
+    return this->cachedSequence;
+}
 
-			for (auto &message : track)
-			{
-				this->cachedSequence.addEvent(message);
-			}
+void MidiLayer::fillSequence(MidiMessageSequence &sequence) const
+{
+    for (auto event : this->midiEvents)
+    {
+        const Array<MidiMessage> &track = event->getSequence();
 
-			// need to call it here?
-			//this->cachedSequence.updateMatchedPairs();
+        for (auto &message : track)
+        {
+            sequence.addEvent(message);
         }
-
-        this->cachedSequence.updateMatchedPairs();
-        //this->cachedSequence.sort();
-        this->cacheIsOutdated = false;
     }
 
-    return this->cachedSequence;
+    sequence.updateMatchedPairs();
+}
+
+bool MidiLayer::patchSequence(MidiMessageSequence &sequence) const
+{
+    // Nothing to patch, all changes have dropped the cache
+    return true;
 }
 
 
@@ -207,7 +322,7 @@ int MidiLayer::getChannel() const
 
 void MidiLayer::setChannel(int val)
 {
-    this->cacheIsOutdated = true;
+    this->invalidateSequenceCache();
     this->channel = val;
 }
 
@@ -265,31 +380,84 @@ UndoStack *MidiLayer::getUndoStack()
 
 void MidiLayer::notifyEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
-    this->cacheIsOutdated = true;
+    if (oldEvent.getID() != newEvent.getID())
+    {
+        this->invalidateSequenceCacheFor(oldEvent, true);
+    }
+
+    this->invalidateSequenceCacheFor(newEvent, false);
+    this->updateSnapshotFor(oldEvent, true);
+    this->updateSnapshotFor(newEvent, false);
+    this->publishSnapshot();
     this->owner.onEventChanged(oldEvent, newEvent);
 }
 
 void MidiLayer::notifyEventAdded(const MidiEvent &event)
 {
-    this->cacheIsOutdated = true;
+    this->invalidateSequenceCacheFor(event, false);
+    this->updateSnapshotFor(event, false);
+    this->publishSnapshot();
     this->owner.onEventAdded(event);
 }
 
 void MidiLayer::notifyEventRemoved(const MidiEvent &event)
 {
-    this->cacheIsOutdated = true;
+    this->invalidateSequenceCacheFor(event, true);
+    this->updateSnapshotFor(event, true);
+    this->publishSnapshot();
     this->owner.onEventRemoved(event);
 }
 
 void MidiLayer::notifyEventRemovedPostAction()
 {
-    this->cacheIsOutdated = true;
+    // Each of the removed events has been reported already
+    this->incrementRevision();
     this->owner.onEventRemovedPostAction(this);
 }
 
+void MidiLayer::notifyChangesBatch(const LayerChangeSet &changes)
+{
+    if (changes.isEmpty())
+    {
+        return;
+    }
+
+    for (auto event : changes.getRemovedEvents())
+    {
+        this->invalidateSequenceCacheFor(*event, true);
+        this->updateSnapshotFor(*event, true);
+    }
+
+    const Array<const MidiEvent *> &changedBefore = changes.getChangedEventsBefore();
+    const Array<const MidiEvent *> &changedAfter = changes.getChangedEventsAfter();
+
+    for (int i = 0; i < changedBefore.size(); ++i)
+    {
+        if (changedBefore.getUnchecked(i)->getID() != changedAfter.getUnchecked(i)->getID())
+        {
+            this->invalidateSequenceCacheFor(*changedBefore.getUnchecked(i), true);
+        }
+
+        this->invalidateSequenceCacheFor(*changedAfter.getUnchecked(i), false);
+        this->updateSnapshotFor(*changedBefore.getUnchecked(i), true);
+        this->updateSnapshotFor(*changedAfter.getUnchecked(i), false);
+    }
+
+    for (auto event : changes.getAddedEvents())
+    {
+        this->invalidateSequenceCacheFor(*event, false);
+        this->updateSnapshotFor(*event, false);
+    }
+
+    this->incrementRevision();
+    this->publishSnapshot();
+    this->owner.onChangesBatch(changes);
+}
+
 void MidiLayer::notifyLayerChanged()
 {
-    this->cacheIsOutdated = true;
+    this->invalidateSequenceCache();
+    this->publishSnapshot();
     this->owner.onLayerChanged(this);
 }
 
@@ -299,6 +467,90 @@ void MidiLayer::notifyBeatRangeChanged()
     this->owner.onBeatRangeChanged();
 }
 
+void MidiLayer::invalidateSequenceCache() noexcept
+{
+    this->cacheIsOutdated = true;
+    this->snapshotIsOutdated = true;
+    this->incrementRevision();
+}
+
+void MidiLayer::invalidateSequenceCacheFor(const MidiEvent &event, bool isRemoved)
+{
+    // The snapshot is still updated event by event
+    this->cacheIsOutdated = true;
+    this->incrementRevision();
+}
+
+void MidiLayer::incrementRevision() noexcept
+{
+    ++this->revision;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Snapshots
+//===----------------------------------------------------------------------===//
+
+MidiLayerSnapshot::Ptr MidiLayer::getSnapshot() const
+{
+    // The layer only changes on the message thread, so that's the only place
+    // where it is safe to rebuild the snapshot from the events
+    if (MessageManager *messageManager = MessageManager::getInstanceWithoutCreating())
+    {
+        if (messageManager->isThisTheMessageThread() && this->snapshotIsOutdated)
+        {
+            this->publishSnapshot();
+        }
+    }
+
+    const SpinLock::ScopedLockType lock(this->snapshotLock);
+    return this->publishedSnapshot;
+}
+
+void MidiLayer::updateSnapshotFor(const MidiEvent &event, bool isRemoved)
+{
+    if (this->snapshotIsOutdated)
+    {
+        return;
+    }
+
+    // Detaching from the published snapshot, if not done yet:
+    // the chunks themselves are only copied when changed
+    if (this->workingSnapshot == this->publishedSnapshot)
+    {
+        this->workingSnapshot = new MidiLayerSnapshot(*this->workingSnapshot);
+    }
+
+    if (isRemoved)
+    {
+        this->workingSnapshot->remove(event);
+    }
+    else
+    {
+        this->workingSnapshot->insert(event);
+    }
+}
+
+void MidiLayer::publishSnapshot() const
+{
+    if (this->snapshotIsOutdated)
+    {
+        this->workingSnapshot = new MidiLayerSnapshot();
+        this->workingSnapshot->rebuild(this->midiEvents);
+        this->snapshotIsOutdated = false;
+    }
+    else if (this->workingSnapshot == this->publishedSnapshot)
+    {
+        return;
+    }
+
+    this->workingSnapshot->revision = this->revision;
+    this->workingSnapshot->layerParameters = this->getEventParameters();
+
+    const SpinLock::ScopedLockType lock(this->snapshotLock);
+    this->publishedSnapshot = this->workingSnapshot;
+}
+
 void MidiLayer::updateBeatRange(bool shouldNotifyIfChanged)
 {
     if (this->lastStartBeat == this->getFirstBeat() &&
@@ -345,6 +597,7 @@ void MidiLayer::setControllerNumber(int val)
 {
     if (this->controllerNumber != val)
     {
+        this->invalidateSequenceCache();
         this->controllerNumber = val;
     }
 }
@@ -354,6 +607,15 @@ bool MidiLayer::isTempoLayer() const noexcept
     return (this->controllerNumber == MidiLayer::tempoController);
 }
 
+MidiEvent::LayerParameters MidiLayer::getEventParameters() const noexcept
+{
+    MidiEvent::LayerParameters parameters;
+    parameters.channel = this->channel;
+    parameters.controllerNumber = this->controllerNumber;
+    parameters.isTempoLayer = this->isTempoLayer();
+    return parameters;
+}
+
 bool MidiLayer::isSustainPedalLayer() const noexcept
 {
     return (this->controllerNumber == MidiLayer::sustainPedalController);
@@ -377,6 +639,14 @@ String MidiLayer::getLayerIdAsString() const
     return this->layerId.toString();
 }
 
+bool MidiLayer::isLayerXml(const XmlElement &xml)
+{
+    return xml.hasTagName(Serialization::Core::track) ||
+           xml.hasTagName(Serialization::Core::automation) ||
+           xml.hasTagName(Serialization::Core::annotations) ||
+           xml.hasTagName(Serialization::Core::timeSignatures);
+}
+
 void MidiLayer::setLayerId(const String &id)
 {
     this->layerId = Uuid(id);
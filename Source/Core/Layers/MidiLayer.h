@@ -20,6 +20,7 @@
 #include "Serializable.h"
 #include "MidiLayerOwner.h"
 #include "MidiEvent.h"
+#include "MidiLayerSnapshot.h"
 
 class LayerTreeItem;
 class UndoStack;
@@ -59,9 +60,16 @@ public:
     // Import/export
     //===------------------------------------------------------------------===//
 
-    MidiMessageSequence exportMidi() const;
+    // Returns the cached sequence, which stays valid until the next change of the layer;
+    // message thread only, other threads should export a snapshot instead
+    const MidiMessageSequence &exportMidi() const;
     virtual void importMidi(const MidiMessageSequence &sequence) = 0;
 
+    // Safe to call from any thread, see MidiLayerSnapshot; other threads get the last
+    // published snapshot, which lags behind only after the whole layer is reloaded,
+    // until the next edit or the next call on the message thread
+    MidiLayerSnapshot::Ptr getSnapshot() const;
+
     //===------------------------------------------------------------------===//
     // Track editing
     //===------------------------------------------------------------------===//
@@ -77,6 +85,10 @@ public:
     virtual float getFirstBeat() const;
     virtual float getLastBeat() const;
 
+    // Changes every time the events are changed, so that derived data can be cached
+    inline int getRevision() const noexcept
+    { return this->revision; }
+
     int getChannel() const;
     void setChannel(int val);
 
@@ -121,6 +133,7 @@ public:
     void notifyEventAdded(const MidiEvent &event);
     void notifyEventRemoved(const MidiEvent &event);
     void notifyEventRemovedPostAction();
+    void notifyChangesBatch(const LayerChangeSet &changes);
     void notifyLayerChanged();
     void notifyBeatRangeChanged();
     void updateBeatRange(bool shouldNotifyIfChanged);
@@ -139,16 +152,53 @@ public:
     
     bool isTempoLayer() const noexcept;
     bool isSustainPedalLayer() const noexcept;
+
+    // Captured by the snapshots, see MidiEvent::getSequenceFollowedBy
+    MidiEvent::LayerParameters getEventParameters() const noexcept;
     bool isOnOffLayer() const noexcept;
 
     // используется в плеере для связки с инструментами
     Uuid getLayerId() const noexcept;
     String getLayerIdAsString() const;
 
+    // True for the xml of any kind of layer
+    static bool isLayerXml(const XmlElement &xml);
+
 protected:
 
     void setLayerId(const String &id);
 
+    // Builds the sequence to be cached by exportMidi
+    virtual void fillSequence(MidiMessageSequence &sequence) const;
+
+    // Brings the cached sequence up to date with the events reported
+    // through invalidateSequenceCacheFor; returns false, if it needs a full rebuild instead
+    virtual bool patchSequence(MidiMessageSequence &sequence) const;
+
+    // Drops the whole cached sequence
+    void invalidateSequenceCache() noexcept;
+
+    // Called for each single event added, changed or removed;
+    // layers that can patch their cached sequence remember the event here,
+    // the rest just drop the whole cache
+    virtual void invalidateSequenceCacheFor(const MidiEvent &event, bool isRemoved);
+
+    // For the changes which don't affect the cached sequence, but change the events array
+    void incrementRevision() noexcept;
+
+    // Single changes are applied to the working snapshot, which is published
+    // after each notification; the whole layer reloads make it rebuilt instead
+    void updateSnapshotFor(const MidiEvent &event, bool isRemoved);
+    void publishSnapshot() const;
+
+    // Edits keep the array sorted without re-sorting the whole layer:
+    // the events to be moved are detached before their beats are changed,
+    // and merged back afterwards, along with the new ones, in a linear pass.
+    // detachSorted leaves the list with the detached events only, in the layer's order,
+    // so that duplicates in the list are harmless
+    void detachSorted(Array<MidiEvent *> &events);
+    void mergeSorted(Array<MidiEvent *> &events);
+
     float lastEndBeat;
     float lastStartBeat;
     
@@ -169,6 +219,12 @@ private:
 
     mutable MidiMessageSequence cachedSequence;
     mutable bool cacheIsOutdated;
+    int revision;
+
+    mutable MidiLayerSnapshot::Ptr workingSnapshot;
+    mutable MidiLayerSnapshot::Ptr publishedSnapshot;
+    mutable bool snapshotIsOutdated;
+    mutable SpinLock snapshotLock;
 
     MidiLayerOwner &owner;
 
@@ -0,0 +1,256 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "MidiLayerSnapshot.h"
+
+struct SnapshotEventsComparator
+{
+    static int compareElements(const MidiEvent *const first, const MidiEvent *const second)
+    {
+        return MidiEvent::compareElements(first, second);
+    }
+};
+
+MidiLayerSnapshot::Chunk::Chunk(const Chunk &other)
+{
+    this->events.ensureStorageAllocated(other.events.size());
+
+    for (auto event : other.events)
+    {
+        this->events.add(event->copy());
+    }
+}
+
+MidiLayerSnapshot::MidiLayerSnapshot() :
+    numEvents(0),
+    revision(0)
+{
+    this->layerParameters.channel = 1;
+    this->layerParameters.controllerNumber = 0;
+    this->layerParameters.isTempoLayer = false;
+}
+
+MidiLayerSnapshot::MidiLayerSnapshot(const MidiLayerSnapshot &other) :
+    chunks(other.chunks),
+    chunkStarts(other.chunkStarts),
+    numEvents(other.numEvents),
+    revision(other.revision),
+    layerParameters(other.layerParameters) {}
+
+const MidiEvent *MidiLayerSnapshot::getUnchecked(int index) const noexcept
+{
+    jassert(isPositiveAndBelow(index, this->numEvents));
+
+    // The last chunk which starts at or before the index
+    int low = 0;
+    int high = this->chunkStarts.size();
+
+    while (high - low > 1)
+    {
+        const int middle = (low + high) / 2;
+
+        if (this->chunkStarts.getUnchecked(middle) <= index)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    const Chunk *chunk = this->chunks.getObjectPointerUnchecked(low);
+    return chunk->events.getUnchecked(index - this->chunkStarts.getUnchecked(low));
+}
+
+MidiMessageSequence MidiLayerSnapshot::exportMidi() const
+{
+    MidiMessageSequence sequence;
+
+    // Each event gets its successor from the snapshot itself, possibly from the
+    // next non-empty chunk, as the live layer may be changing meanwhile
+    const MidiEvent *event = nullptr;
+
+    for (auto chunk : this->chunks)
+    {
+        for (auto next : chunk->events)
+        {
+            if (event != nullptr)
+            {
+                const Array<MidiMessage> &track = event->getSequenceFollowedBy(next, this->layerParameters);
+
+                for (auto &message : track)
+                {
+                    sequence.addEvent(message);
+                }
+            }
+
+            event = next;
+        }
+    }
+
+    if (event != nullptr)
+    {
+        const Array<MidiMessage> &track = event->getSequenceFollowedBy(nullptr, this->layerParameters);
+
+        for (auto &message : track)
+        {
+            sequence.addEvent(message);
+        }
+    }
+
+    sequence.updateMatchedPairs();
+    return sequence;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Changing
+//===----------------------------------------------------------------------===//
+
+void MidiLayerSnapshot::rebuild(const OwnedArray<MidiEvent> &events)
+{
+    this->chunks.clear();
+
+    for (int i = 0; i < events.size(); i += MIDI_LAYER_SNAPSHOT_CHUNK_SIZE)
+    {
+        Chunk *chunk = new Chunk();
+        const int end = jmin(events.size(), i + MIDI_LAYER_SNAPSHOT_CHUNK_SIZE);
+        chunk->events.ensureStorageAllocated(end - i);
+
+        for (int j = i; j < end; ++j)
+        {
+            chunk->events.add(events.getUnchecked(j)->copy());
+        }
+
+        this->chunks.add(chunk);
+    }
+
+    this->updateChunkStarts();
+}
+
+void MidiLayerSnapshot::insert(const MidiEvent &event)
+{
+    SnapshotEventsComparator comparator;
+
+    if (this->chunks.size() == 0)
+    {
+        this->chunks.add(new Chunk());
+    }
+
+    const int chunkIndex = this->findChunkFor(event);
+    Chunk *chunk = this->getWritableChunk(chunkIndex);
+    chunk->events.addSorted(comparator, event.copy());
+
+    // Keeping the chunks small, so that copying one stays cheap
+    if (chunk->events.size() > MIDI_LAYER_SNAPSHOT_CHUNK_SIZE * 2)
+    {
+        Chunk *secondHalf = new Chunk();
+        const int numEventsInChunk = chunk->events.size();
+        const int middle = numEventsInChunk / 2;
+
+        for (int i = middle; i < numEventsInChunk; ++i)
+        {
+            secondHalf->events.add(chunk->events.getUnchecked(i));
+        }
+
+        chunk->events.removeLast(numEventsInChunk - middle, false);
+        this->chunks.insert(chunkIndex + 1, secondHalf);
+    }
+
+    this->updateChunkStarts();
+}
+
+void MidiLayerSnapshot::remove(const MidiEvent &event)
+{
+    SnapshotEventsComparator comparator;
+
+    if (this->chunks.size() == 0)
+    {
+        return;
+    }
+
+    const int chunkIndex = this->findChunkFor(event);
+    const int eventIndex = this->chunks.getObjectPointerUnchecked(chunkIndex)->events.indexOfSorted(comparator, &event);
+    jassert(eventIndex >= 0);
+
+    if (eventIndex < 0)
+    {
+        return;
+    }
+
+    Chunk *chunk = this->getWritableChunk(chunkIndex);
+    chunk->events.remove(eventIndex, true);
+
+    if (chunk->events.size() == 0)
+    {
+        this->chunks.remove(chunkIndex);
+    }
+
+    this->updateChunkStarts();
+}
+
+int MidiLayerSnapshot::findChunkFor(const MidiEvent &event) const
+{
+    // The last chunk which starts at or before the event
+    int low = 0;
+    int high = this->chunks.size();
+
+    while (high - low > 1)
+    {
+        const int middle = (low + high) / 2;
+        const MidiEvent *first = this->chunks.getObjectPointerUnchecked(middle)->events.getFirst();
+
+        if (MidiEvent::compareElements(first, &event) <= 0)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+MidiLayerSnapshot::Chunk *MidiLayerSnapshot::getWritableChunk(int chunkIndex)
+{
+    Chunk *chunk = this->chunks.getObjectPointerUnchecked(chunkIndex);
+
+    // Still used by some older snapshot
+    if (chunk->getReferenceCount() > 1)
+    {
+        chunk = new Chunk(*chunk);
+        this->chunks.set(chunkIndex, chunk);
+    }
+
+    return chunk;
+}
+
+void MidiLayerSnapshot::updateChunkStarts()
+{
+    this->chunkStarts.clearQuick();
+    this->numEvents = 0;
+
+    for (auto chunk : this->chunks)
+    {
+        this->chunkStarts.add(this->numEvents);
+        this->numEvents += chunk->events.size();
+    }
+}
@@ -0,0 +1,95 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MidiEvent.h"
+
+// An immutable copy of a layer's events, safe to read from any thread
+// while the layer keeps changing on the message thread.
+// The copies are kept in ref-counted chunks, shared between the consecutive snapshots:
+// the layer edits its own working snapshot, and only copies the list of chunks
+// and the chunks it touches, if they are still used by the published snapshot,
+// so that publishing a new snapshot, and taking it, is just a pointer copy.
+
+#define MIDI_LAYER_SNAPSHOT_CHUNK_SIZE 64
+
+class MidiLayerSnapshot : public ReferenceCountedObject
+{
+public:
+
+    typedef ReferenceCountedObjectPtr<MidiLayerSnapshot> Ptr;
+
+    MidiLayerSnapshot();
+
+    // Shares all the chunks with the other snapshot
+    MidiLayerSnapshot(const MidiLayerSnapshot &other);
+
+    int size() const noexcept
+    { return this->numEvents; }
+
+    // Binary search by the chunk, then the direct access
+    const MidiEvent *getUnchecked(int index) const noexcept;
+
+    // The layer's revision at the moment the snapshot was published
+    int getRevision() const noexcept
+    { return this->revision; }
+
+    // Same as the layer's full export, regardless of whether the layer is muted;
+    // uses the layer's channel and controller as they were when the snapshot was published
+    MidiMessageSequence exportMidi() const;
+
+private:
+
+    class Chunk : public ReferenceCountedObject
+    {
+    public:
+
+        Chunk() {}
+
+        // Copies all the events, so that the copy can be changed
+        Chunk(const Chunk &other);
+
+        OwnedArray<MidiEvent> events;
+
+        typedef ReferenceCountedObjectPtr<Chunk> Ptr;
+
+        JUCE_LEAK_DETECTOR(Chunk)
+    };
+
+    // The snapshots are only built and changed by their layer
+    friend class MidiLayer;
+
+    void rebuild(const OwnedArray<MidiEvent> &events);
+
+    // The events are matched by position and id, so the removed one
+    // doesn't need to be the same object as the inserted one
+    void insert(const MidiEvent &event);
+    void remove(const MidiEvent &event);
+
+    int findChunkFor(const MidiEvent &event) const;
+    Chunk *getWritableChunk(int chunkIndex);
+    void updateChunkStarts();
+
+    ReferenceCountedArray<Chunk> chunks;
+    Array<int> chunkStarts;
+    int numEvents;
+    int revision;
+    MidiEvent::LayerParameters layerParameters;
+
+    JUCE_LEAK_DETECTOR(MidiLayerSnapshot)
+};
@@ -0,0 +1,75 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NoteColumns.h"
+#include "Note.h"
+
+NoteColumns::NoteColumns() {}
+
+void NoteColumns::rebuild(const OwnedArray<MidiEvent> &events)
+{
+    const int numEvents = events.size();
+
+    // clearQuick keeps the allocated space, so rebuilds don't reallocate
+    this->ticks.clearQuick();
+    this->lengths.clearQuick();
+    this->velocities.clearQuick();
+    this->keys.clearQuick();
+    this->ids.clearQuick();
+    this->handles.clearQuick();
+
+    this->ticks.ensureStorageAllocated(numEvents);
+    this->lengths.ensureStorageAllocated(numEvents);
+    this->velocities.ensureStorageAllocated(numEvents);
+    this->keys.ensureStorageAllocated(numEvents);
+    this->ids.ensureStorageAllocated(numEvents);
+    this->handles.ensureStorageAllocated(numEvents);
+
+    for (int i = 0; i < numEvents; ++i)
+    {
+        Note *note = static_cast<Note *>(events.getUnchecked(i));
+        this->ticks.add(note->getTick());
+        this->lengths.add(note->getLengthInTicks());
+        this->velocities.add(note->getVelocity());
+        this->keys.add(static_cast<uint8>(note->getKey()));
+        this->ids.add(note->getID());
+        this->handles.add(note);
+    }
+}
+
+void NoteColumns::clear()
+{
+    this->ticks.clear();
+    this->lengths.clear();
+    this->velocities.clear();
+    this->keys.clear();
+    this->ids.clear();
+    this->handles.clear();
+}
+
+int NoteColumns::indexOfFirstNoteAtOrAfter(MidiEvent::Tick tick) const noexcept
+{
+    const MidiEvent::Tick *data = this->ticks.begin();
+    return int(std::lower_bound(data, data + this->ticks.size(), tick) - data);
+}
+
+size_t NoteColumns::getMemoryFootprint() const noexcept
+{
+    const size_t bytesPerNote = sizeof(MidiEvent::Tick) * 2 + sizeof(float) + sizeof(uint8) + sizeof(MidiEvent::Id) + sizeof(Note *);
+    return size_t(this->handles.size()) * bytesPerNote;
+}
@@ -0,0 +1,79 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MidiEvent.h"
+
+class Note;
+
+// A contiguous, structure-of-arrays copy of a piano layer's notes, in the layer's order
+// (sorted by beat). Layer-wide operations, like exporting a sequence or finding notes
+// in a range, scan these arrays instead of chasing the pointers to Note objects;
+// the Note objects remain the stable handles for the UI and undo actions.
+// Rebuilt lazily by the layer, after any change.
+
+class NoteColumns
+{
+public:
+
+    NoteColumns();
+
+    void rebuild(const OwnedArray<MidiEvent> &events);
+
+    void clear();
+
+    inline int size() const noexcept
+    { return this->handles.size(); }
+
+    inline MidiEvent::Tick getTick(int index) const noexcept
+    { return this->ticks.getUnchecked(index); }
+
+    inline MidiEvent::Tick getLengthInTicks(int index) const noexcept
+    { return this->lengths.getUnchecked(index); }
+
+    inline int getKey(int index) const noexcept
+    { return this->keys.getUnchecked(index); }
+
+    inline float getVelocity(int index) const noexcept
+    { return this->velocities.getUnchecked(index); }
+
+    inline MidiEvent::Id getId(int index) const noexcept
+    { return this->ids.getUnchecked(index); }
+
+    inline Note *getHandle(int index) const noexcept
+    { return this->handles.getUnchecked(index); }
+
+    // Binary search: the index of the first note starting at or after the tick
+    int indexOfFirstNoteAtOrAfter(MidiEvent::Tick tick) const noexcept;
+
+    // An estimate of the bytes taken by the arrays: the size of each element times
+    // the number of notes, i.e. 37 bytes per note on 64-bit builds; the unused
+    // capacity and the arrays' own headers are not counted
+    size_t getMemoryFootprint() const noexcept;
+
+private:
+
+    Array<MidiEvent::Tick> ticks;
+    Array<MidiEvent::Tick> lengths;
+    Array<float> velocities;
+    Array<uint8> keys;
+    Array<MidiEvent::Id> ids;
+    Array<Note *> handles;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoteColumns)
+};
@@ -0,0 +1,123 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "NoteKeyIndex.h"
+#include "Note.h"
+
+NoteKeyIndex::NoteKeyIndex()
+{
+    this->clear();
+}
+
+void NoteKeyIndex::rebuild(const OwnedArray<MidiEvent> &events)
+{
+    this->clear();
+
+    // Events are sorted already, so just appending them keeps every key sorted too
+    for (auto event : events)
+    {
+        Note *note = static_cast<Note *>(event);
+        KeyNotes &key = this->keys[NoteKeyIndex::getKeyIndex(note->getKey())];
+        key.notes.add(note);
+        key.maxLength = jmax(key.maxLength, note->getLengthInTicks());
+    }
+}
+
+void NoteKeyIndex::clear()
+{
+    for (auto &key : this->keys)
+    {
+        key.notes.clearQuick();
+        key.maxLength = 0;
+    }
+}
+
+void NoteKeyIndex::addNote(Note *note)
+{
+    KeyNotes &key = this->keys[NoteKeyIndex::getKeyIndex(note->getKey())];
+    key.notes.addSorted(*note, note);
+    key.maxLength = jmax(key.maxLength, note->getLengthInTicks());
+}
+
+void NoteKeyIndex::removeNote(Note *note)
+{
+    KeyNotes &key = this->keys[NoteKeyIndex::getKeyIndex(note->getKey())];
+    const int index = key.notes.indexOfSorted(*note, note);
+    jassert(index >= 0);
+
+    if (index >= 0)
+    {
+        key.notes.remove(index);
+    }
+}
+
+void NoteKeyIndex::findNotes(int keyNumber, MidiEvent::Tick startTick, MidiEvent::Tick endTick, Array<Note *> &result) const
+{
+    const KeyNotes &key = this->keys[NoteKeyIndex::getKeyIndex(keyNumber)];
+    const int numNotes = key.notes.size();
+
+    for (int i = NoteKeyIndex::indexOfFirstNoteAtOrAfter(key.notes, startTick - key.maxLength + 1); i < numNotes; ++i)
+    {
+        Note *note = key.notes.getUnchecked(i);
+
+        if (note->getTick() >= endTick)
+        {
+            break;
+        }
+
+        if (note->getTick() + note->getLengthInTicks() > startTick)
+        {
+            result.add(note);
+        }
+    }
+}
+
+void NoteKeyIndex::findNotesAt(MidiEvent::Tick tick, Array<Note *> &result) const
+{
+    for (int i = 0; i < NOTE_KEY_INDEX_NUM_KEYS; ++i)
+    {
+        this->findNotes(i, tick, tick + 1, result);
+    }
+}
+
+int NoteKeyIndex::getKeyIndex(int key) noexcept
+{
+    return jlimit(0, NOTE_KEY_INDEX_NUM_KEYS - 1, key);
+}
+
+int NoteKeyIndex::indexOfFirstNoteAtOrAfter(const Array<Note *> &notes, MidiEvent::Tick tick) noexcept
+{
+    int start = 0;
+    int end = notes.size();
+
+    while (start < end)
+    {
+        const int middle = (start + end) / 2;
+
+        if (notes.getUnchecked(middle)->getTick() < tick)
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    return start;
+}
@@ -0,0 +1,68 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "MidiEvent.h"
+
+class Note;
+
+// Note clamps its keys to 0..128, not 0..127, see Note::withDeltaKey
+#define NOTE_KEY_INDEX_NUM_KEYS 129
+
+// Notes of a piano layer, split by key, and sorted by start within each key.
+// Every key also remembers its longest note, so that the notes overlapping a range
+// are found with a binary search, starting no earlier than that length before the range.
+// The longest length is only reset on rebuild, so after removals it may be too large,
+// which only makes the queries scan a bit more.
+
+class NoteKeyIndex
+{
+public:
+
+    NoteKeyIndex();
+
+    void rebuild(const OwnedArray<MidiEvent> &events);
+
+    void clear();
+
+    // The note's position must not change between adding and removing it
+    void addNote(Note *note);
+    void removeNote(Note *note);
+
+    // Notes on the key which overlap [startTick, endTick)
+    void findNotes(int key, MidiEvent::Tick startTick, MidiEvent::Tick endTick, Array<Note *> &result) const;
+
+    // Notes on all keys which sound at the tick
+    void findNotesAt(MidiEvent::Tick tick, Array<Note *> &result) const;
+
+private:
+
+    struct KeyNotes
+    {
+        Array<Note *> notes;
+        MidiEvent::Tick maxLength;
+    };
+
+    static int getKeyIndex(int key) noexcept;
+
+    static int indexOfFirstNoteAtOrAfter(const Array<Note *> &notes, MidiEvent::Tick tick) noexcept;
+
+    KeyNotes keys[NOTE_KEY_INDEX_NUM_KEYS];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoteKeyIndex)
+};
@@ -24,13 +24,22 @@
 #include "SerializationKeys.h"
 #include "ProjectTreeItem.h"
 #include "UndoStack.h"
+#include "Transport.h"
 
 #include <float.h>
 
 // todo optimize data structures >_<
 // using std::dense_hash_map ?
 
-PianoLayer::PianoLayer(MidiLayerOwner &parent) : MidiLayer(parent)
+// Patching the cached sequence note by note only pays off for relatively small changes:
+// each removal and insertion shifts the sequence array, so that's O(n) per note,
+// and larger changes are faster to rebuild in one go
+#define PIANO_LAYER_MAX_PATCHED_NOTES_RATIO 8
+#define PIANO_LAYER_MAX_PATCHED_NOTES 64
+
+PianoLayer::PianoLayer(MidiLayerOwner &parent) :
+    MidiLayer(parent),
+    columnsRevision(-1)
 {
 }
 
@@ -79,6 +88,168 @@ void PianoLayer::importMidi(const MidiMessageSequence &sequence)
     this->notifyLayerChanged();
 }
 
+void PianoLayer::fillSequence(MidiMessageSequence &sequence) const
+{
+    const NoteColumns &notes = this->getColumns();
+    const int layerChannel = this->getChannel();
+
+    this->sequenceNotes.clear();
+    this->changedNotes.clear();
+
+    // Notes are added in the order of their start, so the note-offs always come
+    // before the note-ons at the same time, and the pairs can be linked right away
+    for (int i = 0; i < notes.size(); ++i)
+    {
+        const MidiEvent::Tick tick = notes.getTick(i);
+        const int key = notes.getKey(i);
+
+        MidiMessage eventNoteOn(MidiMessage::noteOn(layerChannel, key, notes.getVelocity(i)));
+        eventNoteOn.setTimeStamp(MidiEvent::tickToBeat(tick) * Transport::millisecondsPerBeat);
+        SequenceEvent *noteOn = sequence.addEvent(eventNoteOn);
+
+        MidiMessage eventNoteOff(MidiMessage::noteOff(layerChannel, key));
+        eventNoteOff.setTimeStamp(MidiEvent::tickToBeat(tick + notes.getLengthInTicks(i)) * Transport::millisecondsPerBeat);
+        noteOn->noteOffObject = sequence.addEvent(eventNoteOff);
+
+        this->sequenceNotes.set(notes.getId(i), noteOn);
+    }
+}
+
+// The sequence is sorted by time, so the events are found with a binary search
+static int indexOfSequenceEvent(const MidiMessageSequence &sequence,
+                                const MidiMessageSequence::MidiEventHolder *event)
+{
+    const double timeStamp = event->message.getTimeStamp();
+    int start = 0;
+    int end = sequence.getNumEvents();
+
+    while (start < end)
+    {
+        const int middle = (start + end) / 2;
+
+        if (sequence.getEventPointer(middle)->message.getTimeStamp() < timeStamp)
+        {
+            start = middle + 1;
+        }
+        else
+        {
+            end = middle;
+        }
+    }
+
+    for (int i = start; i < sequence.getNumEvents(); ++i)
+    {
+        const MidiMessageSequence::MidiEventHolder *other = sequence.getEventPointer(i);
+
+        if (other == event)
+        {
+            return i;
+        }
+
+        if (other->message.getTimeStamp() != timeStamp)
+        {
+            break;
+        }
+    }
+
+    return -1;
+}
+
+bool PianoLayer::patchSequence(MidiMessageSequence &sequence) const
+{
+    if (this->changedNotes.size() == 0)
+    {
+        return true;
+    }
+
+    if (this->changedNotes.size() > PIANO_LAYER_MAX_PATCHED_NOTES ||
+        this->changedNotes.size() > (this->size() / PIANO_LAYER_MAX_PATCHED_NOTES_RATIO))
+    {
+        return false;
+    }
+
+    for (HashMap<MidiEvent::Id, const Note *>::Iterator i(this->changedNotes); i.next();)
+    {
+        if (SequenceEvent *noteOn = this->sequenceNotes[i.getKey()])
+        {
+            const int noteOnIndex = indexOfSequenceEvent(sequence, noteOn);
+            const int noteOffIndex = indexOfSequenceEvent(sequence, noteOn->noteOffObject);
+
+            if (noteOnIndex < 0 || noteOffIndex < 0)
+            {
+                jassertfalse;
+                return false;
+            }
+
+            // The note-off comes later, so removing it first keeps the note-on index valid
+            sequence.deleteEvent(noteOffIndex, false);
+            sequence.deleteEvent(noteOnIndex, false);
+            this->sequenceNotes.remove(i.getKey());
+        }
+    }
+
+    for (HashMap<MidiEvent::Id, const Note *>::Iterator i(this->changedNotes); i.next();)
+    {
+        if (const Note *note = i.getValue())
+        {
+            if (SequenceEvent *noteOn = this->addNoteToSequence(sequence, *note))
+            {
+                this->sequenceNotes.set(i.getKey(), noteOn);
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+
+    this->changedNotes.clear();
+    return true;
+}
+
+PianoLayer::SequenceEvent *PianoLayer::addNoteToSequence(MidiMessageSequence &sequence, const Note &note) const
+{
+    // MidiMessageSequence puts a new event after all the events at the same time;
+    // that's just fine for a note-on, but a note-off put after the note-on
+    // of the next note on the same key would cut that note,
+    // so that rare case is left for the full rebuild
+    MidiMessage eventNoteOn(MidiMessage::noteOn(this->getChannel(), note.getKey(), note.getVelocity()));
+    eventNoteOn.setTimeStamp(MidiEvent::tickToBeat(note.getTick()) * Transport::millisecondsPerBeat);
+
+    MidiMessage eventNoteOff(MidiMessage::noteOff(this->getChannel(), note.getKey()));
+    eventNoteOff.setTimeStamp(MidiEvent::tickToBeat(note.getTick() + note.getLengthInTicks()) * Transport::millisecondsPerBeat);
+
+    SequenceEvent *noteOn = sequence.addEvent(eventNoteOn);
+    SequenceEvent *noteOff = sequence.addEvent(eventNoteOff);
+    noteOn->noteOffObject = noteOff;
+
+    const double noteOffTime = eventNoteOff.getTimeStamp();
+
+    for (int i = indexOfSequenceEvent(sequence, noteOff) - 1; i >= 0; --i)
+    {
+        const MidiMessage &message = sequence.getEventPointer(i)->message;
+
+        if (message.getTimeStamp() != noteOffTime)
+        {
+            break;
+        }
+
+        if (message.isNoteOn() && message.getNoteNumber() == note.getKey())
+        {
+            return nullptr;
+        }
+    }
+
+    return noteOn;
+}
+
+void PianoLayer::invalidateSequenceCacheFor(const MidiEvent &event, bool isRemoved)
+{
+    // The events reported here are the ones stored in the layer
+    this->changedNotes.set(event.getID(), isRemoved ? nullptr : static_cast<const Note *>(&event));
+    this->incrementRevision();
+}
+
 
 //===----------------------------------------------------------------------===//
 // Undoable track editing
@@ -88,7 +259,7 @@ void PianoLayer::silentImport(const MidiEvent &eventToImport)
 {
     const Note &note = static_cast<const Note &>(eventToImport);
 
-    if (this->notesHashTable.contains(note))
+    if (this->notesHashTable.contains(note.getID()))
     { return; }
 
     auto const storedNote = new Note(this);
@@ -96,14 +267,16 @@ void PianoLayer::silentImport(const MidiEvent &eventToImport)
     
     // we need it to be sorted just because of sequence building performance?
     this->midiEvents.addSorted(*storedNote, storedNote); // bottleneck warning
-    this->notesHashTable.set(note, storedNote);
+    this->notesHashTable.set(note.getID(), storedNote);
+    this->keyIndex.addNote(storedNote);
+    this->invalidateSequenceCache();
 
     this->updateBeatRange(false);
 }
 
 MidiEvent *PianoLayer::insert(const Note &note, const bool undoable)
 {
-    if (this->notesHashTable.contains(note))
+    if (this->notesHashTable.contains(note.getID()))
     {
         return nullptr;
     }
@@ -119,7 +292,8 @@ MidiEvent *PianoLayer::insert(const Note &note, const bool undoable)
         auto storedNote = new Note(this, note);
         
         this->midiEvents.addSorted(*storedNote, storedNote);
-        this->notesHashTable.set(note, storedNote);
+        this->notesHashTable.set(note.getID(), storedNote);
+        this->keyIndex.addNote(storedNote);
 
         this->notifyEventAdded(*storedNote);
         this->updateBeatRange(true);
@@ -141,15 +315,16 @@ bool PianoLayer::remove(const Note &note, const bool undoable)
     else
     {
         // fixme! use dense_hash_map of <int noteHash, Note *objectPointer>
-        if (Note *matchingNote = this->notesHashTable[note])
+        if (Note *matchingNote = this->notesHashTable[note.getID()])
         {
             this->notifyEventRemoved(*matchingNote);
+            this->keyIndex.removeNote(matchingNote);
             
             const int matchingNoteIndex = this->indexOfSorted(matchingNote);
             this->midiEvents.remove(matchingNoteIndex, true);
             //this->midiEvents.removeObject(matchingNote);
             
-            this->notesHashTable.remove(note);
+            this->notesHashTable.remove(note.getID());
             this->updateBeatRange(true);
             this->notifyEventRemovedPostAction();
             return true;
@@ -176,16 +351,15 @@ bool PianoLayer::change(const Note &note,
     }
     else
     {
-        if (Note *matchingNote = this->notesHashTable[note])
+        if (Note *matchingNote = this->notesHashTable[note.getID()])
         {
-            // fixme - remove and addSorted instead?
+            this->midiEvents.remove(this->indexOfSorted(matchingNote), false);
+            this->keyIndex.removeNote(matchingNote);
             (*matchingNote) = newNote;
+            this->midiEvents.addSorted(*matchingNote, matchingNote);
+            this->keyIndex.addNote(matchingNote);
 
-            this->notesHashTable.set(newNote, matchingNote);
-
-            // fixme - remove and addSorted instead?
-            this->sort();
-
+            this->notesHashTable.set(newNote.getID(), matchingNote);
             this->notifyEventChanged(note, *matchingNote);
             this->updateBeatRange(true);
             return true;
@@ -210,17 +384,29 @@ bool PianoLayer::insertGroup(Array<Note> &notes, bool undoable)
     }
     else
     {
+        Array<MidiEvent *> storedNotes;
+        storedNotes.ensureStorageAllocated(notes.size());
+
         for (int i = 0; i < notes.size(); ++i)
         {
             const Note &note = notes.getUnchecked(i);
             auto storedNote = new Note(this, note);
             
-            this->midiEvents.add(storedNote); // sorted later
-            this->notesHashTable.set(note, storedNote);
-            this->notifyEventAdded(*storedNote);
+            storedNotes.add(storedNote);
+            this->notesHashTable.set(note.getID(), storedNote);
+            this->keyIndex.addNote(storedNote);
         }
 
-        this->sort();
+        this->mergeSorted(storedNotes);
+
+        LayerChangeSet changes(this);
+
+        for (auto storedNote : storedNotes)
+        {
+            changes.eventAdded(*storedNote);
+        }
+
+        this->notifyChangesBatch(changes);
         this->updateBeatRange(true);
     }
 
@@ -237,24 +423,36 @@ bool PianoLayer::removeGroup(Array<Note> &notes, bool undoable)
     }
     else
     {
+        Array<MidiEvent *> removedNotes;
+        removedNotes.ensureStorageAllocated(notes.size());
+
         for (int i = 0; i < notes.size(); ++i)
         {
-            const Note &note = notes.getUnchecked(i);
-
-            if (Note *matchingNote = this->notesHashTable[note])
+            if (Note *matchingNote = this->notesHashTable[notes.getUnchecked(i).getID()])
             {
-                this->notifyEventRemoved(*matchingNote);
-                
-                const int matchingNoteIndex = this->indexOfSorted(matchingNote);
-                this->midiEvents.remove(matchingNoteIndex, true);
-                //this->midiEvents.removeObject(matchingNote);
-                
-                this->notesHashTable.remove(note);
+                removedNotes.add(matchingNote);
             }
         }
 
+        this->detachSorted(removedNotes);
+
+        // The listeners still need the notes to be alive, so they are deleted afterwards
+        OwnedArray<MidiEvent> notesToDelete;
+        notesToDelete.ensureStorageAllocated(removedNotes.size());
+        LayerChangeSet changes(this);
+
+        for (auto removedNote : removedNotes)
+        {
+            Note *note = static_cast<Note *>(removedNote);
+            this->keyIndex.removeNote(note);
+            this->notesHashTable.remove(note->getID());
+            notesToDelete.add(note);
+            changes.eventRemoved(*note);
+        }
+
+        this->notifyChangesBatch(changes);
+        notesToDelete.clear();
         this->updateBeatRange(true);
-        this->notifyEventRemovedPostAction();
     }
 
     return true;
@@ -268,28 +466,77 @@ bool PianoLayer::changeGroup(Array<Note> &notesBefore,
 
     if (undoable)
     {
-        this->getUndoStack()->perform(new NotesGroupChangeAction(*this->getProject(),
-                                                                 this->getLayerIdAsString(),
-                                                                 notesBefore,
-                                                                 notesAfter));
+        // Uniform edits, like shifting or transposing, only need the ids and the deltas
+        UndoAction *action =
+            NotesGroupTransformAction::createIfCompact(*this->getProject(),
+                                                       this->getLayerIdAsString(),
+                                                       notesBefore,
+                                                       notesAfter);
+
+        if (action == nullptr)
+        {
+            action = new NotesGroupChangeAction(*this->getProject(),
+                                                this->getLayerIdAsString(),
+                                                notesBefore,
+                                                notesAfter);
+        }
+
+        this->getUndoStack()->perform(action);
     }
     else
     {
+        Array<Note *> matchingNotes;
+        Array<MidiEvent *> movedNotes;
+        matchingNotes.ensureStorageAllocated(notesBefore.size());
+        movedNotes.ensureStorageAllocated(notesBefore.size());
+
         for (int i = 0; i < notesBefore.size(); ++i)
         {
-            const Note &note = notesBefore.getUnchecked(i);
-            const Note &newNote = notesAfter.getUnchecked(i);
+            Note *matchingNote = this->notesHashTable[notesBefore.getUnchecked(i).getID()];
+            matchingNotes.add(matchingNote);
+
+            if (matchingNote != nullptr)
+            {
+                movedNotes.add(matchingNote);
+            }
+        }
+
+        this->detachSorted(movedNotes);
+
+        for (auto movedNote : movedNotes)
+        {
+            this->keyIndex.removeNote(static_cast<Note *>(movedNote));
+        }
 
-            if (Note *matchingNote = this->notesHashTable[note])
+        for (int i = 0; i < notesBefore.size(); ++i)
+        {
+            if (Note *matchingNote = matchingNotes.getUnchecked(i))
             {
+                const Note &newNote = notesAfter.getUnchecked(i);
                 (*matchingNote) = newNote;
+                this->notesHashTable.set(newNote.getID(), matchingNote);
+            }
+        }
+
+        for (auto movedNote : movedNotes)
+        {
+            this->keyIndex.addNote(static_cast<Note *>(movedNote));
+        }
 
-                this->notesHashTable.set(newNote, matchingNote);
-                this->notifyEventChanged(note, *matchingNote);
+        this->mergeSorted(movedNotes);
+
+        LayerChangeSet changes(this);
+
+        for (int i = 0; i < notesBefore.size(); ++i)
+        {
+            if (Note *matchingNote = matchingNotes.getUnchecked(i))
+            {
+                changes.eventChanged(notesBefore.getUnchecked(i), *matchingNote);
             }
         }
 
-        this->sort();
+        this->notifyChangesBatch(changes);
+
         this->updateBeatRange(true);
     }
 
@@ -308,17 +555,16 @@ void PianoLayer::transposeAll(int keyDelta, bool shouldCheckpoint)
     }
 
     Array<Note> groupBefore, groupAfter;
+    const NoteColumns &notes = this->getColumns();
 
-    for (int i = 0; i < this->midiEvents.size(); ++i)
-    {
-        if (Note *n = dynamic_cast<Note *>(this->midiEvents.getUnchecked(i)))
-        {
-            Note n1 = *n;
-            Note n2 = n1.withDeltaKey(keyDelta);
+    groupBefore.ensureStorageAllocated(notes.size());
+    groupAfter.ensureStorageAllocated(notes.size());
 
-            groupBefore.add(n1);
-            groupAfter.add(n2);
-        }
+    for (int i = 0; i < notes.size(); ++i)
+    {
+        const Note &n = *notes.getHandle(i);
+        groupBefore.add(n);
+        groupAfter.add(n.withDeltaKey(keyDelta));
     }
 
     if (shouldCheckpoint)
@@ -350,6 +596,32 @@ float PianoLayer::getLastBeat() const
     return note.getBeat() + note.getLength();
 }
 
+void PianoLayer::findNotes(int key, float startBeat, float endBeat, Array<Note *> &result) const
+{
+    this->keyIndex.findNotes(key, MidiEvent::beatToTick(startBeat), MidiEvent::beatToTick(endBeat), result);
+}
+
+void PianoLayer::findNotesAt(float beat, Array<Note *> &result) const
+{
+    this->keyIndex.findNotesAt(MidiEvent::beatToTick(beat), result);
+}
+
+Note *PianoLayer::findNoteById(MidiEvent::Id id) const
+{
+    return this->notesHashTable[id];
+}
+
+const NoteColumns &PianoLayer::getColumns() const
+{
+    if (this->columnsRevision != this->getRevision())
+    {
+        this->columns.rebuild(this->midiEvents);
+        this->columnsRevision = this->getRevision();
+    }
+
+    return this->columns;
+}
+
 
 //===----------------------------------------------------------------------===//
 // Serializable
@@ -380,6 +652,9 @@ void PianoLayer::deserialize(const XmlElement &xml)
     //this->reset(); // this will send change notifications
     this->midiEvents.clear();
     this->notesHashTable.clear();
+    this->keyIndex.clear();
+    this->columns.clear();
+    this->invalidateSequenceCache();
 
     const XmlElement *mainSlot = (xml.getTagName() == Serialization::Core::track) ?
                                  &xml : xml.getChildByName(Serialization::Core::track);
@@ -409,10 +684,11 @@ void PianoLayer::deserialize(const XmlElement &xml)
         lastBeat = jmax(lastBeat, noteEnd);
         firstBeat = jmin(firstBeat, note->getBeat());
 
-        this->notesHashTable.set(*note, note);
+        this->notesHashTable.set(note->getID(), note);
     }
 
     this->sort();
+    this->keyIndex.rebuild(this->midiEvents);
     this->updateBeatRange(false);
     this->notifyLayerChanged();
 }
@@ -421,5 +697,8 @@ void PianoLayer::reset()
 {
     this->midiEvents.clear();
     this->notesHashTable.clear();
+    this->keyIndex.clear();
+    this->columns.clear();
+    this->invalidateSequenceCache();
     this->notifyLayerChanged();
 }
@@ -19,6 +19,8 @@
 
 #include "MidiLayer.h"
 #include "Note.h"
+#include "NoteColumns.h"
+#include "NoteKeyIndex.h"
 
 class PianoRoll;
 
@@ -70,6 +72,18 @@ public:
     //===------------------------------------------------------------------===//
     
     float getLastBeat() const override; // overriding to set beat+length
+
+    // The notes laid out in arrays, for linear scans over the whole layer
+    const NoteColumns &getColumns() const;
+
+    // Notes on the key which overlap [startBeat, endBeat)
+    void findNotes(int key, float startBeat, float endBeat, Array<Note *> &result) const;
+
+    // Notes on all keys which sound at the beat
+    void findNotesAt(float beat, Array<Note *> &result) const;
+
+    // Null if there's no such note in the layer
+    Note *findNoteById(MidiEvent::Id id) const;
     
     
     //===------------------------------------------------------------------===//
@@ -82,11 +96,33 @@ public:
 
     void reset() override;
 
+protected:
+
+    void fillSequence(MidiMessageSequence &sequence) const override;
+
+    bool patchSequence(MidiMessageSequence &sequence) const override;
+
+    void invalidateSequenceCacheFor(const MidiEvent &event, bool isRemoved) override;
+
 private:
 
+    using SequenceEvent = MidiMessageSequence::MidiEventHolder;
+
+    SequenceEvent *addNoteToSequence(MidiMessageSequence &sequence, const Note &note) const;
+
     // быстрый доступ к указателю на событие по соответствующим ему параметрам
     // todo вот прям быстрый? замени на dense_hash_map или flat_hash_map
-    HashMap<Note, Note *, NoteHashFunction> notesHashTable;
+    HashMap<MidiEvent::Id, Note *> notesHashTable;
+
+    NoteKeyIndex keyIndex;
+
+    mutable NoteColumns columns;
+    mutable int columnsRevision;
+
+    // The note-on of each note in the cached sequence (its note-off is linked to it),
+    // and the notes changed since the cache was updated, null for the removed ones
+    mutable HashMap<MidiEvent::Id, SequenceEvent *> sequenceNotes;
+    mutable HashMap<MidiEvent::Id, const Note *> changedNotes;
 
 private:
 
@@ -77,6 +77,7 @@ void TimeSignaturesLayer::silentImport(const MidiEvent &eventToImport)
     
     this->midiEvents.addSorted(*storedSignature, storedSignature);
     this->signaturesHashTable.set(signature, storedSignature);
+    this->invalidateSequenceCache();
     
     this->updateBeatRange(false);
 }
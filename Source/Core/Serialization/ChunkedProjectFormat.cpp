@@ -0,0 +1,403 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Common.h"
+#include "ChunkedProjectFormat.h"
+#include "DataEncoder.h"
+#include "MidiLayer.h"
+#include "SerializationKeys.h"
+
+// Magic, version and the number of chunks
+#define CHUNKED_PROJECT_HEADER_SIZE (4 + 4 + 4)
+
+// Type, offset, size and checksum
+#define CHUNKED_PROJECT_TABLE_ENTRY_SIZE (1 + 8 + 4 + 8)
+
+// Sanity limit for the damaged files
+#define CHUNKED_PROJECT_MAX_CHUNKS (1024 * 1024)
+
+// FNV-1a, same as for the journal and the undo history
+static int64 getChecksum(const void *data, size_t size) noexcept
+{
+    uint64 hash = 14695981039346656037ULL;
+    const uint8 *bytes = static_cast<const uint8 *>(data);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return int64(hash);
+}
+
+static MemoryBlock compressXml(const XmlElement &xml)
+{
+    MemoryOutputStream compressed;
+
+    {
+        GZIPCompressorOutputStream gzip(&compressed, 1, false);
+        xml.writeToStream(gzip, StringRef(), true, false);
+    }
+
+    return compressed.getMemoryBlock();
+}
+
+// Both are done one by one from the head of the children list,
+// which is a linked list, so that it takes linear time
+
+static void detachChildren(XmlElement &xml, Array<XmlElement *> &children)
+{
+    while (XmlElement *child = xml.getFirstChildElement())
+    {
+        xml.removeChildElement(child, false);
+        children.add(child);
+    }
+}
+
+static void attachChildren(XmlElement &xml, const Array<XmlElement *> &children)
+{
+    for (int i = children.size(); --i >= 0;)
+    {
+        xml.prependChildElement(children.getUnchecked(i));
+    }
+}
+
+static void moveChildren(XmlElement &source, XmlElement &target)
+{
+    Array<XmlElement *> children;
+    detachChildren(source, children);
+    attachChildren(target, children);
+}
+
+struct ChunkedElement
+{
+    XmlElement *xml;
+    ChunkedProjectFormat::ChunkType type;
+    Array<XmlElement *> children;
+};
+
+// Layers and histories, in the document order
+static void collectSplitElements(XmlElement &xml, OwnedArray<ChunkedElement> &result)
+{
+    forEachXmlChildElement(xml, child)
+    {
+        const bool isLayer = MidiLayer::isLayerXml(*child);
+
+        if (isLayer || child->hasTagName(Serialization::Core::versionControl))
+        {
+            auto element = result.add(new ChunkedElement());
+            element->xml = child;
+            element->type = isLayer ? ChunkedProjectFormat::layerChunk : ChunkedProjectFormat::historyChunk;
+        }
+        else
+        {
+            collectSplitElements(*child, result);
+        }
+    }
+}
+
+
+//===----------------------------------------------------------------------===//
+// ChunkedProjectFormat
+//===----------------------------------------------------------------------===//
+
+bool ChunkedProjectFormat::isChunkedProject(const File &file)
+{
+    FileInputStream in(file);
+    return in.openedOk() && in.readInt() == CHUNKED_PROJECT_MAGIC;
+}
+
+bool ChunkedProjectFormat::save(const File &file, XmlElement &projectXml)
+{
+    OwnedArray<ChunkedElement> splitElements;
+    collectSplitElements(projectXml, splitElements);
+
+    Array<ChunkType> types;
+    OwnedArray<MemoryBlock> payloads;
+
+    // The project goes first, without the layers' events and the histories
+    for (auto element : splitElements)
+    {
+        detachChildren(*element->xml, element->children);
+    }
+
+    types.add(projectChunk);
+    payloads.add(new MemoryBlock(compressXml(projectXml)));
+
+    // Each of them is put back in place right before being compressed
+    for (auto element : splitElements)
+    {
+        attachChildren(*element->xml, element->children);
+        types.add(element->type);
+        payloads.add(new MemoryBlock(compressXml(*element->xml)));
+    }
+
+    TemporaryFile tempFile(file);
+
+    {
+        FileOutputStream out(tempFile.getFile());
+
+        if (out.failedToOpen())
+        {
+            return false;
+        }
+
+        out.writeInt(CHUNKED_PROJECT_MAGIC);
+        out.writeInt(CHUNKED_PROJECT_VERSION);
+        out.writeInt(payloads.size());
+
+        MemoryOutputStream table;
+        int64 offset = CHUNKED_PROJECT_HEADER_SIZE +
+                       CHUNKED_PROJECT_TABLE_ENTRY_SIZE * payloads.size() + 8;
+
+        for (int i = 0; i < payloads.size(); ++i)
+        {
+            const MemoryBlock &payload = *payloads.getUnchecked(i);
+            table.writeByte(char(types.getUnchecked(i)));
+            table.writeInt64(offset);
+            table.writeInt(int(payload.getSize()));
+            table.writeInt64(getChecksum(payload.getData(), payload.getSize()));
+            offset += payload.getSize();
+        }
+
+        out.write(table.getData(), table.getDataSize());
+        out.writeInt64(getChecksum(table.getData(), table.getDataSize()));
+
+        for (auto payload : payloads)
+        {
+            out.write(payload->getData(), payload->getSize());
+        }
+
+        out.flush();
+
+        if (out.getStatus().failed())
+        {
+            Logger::writeToLog("ChunkedProjectFormat::save failed: " + out.getStatus().getErrorMessage());
+            return false;
+        }
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+XmlElement *ChunkedProjectFormat::load(const File &file)
+{
+    Reader reader(file);
+    ScopedPointer<XmlElement> projectXml(reader.readProject());
+
+    if (projectXml == nullptr)
+    {
+        return nullptr;
+    }
+
+    HashMap<String, XmlElement *> layersXml;
+    OwnedArray<ChunkedElement> splitElements;
+    collectSplitElements(*projectXml, splitElements);
+
+    for (auto element : splitElements)
+    {
+        if (element->type == layerChunk)
+        {
+            layersXml.set(element->xml->getStringAttribute("id"), element->xml);
+        }
+    }
+
+    for (int i = 0; i < reader.getNumChunks(); ++i)
+    {
+        if (reader.getChunkType(i) != layerChunk)
+        {
+            continue;
+        }
+
+        ScopedPointer<XmlElement> layerXml(reader.readChunk(i));
+
+        if (layerXml == nullptr)
+        {
+            return nullptr;
+        }
+
+        if (XmlElement *target = layersXml[layerXml->getStringAttribute("id")])
+        {
+            moveChildren(*layerXml, *target);
+        }
+    }
+
+    return projectXml.release();
+}
+
+bool ChunkedProjectFormat::convertFromLegacyFormat(const File &legacyFile, const File &chunkedFile)
+{
+    ScopedPointer<XmlElement> xml(DataEncoder::loadObfuscated(legacyFile));
+    return xml != nullptr && save(chunkedFile, *xml);
+}
+
+bool ChunkedProjectFormat::convertToLegacyFormat(const File &chunkedFile, const File &legacyFile)
+{
+    ScopedPointer<XmlElement> xml(load(chunkedFile));
+    return xml != nullptr && DataEncoder::saveObfuscated(legacyFile, xml);
+}
+
+
+//===----------------------------------------------------------------------===//
+// Reader
+//===----------------------------------------------------------------------===//
+
+ChunkedProjectFormat::Reader::Reader(const File &file) :
+    in(file),
+    tableIsValid(false)
+{
+    if (! this->in.openedOk() ||
+        this->in.readInt() != CHUNKED_PROJECT_MAGIC ||
+        this->in.readInt() > CHUNKED_PROJECT_VERSION)
+    {
+        return;
+    }
+
+    const int numChunks = this->in.readInt();
+    const int64 fileSize = this->in.getTotalLength();
+
+    if (numChunks <= 0 || numChunks > CHUNKED_PROJECT_MAX_CHUNKS)
+    {
+        return;
+    }
+
+    MemoryBlock table;
+    const size_t tableSize = size_t(CHUNKED_PROJECT_TABLE_ENTRY_SIZE * numChunks);
+
+    if (this->in.readIntoMemoryBlock(table, tableSize) != tableSize ||
+        this->in.readInt64() != getChecksum(table.getData(), table.getSize()))
+    {
+        Logger::writeToLog("ChunkedProjectFormat: damaged table of contents in " + file.getFileName());
+        return;
+    }
+
+    MemoryInputStream tableStream(table, false);
+    this->chunks.ensureStorageAllocated(numChunks);
+
+    for (int i = 0; i < numChunks; ++i)
+    {
+        Chunk chunk;
+        chunk.type = ChunkType(uint8(tableStream.readByte()));
+        chunk.offset = tableStream.readInt64();
+        chunk.size = tableStream.readInt();
+        chunk.checksum = tableStream.readInt64();
+
+        if (chunk.size < 0 || chunk.offset < 0 || chunk.offset + chunk.size > fileSize)
+        {
+            this->chunks.clear();
+            return;
+        }
+
+        this->chunks.add(chunk);
+    }
+
+    this->tableIsValid = (this->chunks.getFirst().type == projectChunk);
+}
+
+bool ChunkedProjectFormat::Reader::readPayload(const Chunk &chunk, MemoryBlock &payload)
+{
+    payload.reset();
+
+    return this->in.setPosition(chunk.offset) &&
+           this->in.readIntoMemoryBlock(payload, chunk.size) == size_t(chunk.size) &&
+           getChecksum(payload.getData(), payload.getSize()) == chunk.checksum;
+}
+
+bool ChunkedProjectFormat::Reader::verify()
+{
+    if (! this->tableIsValid)
+    {
+        return false;
+    }
+
+    MemoryBlock payload;
+
+    for (const auto &chunk : this->chunks)
+    {
+        if (! this->readPayload(chunk, payload))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+XmlElement *ChunkedProjectFormat::Reader::readChunk(int index)
+{
+    if (! this->tableIsValid || ! isPositiveAndBelow(index, this->chunks.size()))
+    {
+        return nullptr;
+    }
+
+    MemoryBlock payload;
+
+    if (! this->readPayload(this->chunks.getReference(index), payload))
+    {
+        Logger::writeToLog("ChunkedProjectFormat: chunk " + String(index) + " is damaged");
+        return nullptr;
+    }
+
+    MemoryInputStream compressedStream(payload, false);
+    GZIPDecompressorInputStream gzip(compressedStream);
+    return XmlDocument::parse(gzip.readEntireStreamAsString());
+}
+
+XmlElement *ChunkedProjectFormat::Reader::readProject()
+{
+    ScopedPointer<XmlElement> projectXml(this->readChunk(0));
+
+    if (projectXml == nullptr)
+    {
+        return nullptr;
+    }
+
+    OwnedArray<ChunkedElement> splitElements;
+    collectSplitElements(*projectXml, splitElements);
+
+    int nextElement = 0;
+
+    for (int i = 1; i < this->chunks.size(); ++i)
+    {
+        const ChunkType type = this->chunks.getReference(i).type;
+
+        // Chunks go in the same order as the elements they were split from
+        if (nextElement >= splitElements.size() ||
+            splitElements.getUnchecked(nextElement)->type != type)
+        {
+            return nullptr;
+        }
+
+        if (type == historyChunk)
+        {
+            ScopedPointer<XmlElement> historyXml(this->readChunk(i));
+
+            if (historyXml == nullptr)
+            {
+                return nullptr;
+            }
+
+            moveChildren(*historyXml, *splitElements.getUnchecked(nextElement)->xml);
+        }
+
+        ++nextElement;
+    }
+
+    return projectXml.release();
+}
@@ -0,0 +1,101 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+// A binary container for the project files, which allows to load a project
+// layer by layer, instead of inflating and parsing the whole document at once.
+//
+// The file starts with a table of contents, followed by the chunks: the project
+// itself, with the layers' events and the version control history left out,
+// then each layer and each history, in the document order. Each chunk is compressed
+// on its own and has a checksum. The older, obfuscated single document format
+// is still loaded, and can be converted to and from.
+
+#define CHUNKED_PROJECT_MAGIC 0x31435048 // "HPC1"
+#define CHUNKED_PROJECT_VERSION 1
+
+class ChunkedProjectFormat
+{
+public:
+
+    enum ChunkType
+    {
+        projectChunk = 1,
+        layerChunk = 2,
+        historyChunk = 3
+    };
+
+    static bool isChunkedProject(const File &file);
+
+    // The project xml is taken apart while saving, but is left as it was
+    static bool save(const File &file, XmlElement &projectXml);
+
+    // Puts the whole document together; the caller takes the ownership
+    static XmlElement *load(const File &file);
+
+    static bool convertFromLegacyFormat(const File &legacyFile, const File &chunkedFile);
+
+    static bool convertToLegacyFormat(const File &chunkedFile, const File &legacyFile);
+
+    // Keeps the file open and reads the chunks on demand
+    class Reader
+    {
+    public:
+
+        explicit Reader(const File &file);
+
+        bool openedOk() const noexcept
+        { return this->tableIsValid; }
+
+        int getNumChunks() const noexcept
+        { return this->chunks.size(); }
+
+        ChunkType getChunkType(int index) const noexcept
+        { return this->chunks[index].type; }
+
+        // Checks all the chunks without unpacking them
+        bool verify();
+
+        // The caller takes the ownership; returns nullptr if the chunk is damaged
+        XmlElement *readChunk(int index);
+
+        // The project chunk, with the histories put back in place,
+        // but with the layers left empty
+        XmlElement *readProject();
+
+    private:
+
+        struct Chunk
+        {
+            ChunkType type;
+            int64 offset;
+            int size;
+            int64 checksum;
+        };
+
+        bool readPayload(const Chunk &chunk, MemoryBlock &payload);
+
+        FileInputStream in;
+        Array<Chunk> chunks;
+        bool tableIsValid;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Reader)
+    };
+
+};
@@ -26,6 +26,9 @@ static const std::string kBase64Chars =
 static const int kMagicNumber = 
 	static_cast<int>(ByteOrder::littleEndianInt("PR::"));
 
+// The reads and writes are done in blocks of that size
+#define DATA_ENCODER_BUFFER_SIZE (256 * 1024)
+
 static const std::string kXorKey =
 	"2V:-5?Vl%ulG+4-PG0`#:;[DUnB.Qs::"
 	"v<{#]_oaa3NWyGtA[bq>Qf<i,28gV,,;"
@@ -117,50 +120,35 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TempFile)
 };
 
-static inline std::string encodeBase64(unsigned char const *bytes_to_encode, size_t in_len)
+static inline std::string encodeBase64(unsigned char const *bytes, size_t length)
 {
-    std::string ret;
-    int i = 0;
-    int j = 0;
-    unsigned char char_array_3[3];
-    unsigned char char_array_4[4];
-
-    while (in_len--)
-    {
-        char_array_3[i++] = *(bytes_to_encode++);
-
-        if (i == 3)
-        {
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
-
-            for (i = 0; (i < 4) ; i++)
-            { ret += kBase64Chars[char_array_4[i]]; }
+    std::string result;
+    result.resize(((length + 2) / 3) * 4);
 
-            i = 0;
-        }
-    }
+    char *out = &result[0];
+    size_t i = 0;
 
-    if (i)
+    for (; i + 2 < length; i += 3)
     {
-        for (j = i; j < 3; j++)
-        { char_array_3[j] = '\0'; }
-
-        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-        char_array_4[3] = char_array_3[2] & 0x3f;
+        const uint32 triple = (uint32(bytes[i]) << 16) | (uint32(bytes[i + 1]) << 8) | uint32(bytes[i + 2]);
+        *out++ = kBase64Chars[(triple >> 18) & 0x3f];
+        *out++ = kBase64Chars[(triple >> 12) & 0x3f];
+        *out++ = kBase64Chars[(triple >> 6) & 0x3f];
+        *out++ = kBase64Chars[triple & 0x3f];
+    }
 
-        for (j = 0; (j < i + 1); j++)
-        { ret += kBase64Chars[char_array_4[j]]; }
+    const size_t rest = length - i;
 
-        while ((i++ < 3))
-        { ret += '='; }
+    if (rest > 0)
+    {
+        const uint32 triple = (uint32(bytes[i]) << 16) | (rest > 1 ? (uint32(bytes[i + 1]) << 8) : 0);
+        *out++ = kBase64Chars[(triple >> 18) & 0x3f];
+        *out++ = kBase64Chars[(triple >> 12) & 0x3f];
+        *out++ = (rest > 1) ? kBase64Chars[(triple >> 6) & 0x3f] : '=';
+        *out++ = '=';
     }
 
-    return ret;
+    return result;
 }
 
 static inline std::string encodeBase64(const std::string &s)
@@ -168,71 +156,105 @@ static inline std::string encodeBase64(const std::string &s)
 	return encodeBase64(reinterpret_cast<const unsigned char *>(s.data()), s.length());
 }
 
-static inline bool isBase64(unsigned char c)
-{
-	return (isalnum(c) || (c == '+') || (c == '/'));
-}
-
-static inline std::string decodeBase64(const std::string &encoded_string)
+struct Base64DecodingTable
 {
-    size_t in_len = encoded_string.size();
-    int i = 0;
-    int j = 0;
-    int in_ = 0;
-    unsigned char char_array_4[4], char_array_3[3];
-    std::string ret;
-
-    while (in_len-- && (encoded_string[in_] != '=') && isBase64(encoded_string[in_]))
+    Base64DecodingTable()
     {
-        char_array_4[i++] = encoded_string[in_];
-        in_++;
+        memset(this->values, -1, sizeof(this->values));
 
-        if (i == 4)
+        for (int i = 0; i < int(kBase64Chars.size()); ++i)
         {
-            for (i = 0; i < 4; i++)
-            { char_array_4[i] = kBase64Chars.find(char_array_4[i]); }
+            this->values[uint8(kBase64Chars[i])] = int8(i);
+        }
+    }
 
-            char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-            char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-            char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+    int8 values[256];
+};
 
-            for (i = 0; (i < 3); i++)
-            { ret += char_array_3[i]; }
+static inline std::string decodeBase64(const std::string &encoded)
+{
+    static const Base64DecodingTable table;
+    const int8 *values = table.values;
+    const uint8 *in = reinterpret_cast<const uint8 *>(encoded.data());
 
-            i = 0;
-        }
+    // The data ends at the padding, or at anything that is not base64
+    size_t length = 0;
+
+    while (length < encoded.size() && values[in[length]] >= 0)
+    {
+        ++length;
     }
 
-    if (i)
+    const size_t rest = length % 4;
+    std::string result;
+    result.resize((length / 4) * 3 + (rest > 1 ? rest - 1 : 0));
+
+    char *out = &result[0];
+    size_t i = 0;
+
+    for (; i + 3 < length; i += 4)
     {
-        for (j = i; j < 4; j++)
-        { char_array_4[j] = 0; }
+        const uint32 quad =
+            (uint32(values[in[i]]) << 18) | (uint32(values[in[i + 1]]) << 12) |
+            (uint32(values[in[i + 2]]) << 6) | uint32(values[in[i + 3]]);
 
-        for (j = 0; j < 4; j++)
-        { char_array_4[j] = kBase64Chars.find(char_array_4[j]); }
+        *out++ = char(quad >> 16);
+        *out++ = char(quad >> 8);
+        *out++ = char(quad);
+    }
 
-        char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-        char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-        char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+    if (rest > 1)
+    {
+        const uint32 first = uint32(values[in[i]]);
+        const uint32 second = uint32(values[in[i + 1]]);
+        *out++ = char((first << 2) | (second >> 4));
 
-        for (j = 0; (j < i - 1); j++) { ret += char_array_3[j]; }
+        if (rest > 2)
+        {
+            const uint32 third = uint32(values[in[i + 2]]);
+            *out++ = char((second << 4) | (third >> 2));
+        }
     }
 
-    return ret;
+    return result;
 }
 
-static inline MemoryBlock doXor(const MemoryBlock &input)
+// Xors the data in place, as if it was at the given position of the stream;
+// the key is a whole number of words, so the words of the data,
+// which are aligned to the stream position, match the words of the key
+static inline void doXor(uint8 *data, size_t size, uint64 position) noexcept
 {
-    MemoryBlock encoded;
+    const uint8 *key = reinterpret_cast<const uint8 *>(kXorKey.data());
+    const size_t keySize = kXorKey.size();
+    jassert(keySize % sizeof(uint64) == 0);
+
+    size_t i = 0;
+
+    for (; i < size && ((position + i) % sizeof(uint64)) != 0; ++i)
+    {
+        data[i] ^= key[(position + i) % keySize];
+    }
 
-    for (unsigned long i = 0; i < input.getSize(); i++)
+    for (; i + sizeof(uint64) <= size; i += sizeof(uint64))
     {
-        char orig = input[i];
-        char key = kXorKey[i % kXorKey.length()];
-        char xorChar = orig ^ key;
-        encoded.append(&xorChar, 1);
+        uint64 word;
+        uint64 keyWord;
+        memcpy(&word, data + i, sizeof(uint64));
+        memcpy(&keyWord, key + ((position + i) % keySize), sizeof(uint64));
+        word ^= keyWord;
+        memcpy(data + i, &word, sizeof(uint64));
     }
 
+    for (; i < size; ++i)
+    {
+        data[i] ^= key[(position + i) % keySize];
+    }
+}
+
+static inline MemoryBlock doXor(const MemoryBlock &input)
+{
+    MemoryBlock encoded(input);
+    doXor(static_cast<uint8 *>(encoded.getData()), encoded.getSize(), 0);
     return encoded;
 }
 
@@ -245,21 +267,147 @@ static inline MemoryBlock compress(const String &str)
     return MemoryBlock(memOut.getData(), memOut.getDataSize());
 }
 
+static inline String decompress(InputStream &compressedStream, size_t expectedSize)
+{
+    GZIPDecompressorInputStream gzInput(compressedStream);
+    MemoryOutputStream decompressedData(expectedSize);
+    HeapBlock<char> buffer(DATA_ENCODER_BUFFER_SIZE);
+
+    while (! gzInput.isExhausted())
+    {
+        const int numRead = gzInput.read(buffer, DATA_ENCODER_BUFFER_SIZE);
+
+        if (numRead <= 0)
+        {
+            break;
+        }
+
+        decompressedData.write(buffer, size_t(numRead));
+    }
+
+    return decompressedData.toUTF8();
+}
+
 static inline String decompress(const MemoryBlock &str)
 {
     MemoryInputStream input(str.getData(), str.getSize(), false);
-    GZIPDecompressorInputStream gzInput(input);
-    MemoryBlock decompressedData(0, true);
-    MemoryBlock buf(512);
+    return decompress(input, str.getSize() * 4);
+}
+
+//===----------------------------------------------------------------------===//
+// Streams
+//===----------------------------------------------------------------------===//
+
+// Both keep track of the position in the stream to pick the right part of the key,
+// so the data can be xored block by block on the way to and from the file
+
+class XorOutputStream : public OutputStream
+{
+public:
 
-    while (!gzInput.isExhausted())
+    explicit XorOutputStream(OutputStream &destinationStream) :
+        destination(destinationStream),
+        buffer(DATA_ENCODER_BUFFER_SIZE),
+        position(0) {}
+
+    bool write(const void *data, size_t numBytes) override
     {
-        const int data = gzInput.read(buf.getData(), 512);
-        decompressedData.append(buf.getData(), data);
+        const uint8 *source = static_cast<const uint8 *>(data);
+
+        while (numBytes > 0)
+        {
+            const size_t blockSize = jmin(numBytes, size_t(DATA_ENCODER_BUFFER_SIZE));
+            memcpy(this->buffer, source, blockSize);
+            doXor(this->buffer, blockSize, this->position);
+
+            if (! this->destination.write(this->buffer, blockSize))
+            {
+                return false;
+            }
+
+            this->position += blockSize;
+            source += blockSize;
+            numBytes -= blockSize;
+        }
+
+        return true;
     }
 
-    return decompressedData.toString();
-}
+    void flush() override
+    {
+        this->destination.flush();
+    }
+
+    int64 getPosition() override
+    {
+        return int64(this->position);
+    }
+
+    bool setPosition(int64 newPosition) override
+    {
+        return newPosition == int64(this->position);
+    }
+
+private:
+
+    OutputStream &destination;
+    HeapBlock<uint8> buffer;
+    uint64 position;
+
+    JUCE_DECLARE_NON_COPYABLE(XorOutputStream)
+};
+
+class XorInputStream : public InputStream
+{
+public:
+
+    explicit XorInputStream(InputStream &sourceStream) :
+        source(sourceStream),
+        startPosition(sourceStream.getPosition()),
+        position(0) {}
+
+    int64 getTotalLength() override
+    {
+        const int64 sourceLength = this->source.getTotalLength();
+        return (sourceLength < 0) ? sourceLength : (sourceLength - this->startPosition);
+    }
+
+    bool isExhausted() override
+    {
+        return this->source.isExhausted();
+    }
+
+    int read(void *destBuffer, int maxBytesToRead) override
+    {
+        const int numRead = this->source.read(destBuffer, maxBytesToRead);
+
+        if (numRead > 0)
+        {
+            doXor(static_cast<uint8 *>(destBuffer), size_t(numRead), this->position);
+            this->position += uint64(numRead);
+        }
+
+        return numRead;
+    }
+
+    int64 getPosition() override
+    {
+        return int64(this->position);
+    }
+
+    bool setPosition(int64 newPosition) override
+    {
+        return newPosition == int64(this->position);
+    }
+
+private:
+
+    InputStream &source;
+    const int64 startPosition;
+    uint64 position;
+
+    JUCE_DECLARE_NON_COPYABLE(XorInputStream)
+};
 
 String DataEncoder::obfuscateString(const String &buffer)
 {
@@ -290,12 +438,6 @@ bool DataEncoder::saveObfuscated(const File &file, XmlElement *xml)
 //    
 //#else
     
-    const String xmlString(xml->createDocument("", false, true, "UTF-8", 512));
-    const MemoryBlock &compressed = compress(xmlString);
-    const MemoryBlock &xorBlock = doXor(compressed);
-    
-    MemoryInputStream obfuscatedStream(xorBlock, false);
-    
     if (! file.existsAsFile())
     {
         Result creationResult = file.create();
@@ -303,14 +445,22 @@ bool DataEncoder::saveObfuscated(const File &file, XmlElement *xml)
     }
     
     TempFile tempFile(file);
-    ScopedPointer <OutputStream> out(tempFile.getFile().createOutputStream());
+    ScopedPointer<FileOutputStream> out(new FileOutputStream(tempFile.getFile(), DATA_ENCODER_BUFFER_SIZE));
     
     //Logger::writeToLog("Temp file: " + tempFile.getFile().getFullPathName());
     
-    if (out != nullptr)
+    if (out->openedOk())
     {
         out->writeInt(kMagicNumber);
-        out->writeFromInputStream(obfuscatedStream, -1);
+
+        // The document is compressed and xored on the fly, without building the whole
+        // string and the intermediate blocks; the bytes are the same as they used to be
+        {
+            XorOutputStream obfuscatedStream(*out);
+            GZIPCompressorOutputStream compressedStream(&obfuscatedStream, 1, false);
+            xml->writeToStream(compressedStream, "", false, true, "UTF-8", 512);
+        }
+
         out->flush();
         
         if (tempFile.overwriteTargetFileWithTemporary())
@@ -350,11 +500,10 @@ XmlElement *DataEncoder::loadObfuscated(const File &file)
         
         if (magicNumber == kMagicNumber)
         {
-            SubregionStream subStream(&fileStream, 4, -1, false);
-            MemoryBlock subBlock;
-            subStream.readIntoMemoryBlock(subBlock);
-            const MemoryBlock &xorBlock = doXor(subBlock);
-            const String &uncompressed = decompress(xorBlock);
+            BufferedInputStream bufferedStream(fileStream, DATA_ENCODER_BUFFER_SIZE);
+            XorInputStream obfuscatedStream(bufferedStream);
+            const size_t expectedSize = size_t(fileStream.getTotalLength()) * 4;
+            const String &uncompressed = decompress(obfuscatedStream, expectedSize);
             XmlElement *xml = XmlDocument::parse(uncompressed);
             return xml;
         }
@@ -40,6 +40,28 @@ String FileUtils::getTemporaryFolder()
     return tempFolder.getFullPathName();
 }
 
+File FileUtils::getCacheFolder()
+{
+#if JUCE_LINUX
+    // See the XDG base directory specification
+    const String xdgCacheHome(SystemStats::getEnvironmentVariable("XDG_CACHE_HOME", {}));
+    const File cacheFolder(File::isAbsolutePath(xdgCacheHome) ?
+                           File(xdgCacheHome).getChildFile("Helio") :
+                           File("~/.cache/Helio"));
+#else
+    const File cacheFolder(File::getSpecialLocation(File::userApplicationDataDirectory).
+                           getChildFile("Helio").getChildFile("Cache"));
+#endif
+
+    if (cacheFolder.existsAsFile())
+    { cacheFolder.deleteFile(); }
+
+    if (!cacheFolder.exists())
+    { cacheFolder.createDirectory(); }
+
+    return cacheFolder;
+}
+
 static File getFirstSlot(String location1,
                          String location2,
                          const String &fileName)
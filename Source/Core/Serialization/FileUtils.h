@@ -25,6 +25,8 @@ public:
 
     static String getTemporaryFolder();
 
+    static File getCacheFolder();
+
     static File getDocumentSlot(const String &fileName);
 
     static File getConfigSlot(const String &fileName);
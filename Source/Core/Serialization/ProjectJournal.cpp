@@ -0,0 +1,857 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Common.h"
+#include "ProjectJournal.h"
+#include "ProjectTreeItem.h"
+#include "MidiLayer.h"
+#include "ChunkedProjectFormat.h"
+#include "UndoStack.h"
+#include "SerializationKeys.h"
+
+#define PROJECT_JOURNAL_RECORD_MAGIC 0x314A5048 // "HPJ1"
+
+// Magic, type, payload size and checksum
+#define PROJECT_JOURNAL_HEADER_SIZE (4 + 1 + 4 + 8)
+
+// The journal is compacted once it's that big, or half as big as the project file, whichever is more
+#define PROJECT_JOURNAL_MIN_COMPACTION_SIZE (512 * 1024)
+
+// FNV-1a, same as for the undo history file
+static int64 getChecksum(const void *data, size_t size) noexcept
+{
+    uint64 hash = 14695981039346656037ULL;
+    const uint8 *bytes = static_cast<const uint8 *>(data);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return int64(hash);
+}
+
+//===----------------------------------------------------------------------===//
+// Compactor
+//===----------------------------------------------------------------------===//
+
+class ProjectJournal::Compactor : public Thread
+{
+public:
+
+    Compactor(ProjectJournal &parent, XmlElement *snapshotXml,
+              const String &newSnapshotId, const File &targetFile, int64 journalOffset) :
+        Thread("Helio Project Journal"),
+        owner(parent),
+        snapshot(snapshotXml),
+        snapshotId(newSnapshotId),
+        projectFile(targetFile),
+        snapshotFile(targetFile.getSiblingFile(targetFile.getFileName() + ".snapshot")),
+        offset(journalOffset),
+        succeeded(false) {}
+
+    void run() override
+    {
+        this->succeeded = ChunkedProjectFormat::save(this->snapshotFile, *this->snapshot);
+        this->snapshot = nullptr;
+        this->owner.triggerAsyncUpdate();
+    }
+
+    ProjectJournal &owner;
+
+    ScopedPointer<XmlElement> snapshot;
+
+    const String snapshotId;
+    const File projectFile;
+    const File snapshotFile;
+
+    // The snapshot has everything appended to the journal before that point
+    const int64 offset;
+
+    bool succeeded;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Compactor)
+};
+
+
+//===----------------------------------------------------------------------===//
+// ProjectJournal
+//===----------------------------------------------------------------------===//
+
+ProjectJournal::ProjectJournal(ProjectTreeItem &parentProject) :
+    project(parentProject),
+    size(0),
+    lastEditedLayer(nullptr),
+    needsFullSave(true) {}
+
+ProjectJournal::~ProjectJournal()
+{
+    // The snapshot is most likely about to be done, so let's not waste it
+    if (this->compactor != nullptr)
+    {
+        this->compactor->waitForThreadToExit(-1);
+        this->finishCompaction();
+    }
+
+    this->cancelPendingUpdate();
+}
+
+File ProjectJournal::getFileFor(const File &projectFile)
+{
+    return projectFile.getSiblingFile(projectFile.getFileName() + ".journal");
+}
+
+
+//===----------------------------------------------------------------------===//
+// Loading
+//===----------------------------------------------------------------------===//
+
+struct ProjectJournal::LayerPatch
+{
+    // The latest state of the edited events, nullptr for the removed ones
+    HashMap<String, const XmlElement *> events;
+
+    // The order the events were added in
+    StringArray eventIds;
+
+    void setEvent(const String &eventId, const XmlElement *eventXml)
+    {
+        if (! this->events.contains(eventId))
+        {
+            this->eventIds.add(eventId);
+        }
+
+        this->events.set(eventId, eventXml);
+    }
+
+    void apply(XmlElement &layerXml)
+    {
+        // Detaching the children one by one from the head of the list,
+        // and then prepending them back, so that it takes linear time
+        Array<XmlElement *> children;
+
+        while (XmlElement *child = layerXml.getFirstChildElement())
+        {
+            layerXml.removeChildElement(child, false);
+            children.add(child);
+        }
+
+        Array<XmlElement *> result;
+        result.ensureStorageAllocated(children.size() + this->eventIds.size());
+
+        for (auto child : children)
+        {
+            const String eventId(child->getStringAttribute("id"));
+
+            if (eventId.isNotEmpty() && this->events.contains(eventId))
+            {
+                if (const XmlElement *latest = this->events[eventId])
+                {
+                    result.add(new XmlElement(*latest));
+                }
+
+                this->events.remove(eventId);
+                delete child;
+            }
+            else
+            {
+                result.add(child);
+            }
+        }
+
+        for (const auto &eventId : this->eventIds)
+        {
+            if (this->events.contains(eventId))
+            {
+                if (const XmlElement *added = this->events[eventId])
+                {
+                    result.add(new XmlElement(*added));
+                }
+            }
+        }
+
+        for (int i = result.size(); --i >= 0;)
+        {
+            layerXml.prependChildElement(result.getUnchecked(i));
+        }
+    }
+};
+
+void ProjectJournal::replay(const File &targetProjectFile, XmlElement &projectXml)
+{
+    const String projectSnapshotId(projectXml.getStringAttribute(PROJECT_JOURNAL_SNAPSHOT_ATTRIBUTE));
+
+    if (this->beginReplay(targetProjectFile, projectSnapshotId))
+    {
+        this->replayAllLayers(projectXml);
+    }
+
+    this->endReplay();
+}
+
+void ProjectJournal::replayAllLayers(XmlElement &xml)
+{
+    forEachXmlChildElement(xml, child)
+    {
+        if (MidiLayer::isLayerXml(*child))
+        {
+            this->replayLayer(*child);
+        }
+        else
+        {
+            this->replayAllLayers(*child);
+        }
+    }
+}
+
+void ProjectJournal::replayLayer(XmlElement &layerXml)
+{
+    if (LayerPatch *patch = this->replayPatchesByLayerId[layerXml.getStringAttribute("id")])
+    {
+        patch->apply(layerXml);
+    }
+}
+
+void ProjectJournal::endReplay()
+{
+    this->replayPatchesByLayerId.clear();
+    this->replayPatches.clear();
+    this->replayRecords.clear();
+}
+
+bool ProjectJournal::beginReplay(const File &targetProjectFile, const String &projectSnapshotId)
+{
+    this->cancelCompaction();
+    this->forgetChanges();
+    this->endReplay();
+
+    this->projectFile = targetProjectFile;
+    this->file = getFileFor(targetProjectFile);
+    this->snapshotId = projectSnapshotId;
+    this->size = 0;
+
+    // Saved by the older versions, the next save will be the full one
+    if (this->snapshotId.isEmpty() || ! this->file.existsAsFile())
+    {
+        return false;
+    }
+
+    OwnedArray<MemoryBlock> changes;
+    Array<int64> changesOffsets;
+    String headerSnapshotId;
+    int64 replayFrom = -1;
+    int64 validSize = 0;
+    int64 fileSize = 0;
+
+    {
+        FileInputStream in(this->file);
+
+        if (in.failedToOpen())
+        {
+            return false;
+        }
+
+        fileSize = in.getTotalLength();
+
+        while (validSize + PROJECT_JOURNAL_HEADER_SIZE <= fileSize && in.setPosition(validSize))
+        {
+            const int magic = in.readInt();
+            const int type = uint8(in.readByte());
+            const int payloadSize = in.readInt();
+            const int64 checksum = in.readInt64();
+
+            if (magic != PROJECT_JOURNAL_RECORD_MAGIC || payloadSize <= 0 ||
+                validSize + PROJECT_JOURNAL_HEADER_SIZE + payloadSize > fileSize)
+            {
+                break;
+            }
+
+            ScopedPointer<MemoryBlock> payload(new MemoryBlock());
+
+            if (in.readIntoMemoryBlock(*payload, payloadSize) != size_t(payloadSize) ||
+                getChecksum(payload->getData(), payload->getSize()) != checksum)
+            {
+                break;
+            }
+
+            if (type == headerRecord && validSize == 0)
+            {
+                MemoryInputStream header(*payload, false);
+                headerSnapshotId = header.readString();
+            }
+            else if (type == snapshotRecord)
+            {
+                MemoryInputStream snapshot(*payload, false);
+                const String id(snapshot.readString());
+                const int64 offset = snapshot.readInt64();
+
+                if (id == this->snapshotId)
+                {
+                    replayFrom = offset;
+                }
+            }
+            else if (type == changesRecord && validSize > 0)
+            {
+                changesOffsets.add(validSize);
+                changes.add(payload.release());
+            }
+            else
+            {
+                break;
+            }
+
+            validSize += PROJECT_JOURNAL_HEADER_SIZE + payloadSize;
+        }
+    }
+
+    if (headerSnapshotId == this->snapshotId)
+    {
+        replayFrom = 0;
+    }
+
+    // Either the project has been saved without a journal since then,
+    // or the app has crashed before the journal was started over
+    if (headerSnapshotId.isEmpty() || replayFrom < 0)
+    {
+        Logger::writeToLog("ProjectJournal: " + this->file.getFileName() + " doesn't match the project");
+        this->remove();
+        return false;
+    }
+
+    // Most likely, the app has crashed while saving
+    if (validSize < fileSize)
+    {
+        Logger::writeToLog("ProjectJournal: cutting off a damaged tail of " + this->file.getFileName());
+        FileOutputStream out(this->file);
+        out.setPosition(validSize);
+        out.truncate();
+    }
+
+    this->size = validSize;
+
+    for (int i = 0; i < changes.size(); ++i)
+    {
+        if (changesOffsets.getUnchecked(i) < replayFrom)
+        {
+            continue;
+        }
+
+        MemoryInputStream compressedStream(*changes.getUnchecked(i), false);
+        GZIPDecompressorInputStream gzip(compressedStream);
+        XmlElement *record = XmlDocument::parse(gzip.readEntireStreamAsString());
+
+        if (record == nullptr)
+        {
+            continue;
+        }
+
+        this->replayRecords.add(record);
+
+        forEachXmlChildElementWithTagName(*record, layerChanges, Serialization::Core::journalLayer)
+        {
+            const String layerId(layerChanges->getStringAttribute("id"));
+            LayerPatch *patch = this->replayPatchesByLayerId[layerId];
+
+            if (patch == nullptr)
+            {
+                patch = this->replayPatches.add(new LayerPatch());
+                this->replayPatchesByLayerId.set(layerId, patch);
+            }
+
+            forEachXmlChildElement(*layerChanges, eventXml)
+            {
+                if (eventXml->hasTagName(Serialization::Core::journalRemovedEvents))
+                {
+                    StringArray removedIds;
+                    removedIds.addTokens(eventXml->getStringAttribute("ids"), " ", "");
+
+                    for (const auto &removedId : removedIds)
+                    {
+                        patch->setEvent(removedId, nullptr);
+                    }
+                }
+                else
+                {
+                    patch->setEvent(eventXml->getStringAttribute("id"), eventXml);
+                }
+            }
+        }
+    }
+
+    Logger::writeToLog("ProjectJournal: " + String(this->replayRecords.size()) + " records to replay");
+    return this->replayPatches.size() > 0;
+}
+
+void ProjectJournal::onProjectDidLoad()
+{
+    this->forgetChanges();
+    this->needsFullSave = false;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Saving
+//===----------------------------------------------------------------------===//
+
+bool ProjectJournal::canAppend(const File &targetProjectFile) const
+{
+    return ! this->needsFullSave &&
+           this->snapshotId.isNotEmpty() &&
+           this->projectFile == targetProjectFile;
+}
+
+bool ProjectJournal::append()
+{
+    if (this->editedLayers.isEmpty())
+    {
+        return true;
+    }
+
+    if (this->size == 0)
+    {
+        MemoryOutputStream header;
+        header.writeString(this->snapshotId);
+
+        if (! this->appendRecord(headerRecord, header.getMemoryBlock()))
+        {
+            return false;
+        }
+    }
+
+    ScopedPointer<XmlElement> changes(this->createChangesXml());
+    MemoryOutputStream compressed;
+
+    {
+        GZIPCompressorOutputStream gzip(&compressed, 1, false);
+        changes->writeToStream(gzip, StringRef(), true, false);
+    }
+
+    if (! this->appendRecord(changesRecord, compressed.getMemoryBlock()))
+    {
+        return false;
+    }
+
+    this->forgetChanges();
+    return true;
+}
+
+bool ProjectJournal::needsCompaction() const
+{
+    return this->compactor == nullptr &&
+           this->size > jmax(int64(PROJECT_JOURNAL_MIN_COMPACTION_SIZE), this->projectFile.getSize() / 2);
+}
+
+void ProjectJournal::startCompaction(XmlElement *snapshot)
+{
+    ScopedPointer<XmlElement> snapshotXml(snapshot);
+
+    if (this->compactor != nullptr || this->size == 0)
+    {
+        return;
+    }
+
+    const String newSnapshotId(Uuid().toString());
+    snapshotXml->setAttribute(PROJECT_JOURNAL_SNAPSHOT_ATTRIBUTE, newSnapshotId);
+
+    this->compactor = new Compactor(*this, snapshotXml.release(),
+                                    newSnapshotId, this->projectFile, this->size);
+
+    this->compactor->startThread(3);
+}
+
+void ProjectJournal::onFullSave(const File &targetProjectFile, const String &newSnapshotId)
+{
+    this->cancelCompaction();
+
+    // The project has been renamed, so the old journal is of no use
+    if (this->projectFile != targetProjectFile && ! this->projectFile.existsAsFile())
+    {
+        this->remove();
+    }
+
+    this->projectFile = targetProjectFile;
+    this->file = getFileFor(targetProjectFile);
+    this->snapshotId = newSnapshotId;
+
+    // The header is written along with the first changes
+    this->remove();
+    this->forgetChanges();
+    this->needsFullSave = false;
+}
+
+XmlElement *ProjectJournal::createChangesXml() const
+{
+    auto xml = new XmlElement(Serialization::Core::journalChanges);
+
+    for (auto editedLayer : this->editedLayers)
+    {
+        Array<MidiEvent::Id> &ids = editedLayer->eventIds;
+        std::sort(ids.begin(), ids.end());
+        ids.resize(int(std::unique(ids.begin(), ids.end()) - ids.begin()));
+
+        Array<bool> found;
+        found.insertMultiple(0, false, ids.size());
+
+        Array<XmlElement *> eventsXml;
+        const MidiLayer *layer = editedLayer->layer;
+
+        // One pass over the layer instead of a lookup for each id
+        for (int i = 0; i < layer->size(); ++i)
+        {
+            const MidiEvent *event = layer->getUnchecked(i);
+            const MidiEvent::Id *match = std::lower_bound(ids.begin(), ids.end(), event->getID());
+
+            if (match != ids.end() && *match == event->getID())
+            {
+                found.set(int(match - ids.begin()), true);
+                eventsXml.add(event->serialize());
+            }
+        }
+
+        auto layerXml = xml->createNewChildElement(Serialization::Core::journalLayer);
+        layerXml->setAttribute("id", layer->getLayerIdAsString());
+
+        StringArray removedIds;
+
+        for (int i = 0; i < ids.size(); ++i)
+        {
+            if (! found.getUnchecked(i))
+            {
+                removedIds.add(MidiEvent::idToString(ids.getUnchecked(i)));
+            }
+        }
+
+        for (int i = eventsXml.size(); --i >= 0;)
+        {
+            layerXml->prependChildElement(eventsXml.getUnchecked(i));
+        }
+
+        if (removedIds.size() > 0)
+        {
+            auto removedXml = layerXml->createNewChildElement(Serialization::Core::journalRemovedEvents);
+            removedXml->setAttribute("ids", removedIds.joinIntoString(" "));
+        }
+    }
+
+    return xml;
+}
+
+bool ProjectJournal::writeRecord(OutputStream &out, RecordType type, const MemoryBlock &payload)
+{
+    const bool writtenOk =
+        out.writeInt(PROJECT_JOURNAL_RECORD_MAGIC) &&
+        out.writeByte(char(type)) &&
+        out.writeInt(int(payload.getSize())) &&
+        out.writeInt64(getChecksum(payload.getData(), payload.getSize())) &&
+        out.write(payload.getData(), payload.getSize());
+
+    return writtenOk;
+}
+
+bool ProjectJournal::appendRecord(RecordType type, const MemoryBlock &payload)
+{
+    FileOutputStream out(this->file);
+
+    if (out.failedToOpen())
+    {
+        return false;
+    }
+
+    // Whatever was there after the last good record is overwritten
+    out.setPosition(this->size);
+    out.truncate();
+
+    if (! writeRecord(out, type, payload))
+    {
+        return false;
+    }
+
+    // Flushes to disk as well, so that the record is there
+    // before anything that relies on it is written
+    out.flush();
+
+    if (out.getStatus().failed())
+    {
+        return false;
+    }
+
+    this->size += PROJECT_JOURNAL_HEADER_SIZE + int64(payload.getSize());
+    return true;
+}
+
+bool ProjectJournal::rewrite(int64 fromOffset)
+{
+    TemporaryFile tempFile(this->file);
+    int64 newSize = 0;
+
+    {
+        FileInputStream in(this->file);
+        FileOutputStream out(tempFile.getFile());
+
+        if (in.failedToOpen() || out.failedToOpen())
+        {
+            return false;
+        }
+
+        MemoryOutputStream header;
+        header.writeString(this->snapshotId);
+
+        if (! writeRecord(out, headerRecord, header.getMemoryBlock()))
+        {
+            return false;
+        }
+
+        newSize += PROJECT_JOURNAL_HEADER_SIZE + int64(header.getDataSize());
+
+        int64 position = fromOffset;
+
+        while (position + PROJECT_JOURNAL_HEADER_SIZE <= this->size && in.setPosition(position))
+        {
+            in.readInt(); // magic
+            const int type = uint8(in.readByte());
+            const int payloadSize = in.readInt();
+            in.readInt64(); // checksum
+
+            MemoryBlock payload;
+
+            if (in.readIntoMemoryBlock(payload, payloadSize) != size_t(payloadSize))
+            {
+                return false;
+            }
+
+            if (type == changesRecord)
+            {
+                if (! writeRecord(out, changesRecord, payload))
+                {
+                    return false;
+                }
+
+                newSize += PROJECT_JOURNAL_HEADER_SIZE + payloadSize;
+            }
+
+            position += PROJECT_JOURNAL_HEADER_SIZE + payloadSize;
+        }
+
+        out.flush();
+
+        if (out.getStatus().failed())
+        {
+            return false;
+        }
+    }
+
+    if (! tempFile.overwriteTargetFileWithTemporary())
+    {
+        return false;
+    }
+
+    this->size = newSize;
+    return true;
+}
+
+void ProjectJournal::remove()
+{
+    this->file.deleteFile();
+    this->size = 0;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Compaction
+//===----------------------------------------------------------------------===//
+
+void ProjectJournal::handleAsyncUpdate()
+{
+    this->finishCompaction();
+}
+
+void ProjectJournal::finishCompaction()
+{
+    if (this->compactor == nullptr || this->compactor->isThreadRunning())
+    {
+        return;
+    }
+
+    ScopedPointer<Compactor> done(this->compactor.release());
+
+    if (! done->succeeded || this->size == 0 ||
+        done->projectFile != this->projectFile)
+    {
+        done->snapshotFile.deleteFile();
+        return;
+    }
+
+    // From now on, the journal fits both the old snapshot and the new one
+    MemoryOutputStream snapshot;
+    snapshot.writeString(done->snapshotId);
+    snapshot.writeInt64(done->offset);
+
+    if (! this->appendRecord(snapshotRecord, snapshot.getMemoryBlock()))
+    {
+        done->snapshotFile.deleteFile();
+        return;
+    }
+
+    // The undo history file is checked against the project file's size and date
+    UndoStack *undoStack = this->project.getUndoStack();
+    undoStack->onProjectWillSave();
+
+    if (! done->snapshotFile.moveFileTo(this->projectFile))
+    {
+        Logger::writeToLog("ProjectJournal: failed to replace " + this->projectFile.getFileName());
+        done->snapshotFile.deleteFile();
+        return;
+    }
+
+    undoStack->onProjectDidSave(this->projectFile);
+    this->snapshotId = done->snapshotId;
+
+    // If that fails, the old journal is still good, thanks to the snapshot record
+    if (! this->rewrite(done->offset))
+    {
+        Logger::writeToLog("ProjectJournal: failed to rewrite " + this->file.getFileName());
+    }
+}
+
+void ProjectJournal::cancelCompaction()
+{
+    if (this->compactor != nullptr)
+    {
+        this->compactor->waitForThreadToExit(-1);
+        this->compactor->snapshotFile.deleteFile();
+        this->compactor = nullptr;
+    }
+
+    this->cancelPendingUpdate();
+}
+
+
+//===----------------------------------------------------------------------===//
+// ProjectListener
+//===----------------------------------------------------------------------===//
+
+void ProjectJournal::eventEdited(const MidiEvent &event)
+{
+    const MidiLayer *layer = event.getLayer();
+
+    if (this->lastEditedLayer == nullptr || this->lastEditedLayer->layer != layer)
+    {
+        this->lastEditedLayer = nullptr;
+
+        for (auto editedLayer : this->editedLayers)
+        {
+            if (editedLayer->layer == layer)
+            {
+                this->lastEditedLayer = editedLayer;
+                break;
+            }
+        }
+
+        if (this->lastEditedLayer == nullptr)
+        {
+            this->lastEditedLayer = this->editedLayers.add(new EditedLayer());
+            this->lastEditedLayer->layer = layer;
+        }
+    }
+
+    this->lastEditedLayer->eventIds.add(event.getID());
+}
+
+void ProjectJournal::forgetChanges()
+{
+    this->editedLayers.clear();
+    this->lastEditedLayer = nullptr;
+}
+
+void ProjectJournal::onEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent)
+{
+    // The old id is not in the layer anymore, so it is saved as removed
+    if (oldEvent.getID() != newEvent.getID())
+    {
+        this->eventEdited(oldEvent);
+    }
+
+    this->eventEdited(newEvent);
+}
+
+void ProjectJournal::onEventAdded(const MidiEvent &event)
+{
+    this->eventEdited(event);
+}
+
+void ProjectJournal::onEventRemoved(const MidiEvent &event)
+{
+    this->eventEdited(event);
+}
+
+void ProjectJournal::onChangesBatch(const LayerChangeSet &changes)
+{
+    for (auto event : changes.getRemovedEvents())
+    {
+        this->eventEdited(*event);
+    }
+
+    for (auto event : changes.getAddedEvents())
+    {
+        this->eventEdited(*event);
+    }
+
+    const Array<const MidiEvent *> &changedBefore = changes.getChangedEventsBefore();
+    const Array<const MidiEvent *> &changedAfter = changes.getChangedEventsAfter();
+
+    for (int i = 0; i < changedAfter.size(); ++i)
+    {
+        const MidiEvent *before = changedBefore[i];
+        const MidiEvent *after = changedAfter.getUnchecked(i);
+
+        if (before != nullptr && before->getID() != after->getID())
+        {
+            this->eventEdited(*before);
+        }
+
+        this->eventEdited(*after);
+    }
+}
+
+void ProjectJournal::onLayerChanged(const MidiLayer *layer)
+{
+    this->needsFullSave = true;
+}
+
+void ProjectJournal::onLayerAdded(const MidiLayer *layer)
+{
+    this->needsFullSave = true;
+}
+
+void ProjectJournal::onLayerRemoved(const MidiLayer *layer)
+{
+    this->needsFullSave = true;
+}
+
+void ProjectJournal::onLayerMoved(const MidiLayer *layer)
+{
+    this->needsFullSave = true;
+}
+
+void ProjectJournal::onInfoChanged(const ProjectInfo *info)
+{
+    this->needsFullSave = true;
+}
+
+void ProjectJournal::onProjectBeatRangeChanged(float firstBeat, float lastBeat) {}
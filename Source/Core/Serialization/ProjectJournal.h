@@ -0,0 +1,180 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "ProjectListener.h"
+#include "MidiEvent.h"
+
+class ProjectTreeItem;
+
+// The project xml attribute with the id of the snapshot
+#define PROJECT_JOURNAL_SNAPSHOT_ATTRIBUTE "journal"
+
+// Lets the autosaves append the edited events to a journal file next to the project,
+// instead of re-encoding the whole project every time.
+//
+// The project file is a snapshot, marked with a random id, and the journal starts
+// with a header naming the snapshot it applies to. Each save appends a record with
+// the current state of the events edited since the previous save, and the ids
+// of the removed ones, for each edited layer. Each record has a checksum, and
+// the file is flushed to disk after each one, so a crash can only cost the last
+// record, which is cut off on load. On load, the records are applied to the project
+// xml before it is deserialized. Anything but the events' changes (layers added,
+// removed, moved or renamed, the project info, version control) needs a full save,
+// which writes a new snapshot and starts the journal over.
+//
+// Once the journal is big enough, a new snapshot is encoded and written on a
+// background thread. Before it replaces the project file, a record is appended
+// to the journal saying up to where the new snapshot goes, so that the journal
+// fits either of the project files; then the journal is rewritten with the
+// records the new snapshot doesn't have.
+
+class ProjectJournal : public ProjectListener, private AsyncUpdater
+{
+public:
+
+    explicit ProjectJournal(ProjectTreeItem &parentProject);
+
+    ~ProjectJournal() override;
+
+    static File getFileFor(const File &projectFile);
+
+    // Applies the journal to the project xml which is about to be loaded;
+    // a journal that doesn't match the snapshot is removed
+    void replay(const File &projectFile, XmlElement &projectXml);
+
+    // The same, for the projects loaded layer by layer: reads the journal,
+    // and returns true if there are any changes to apply to the layers' xml
+    bool beginReplay(const File &projectFile, const String &projectSnapshotId);
+    void replayLayer(XmlElement &layerXml);
+    void endReplay();
+
+    // Forgets the changes made while loading
+    void onProjectDidLoad();
+
+    bool canAppend(const File &projectFile) const;
+
+    // Returns false if the changes could not be written,
+    // in which case a full save is needed
+    bool append();
+
+    bool needsCompaction() const;
+
+    // Takes the ownership of the snapshot xml, which should include all the changes appended so far
+    void startCompaction(XmlElement *snapshot);
+
+    // Should be called after the full snapshot has been saved as the project file
+    void onFullSave(const File &projectFile, const String &snapshotId);
+
+    // For the changes the journal doesn't know about, like the version control ones
+    void markNeedsFullSave() noexcept
+    { this->needsFullSave = true; }
+
+    //===------------------------------------------------------------------===//
+    // ProjectListener
+    //===------------------------------------------------------------------===//
+
+    void onEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
+
+    void onEventAdded(const MidiEvent &event) override;
+
+    void onEventRemoved(const MidiEvent &event) override;
+
+    void onChangesBatch(const LayerChangeSet &changes) override;
+
+    void onLayerChanged(const MidiLayer *layer) override;
+
+    void onLayerAdded(const MidiLayer *layer) override;
+
+    void onLayerRemoved(const MidiLayer *layer) override;
+
+    void onLayerMoved(const MidiLayer *layer) override;
+
+    void onInfoChanged(const ProjectInfo *info) override;
+
+    void onProjectBeatRangeChanged(float firstBeat, float lastBeat) override;
+
+private:
+
+    enum RecordType
+    {
+        headerRecord = 1,
+        changesRecord = 2,
+        snapshotRecord = 3
+    };
+
+    struct EditedLayer
+    {
+        const MidiLayer *layer;
+
+        // Might have duplicates, sorted out at save time
+        Array<MidiEvent::Id> eventIds;
+    };
+
+    struct LayerPatch;
+
+    void replayAllLayers(XmlElement &xml);
+
+    void eventEdited(const MidiEvent &event);
+
+    void forgetChanges();
+
+    XmlElement *createChangesXml() const;
+
+    static bool writeRecord(OutputStream &out, RecordType type, const MemoryBlock &payload);
+
+    bool appendRecord(RecordType type, const MemoryBlock &payload);
+
+    // Rewrites the journal for the new snapshot, keeping the records past the given offset
+    bool rewrite(int64 fromOffset);
+
+    void remove();
+
+    void handleAsyncUpdate() override;
+
+    void finishCompaction();
+
+    void cancelCompaction();
+
+    ProjectTreeItem &project;
+
+    File projectFile;
+    File file;
+
+    String snapshotId;
+
+    // Where the valid records end
+    int64 size;
+
+    OwnedArray<EditedLayer> editedLayers;
+    EditedLayer *lastEditedLayer;
+
+    bool needsFullSave;
+
+    // The journal records read on load, and the changes they make, by layer id
+    OwnedArray<XmlElement> replayRecords;
+    OwnedArray<LayerPatch> replayPatches;
+    HashMap<String, LayerPatch *> replayPatchesByLayerId;
+
+    class Compactor;
+    friend class Compactor;
+    ScopedPointer<Compactor> compactor;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectJournal)
+};
@@ -68,6 +68,11 @@ namespace Serialization
         static const String annotation = "Annotation";
         static const String timeSignature = "TimeSignature";
 
+        // Project journal
+        static const String journalChanges = "JournalChanges";
+        static const String journalLayer = "JournalLayer";
+        static const String journalRemovedEvents = "RemovedEvents";
+
         static const String valueTag = "Key";
         static const String nameAttribute = "Name";
         static const String valueAttribute = "Value";
@@ -79,6 +84,14 @@ namespace Serialization
         static const String disabledState = "Disabled";
 
         static const String pluginManager = "PluginManager";
+        static const String pluginScanCache = "PluginScanCache";
+        static const String scannedFile = "ScannedFile";
+        static const String scannedFilePath = "path";
+        static const String scannedFileSize = "size";
+        static const String scannedFileTime = "time";
+        static const String scannedFileHash = "hash";
+        static const String scannedFileStatus = "status";
+        static const String scannedFileTypes = "types";
         static const String audioSettings = "AudioSettings";
         static const String audioCore = "AudioCore";
         static const String orchestra = "Orchestra";
@@ -89,6 +102,7 @@ namespace Serialization
         static const String clipboard = "HelioClipboard";
 
         static const String lastUsedLogin = "LastUsedLogin";
+        static const String undoHistoryBudget = "UndoHistoryBudget";
     } // namespace Core
 
     namespace UI
@@ -347,6 +361,12 @@ namespace Serialization
         static const String noteAfter = "NoteAfter";
         static const String groupBefore = "GroupBefore";
         static const String groupAfter = "GroupAfter";
+        static const String ids = "Ids";
+        static const String deltaTicks = "DeltaTicks";
+        static const String deltaKeys = "DeltaKeys";
+        static const String deltaLengths = "DeltaLengths";
+        static const String velocitiesBefore = "VelocitiesBefore";
+        static const String velocitiesAfter = "VelocitiesAfter";
 
         static const String pianoLayerTreeItemInsertAction = "PianoLayerTreeItemInsertAction";
         static const String pianoLayerTreeItemRemoveAction = "PianoLayerTreeItemRemoveAction";
@@ -366,6 +386,7 @@ namespace Serialization
         static const String notesGroupInsertAction = "NotesGroupInsertAction";
         static const String notesGroupRemoveAction = "NotesGroupRemoveAction";
         static const String notesGroupChangeAction = "NotesGroupChangeAction";
+        static const String notesGroupTransformAction = "NotesGroupTransformAction";
         
         static const String annotationEventInsertAction = "AnnotationEventInsertAction";
         static const String annotationEventRemoveAction = "AnnotationEventRemoveAction";
@@ -286,7 +286,7 @@ static AutomationEvent *eventAtPosition(float beatPosition, AutomationLayer *lay
     {
         AutomationEvent *event = static_cast<AutomationEvent *>(layer->getUnchecked(i));
         
-        if (event->getBeat() == beatPosition)
+        if (event->getTick() == MidiEvent::beatToTick(beatPosition))
         {
             return event;
         }
@@ -425,6 +425,42 @@ static float snappedBeat(float beat, float snapsPerBeat)
     return roundf(beat / snapsPerBeat) * snapsPerBeat;
 }
 
+static void collectSelectedNotes(const MidiEventSelection &selection,
+                                 SortedSet<const Note *> &selectedNotes,
+                                 Array<PianoLayer *> &layers)
+{
+    for (int i = 0; i < selection.getNumSelected(); ++i)
+    {
+        NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
+        selectedNotes.add(&nc->getNote());
+        layers.addIfNotAlreadyThere(static_cast<PianoLayer *>(nc->getNote().getLayer()));
+    }
+}
+
+// Other selected notes of the same key, which overlap the given one,
+// looked up in the key indices of the layers the selection spans
+static void findSelectedOverlaps(const Array<PianoLayer *> &layers,
+                                 const SortedSet<const Note *> &selectedNotes,
+                                 const Note &note, Array<Note *> &result)
+{
+    result.clearQuick();
+
+    for (auto layer : layers)
+    {
+        layer->findNotes(note.getKey(), note.getBeat(), note.getBeat() + note.getLength(), result);
+    }
+
+    for (int i = result.size(); --i >= 0; )
+    {
+        const Note *other = result.getUnchecked(i);
+
+        if (other == &note || ! selectedNotes.contains(other))
+        {
+            result.remove(i);
+        }
+    }
+}
+
 
 
 void MidiRollToolbox::wipeSpace(Array<MidiLayer *> layers,
@@ -540,15 +576,14 @@ void MidiRollToolbox::shiftEventsToTheLeft(Array<MidiLayer *> layers, float targ
         if (nullptr != dynamic_cast<PianoLayer *>(layers.getUnchecked(i)))
         {
             PianoLayer *layer = dynamic_cast<PianoLayer *>(layers.getUnchecked(i));
-            for (int j = 0; j < layer->size(); ++j)
-            {
-                Note *note = static_cast<Note *>(layer->getUnchecked(j));
+            const NoteColumns &notes = layer->getColumns();
+            const int numNotesBefore = notes.indexOfFirstNoteAtOrAfter(MidiEvent::beatToTick(targetBeat));
 
-                if (note->getBeat() < targetBeat)
-                {
-                    pianoGroupBefore.add(*note);
-                    pianoGroupAfter.add(note->withDeltaBeat(beatOffset));
-                }
+            for (int j = 0; j < numNotesBefore; ++j)
+            {
+                const Note *note = notes.getHandle(j);
+                pianoGroupBefore.add(*note);
+                pianoGroupAfter.add(note->withDeltaBeat(beatOffset));
             }
         }
         else if (nullptr != dynamic_cast<AnnotationsLayer *>(layers.getUnchecked(i)))
@@ -604,15 +639,13 @@ void MidiRollToolbox::shiftEventsToTheRight(Array<MidiLayer *> layers, float tar
         if (nullptr != dynamic_cast<PianoLayer *>(layers.getUnchecked(i)))
         {
             PianoLayer *layer = dynamic_cast<PianoLayer *>(layers.getUnchecked(i));
-            for (int j = 0; j < layer->size(); ++j)
+            const NoteColumns &notes = layer->getColumns();
+
+            for (int j = notes.indexOfFirstNoteAtOrAfter(MidiEvent::beatToTick(targetBeat)); j < notes.size(); ++j)
             {
-                Note *note = static_cast<Note *>(layer->getUnchecked(j));
-                
-                if (note->getBeat() >= targetBeat)
-                {
-                    groupBefore.add(*note);
-                    groupAfter.add(note->withDeltaBeat(beatOffset));
-                }
+                const Note *note = notes.getHandle(j);
+                groupBefore.add(*note);
+                groupAfter.add(note->withDeltaBeat(beatOffset));
             }
         }
         else if (nullptr != dynamic_cast<AnnotationsLayer *>(layers.getUnchecked(i)))
@@ -694,6 +727,11 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
     
     bool didCheckpoint = false;
     
+    SortedSet<const Note *> selectedNotes;
+    Array<PianoLayer *> layers;
+    Array<Note *> overlaps;
+    collectSelectedNotes(selection, selectedNotes, layers);
+    
     // 0 snap to 0.001 beat
     PianoChangeGroup group0Before, group0After;
     
@@ -745,20 +783,22 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
             float deltaBeats = -FLT_MAX;
             const Note *overlappingNote = nullptr;
             
-            for (int j = 0; j < selection.getNumSelected(); ++j)
+            findSelectedOverlaps(layers, selectedNotes, nc->getNote(), overlaps);
+            
+            for (int j = 0; j < overlaps.size(); ++j)
             {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
+                const Note *n2 = overlaps.getUnchecked(j);
                 
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() > nc2->getBeat() &&
-                    (nc->getBeat() + nc->getLength()) < (nc2->getBeat() + nc2->getLength()))
+                if (nc->getKey() == n2->getKey() &&
+                    nc->getBeat() > n2->getBeat() &&
+                    (nc->getBeat() + nc->getLength()) < (n2->getBeat() + n2->getLength()))
                 {
-                    const float currentDelta = (nc2->getBeat() + nc2->getLength()) - (nc->getBeat() + nc->getLength());
+                    const float currentDelta = (n2->getBeat() + n2->getLength()) - (nc->getBeat() + nc->getLength());
                     
                     if (deltaBeats < currentDelta)
                     {
                         deltaBeats = currentDelta;
-                        overlappingNote = &nc2->getNote();
+                        overlappingNote = n2;
                     }
                 }
             }
@@ -798,23 +838,25 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
             // для каждой ноты найти ноту, которая полностью перекрывает ее на максимальную длину
             
             float deltaBeats = -FLT_MAX;
-            const NoteComponent *overlappingNote = nullptr;
+            const Note *overlappingNote = nullptr;
+            
+            findSelectedOverlaps(layers, selectedNotes, nc->getNote(), overlaps);
             
-            for (int j = 0; j < selection.getNumSelected(); ++j)
+            for (int j = 0; j < overlaps.size(); ++j)
             {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
+                const Note *n2 = overlaps.getUnchecked(j);
                 
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() > nc2->getBeat() &&
-                    nc->getBeat() < (nc2->getBeat() + nc2->getLength()) &&
-                    (nc->getBeat() + nc->getLength()) > (nc2->getBeat() + nc2->getLength()))
+                if (nc->getKey() == n2->getKey() &&
+                    nc->getBeat() > n2->getBeat() &&
+                    nc->getBeat() < (n2->getBeat() + n2->getLength()) &&
+                    (nc->getBeat() + nc->getLength()) > (n2->getBeat() + n2->getLength()))
                 {
-                    const float currentDelta = (nc->getBeat() + nc->getLength()) - (nc2->getBeat() + nc2->getLength());
+                    const float currentDelta = (nc->getBeat() + nc->getLength()) - (n2->getBeat() + n2->getLength());
                     
                     if (deltaBeats < currentDelta)
                     {
                         deltaBeats = currentDelta;
-                        overlappingNote = nc2;
+                        overlappingNote = n2;
                     }
                 }
             }
@@ -822,8 +864,8 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
             if (overlappingNote != nullptr)
             {
                 //Logger::writeToLog("edit2");
-                group2Before.add(overlappingNote->getNote());
-                group2After.add(overlappingNote->getNote().withDeltaLength(deltaBeats));
+                group2Before.add(*overlappingNote);
+                group2After.add(overlappingNote->withDeltaLength(deltaBeats));
             }
         }
         
@@ -853,23 +895,25 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
             // для каждой ноты найти ноту, которая перекрывает ее максимально
             
             float overlappingBeats = -FLT_MAX;
-            const NoteComponent *overlappingNote = nullptr;
+            const Note *overlappingNote = nullptr;
             
-            for (int j = 0; j < selection.getNumSelected(); ++j)
+            findSelectedOverlaps(layers, selectedNotes, nc->getNote(), overlaps);
+            
+            for (int j = 0; j < overlaps.size(); ++j)
             {
-                NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
+                const Note *n2 = overlaps.getUnchecked(j);
                 
-                if (nc->getKey() == nc2->getKey() &&
-                    nc->getBeat() < nc2->getBeat() &&
-                    (nc->getBeat() + nc->getLength()) >= (nc2->getBeat() + nc2->getLength()))
+                if (nc->getKey() == n2->getKey() &&
+                    nc->getBeat() < n2->getBeat() &&
+                    (nc->getBeat() + nc->getLength()) >= (n2->getBeat() + n2->getLength()))
                 {
                     // >0 : has overlap
-                    const float overlapsWith = (nc->getBeat() + nc->getLength()) - nc2->getBeat();
+                    const float overlapsWith = (nc->getBeat() + nc->getLength()) - n2->getBeat();
                     
                     if (overlapsWith > overlappingBeats)
                     {
                         overlappingBeats = overlapsWith;
-                        overlappingNote = nc2;
+                        overlappingNote = n2;
                     }
                 }
             }
@@ -897,35 +941,32 @@ void MidiRollToolbox::removeOverlaps(MidiEventSelection &selection, bool shouldC
     {
         NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
         
-        for (int j = 0; j < selection.getNumSelected(); ++j)
+        findSelectedOverlaps(layers, selectedNotes, nc->getNote(), overlaps);
+        
+        for (int j = 0; j < overlaps.size(); ++j)
         {
-            if (i == j)
-            {
-                continue;
-            }
-            
-            NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
+            const Note *n2 = overlaps.getUnchecked(j);
             
             // full overlap
-            //const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-            //                                nc->getBeat() >= nc2->getBeat() &&
-            //                                (nc->getBeat() + nc->getLength()) <= (nc2->getBeat() + nc2->getLength()));
+            //const bool isOverlappingNote = (nc->getKey() == n2->getKey() &&
+            //                                nc->getBeat() >= n2->getBeat() &&
+            //                                (nc->getBeat() + nc->getLength()) <= (n2->getBeat() + n2->getLength()));
 
             // partial overlaps also
-            const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-                                            nc->getBeat() >= nc2->getBeat() &&
-                                            nc->getBeat() < (nc2->getBeat() + nc2->getLength()));
+            const bool isOverlappingNote = (nc->getKey() == n2->getKey() &&
+                                            nc->getBeat() >= n2->getBeat() &&
+                                            nc->getBeat() < (n2->getBeat() + n2->getLength()));
             
-            const bool startsFromTheSameBeat = (nc->getKey() == nc2->getKey() &&
-                                                nc->getBeat() == nc2->getBeat());
+            const bool startsFromTheSameBeat = (nc->getKey() == n2->getKey() &&
+                                                nc->getBeat() == n2->getBeat());
             
-            const bool isOriginalNote = unremovableNotes.contains(nc2->getNote().getID());
+            const bool isOriginalNote = unremovableNotes.contains(n2->getID());
             
             if (! isOriginalNote &&
                 (isOverlappingNote || startsFromTheSameBeat))
             {
                 unremovableNotes.set(nc->getNote().getID(), nc->getNote());
-                deferredRemoval.set(nc2->getNote().getID(), nc2->getNote());
+                deferredRemoval.set(n2->getID(), *n2);
             }
         }
     }
@@ -950,34 +991,36 @@ void MidiRollToolbox::removeDuplicates(MidiEventSelection &selection, bool shoul
     
     bool didCheckpoint = false;
 
+    SortedSet<const Note *> selectedNotes;
+    Array<PianoLayer *> layers;
+    Array<Note *> overlaps;
+    collectSelectedNotes(selection, selectedNotes, layers);
+
     for (int i = 0; i < selection.getNumSelected(); ++i)
     {
         NoteComponent *nc = static_cast<NoteComponent *>(selection.getSelectedItem(i));
         
-        for (int j = 0; j < selection.getNumSelected(); ++j)
+        findSelectedOverlaps(layers, selectedNotes, nc->getNote(), overlaps);
+        
+        for (int j = 0; j < overlaps.size(); ++j)
         {
-            if (i == j)
-            {
-                continue;
-            }
-            
-            NoteComponent *nc2 = static_cast<NoteComponent *>(selection.getSelectedItem(j));
+            const Note *n2 = overlaps.getUnchecked(j);
             
             // full overlap
-            const bool isOverlappingNote = (nc->getKey() == nc2->getKey() &&
-                                            nc->getBeat() >= nc2->getBeat() &&
-                                            (nc->getBeat() + nc->getLength()) <= (nc2->getBeat() + nc2->getLength()));
+            const bool isOverlappingNote = (nc->getKey() == n2->getKey() &&
+                                            nc->getBeat() >= n2->getBeat() &&
+                                            (nc->getBeat() + nc->getLength()) <= (n2->getBeat() + n2->getLength()));
 
-            const bool startsFromTheSameBeat = (nc->getKey() == nc2->getKey() &&
-                                                nc->getBeat() == nc2->getBeat());
+            const bool startsFromTheSameBeat = (nc->getKey() == n2->getKey() &&
+                                                nc->getBeat() == n2->getBeat());
             
-            const bool isOriginalNote = unremovableNotes.contains(nc2->getNote().getID());
+            const bool isOriginalNote = unremovableNotes.contains(n2->getID());
 
             if (! isOriginalNote &&
                 (isOverlappingNote || startsFromTheSameBeat))
             {
                 unremovableNotes.set(nc->getNote().getID(), nc->getNote());
-                deferredRemoval.set(nc2->getNote().getID(), nc2->getNote());
+                deferredRemoval.set(n2->getID(), *n2);
             }
         }
     }
@@ -1033,9 +1076,12 @@ void MidiRollToolbox::moveToLayer(MidiEventSelection &selection, MidiLayer *laye
                     
                     bool targetHasTheSameNote = false;
                     
-                    for (int j = 0; j < targetLayer->size(); ++j)
+                    Array<Note *> candidates;
+                    targetLayer->findNotes(n1->getKey(), n1->getBeat() - 0.01f, n1->getBeat() + 0.01f, candidates);
+                    
+                    for (int j = 0; j < candidates.size(); ++j)
                     {
-                        const Note *n2 = static_cast<Note *>(targetLayer->getUnchecked(j));
+                        const Note *n2 = candidates.getUnchecked(j);
                         
                         if (fabs(n1->getBeat() - n2->getBeat()) < 0.01f &&
                             fabs(n1->getLength() - n2->getLength()) < 0.01f &&
@@ -36,7 +36,8 @@
 InstrumentTreeItem::InstrumentTreeItem(Instrument *targetInstrument) :
     TreeItem(""),
     instrument(targetInstrument),
-    instrumentEditor(nullptr)
+    instrumentEditor(nullptr),
+    wasReady(true)
 {
     this->audioCore = &App::Workspace().getAudioCore();
     
@@ -51,6 +52,7 @@ InstrumentTreeItem::~InstrumentTreeItem()
 {
     if (! this->instrument.wasObjectDeleted())
     {
+        this->instrument->removeChangeListener(this);
         this->audioCore->removeInstrument(this->instrument);
     }
 
@@ -61,7 +63,15 @@ InstrumentTreeItem::~InstrumentTreeItem()
 
 Colour InstrumentTreeItem::getColour() const
 {
-    return Colour(0xffff80f3).interpolatedWith(Colour(0xffa489ff), 0.5f);
+    const Colour colour(Colour(0xffff80f3).interpolatedWith(Colour(0xffa489ff), 0.5f));
+
+    // Dimmed until all the plugins are loaded
+    if (! this->instrument.wasObjectDeleted() && ! this->instrument->isReady())
+    {
+        return colour.withMultipliedAlpha(0.5f);
+    }
+
+    return colour;
     //return Colour(0xffd151ff);
 }
 
@@ -256,6 +266,27 @@ void InstrumentTreeItem::deserialize(const XmlElement &xml)
     TreeItemChildrenSerializer::deserializeChildren(*this, xml);
 
     this->updateChildrenEditors();
+
+    // The plugins might still be loading at this point
+    this->wasReady = this->instrument->isReady();
+    this->instrument->addChangeListener(this);
+}
+
+void InstrumentTreeItem::changeListenerCallback(ChangeBroadcaster *source)
+{
+    const bool isReady = this->instrument->isReady();
+
+    if (isReady != this->wasReady)
+    {
+        this->wasReady = isReady;
+
+        if (isReady)
+        {
+            this->updateChildrenEditors();
+        }
+
+        this->repaintItem();
+    }
 }
 
 void InstrumentTreeItem::initInstrumentEditor()
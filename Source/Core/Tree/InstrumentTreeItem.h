@@ -24,7 +24,9 @@ class AudioCore;
 #include "TreeItem.h"
 
 // todo fix dependency on audiocore
-class InstrumentTreeItem : public TreeItem
+class InstrumentTreeItem :
+    public TreeItem,
+    private ChangeListener
 {
 public:
 
@@ -87,6 +89,11 @@ public:
 
 private:
 
+    // Keeps track of the instrument's loading progress
+    void changeListenerCallback(ChangeBroadcaster *source) override;
+
+    bool wasReady;
+
     void initInstrumentEditor();
 
     void removeInstrumentEditor();
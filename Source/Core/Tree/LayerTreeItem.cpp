@@ -289,6 +289,14 @@ void LayerTreeItem::onEventRemovedPostAction(const MidiLayer *layer)
     }
 }
 
+void LayerTreeItem::onChangesBatch(const LayerChangeSet &changes)
+{
+    if (this->lastFoundParent != nullptr)
+    {
+        this->lastFoundParent->broadcastChangesBatch(changes);
+    }
+}
+
 void LayerTreeItem::onLayerChanged(const MidiLayer *layer)
 {
     if (this->lastFoundParent != nullptr)
@@ -77,6 +77,8 @@ public:
 
     void onEventRemovedPostAction(const MidiLayer *layer) override;
 
+    void onChangesBatch(const LayerChangeSet &changes) override;
+
     void onLayerChanged(const MidiLayer *layer) override;
 
     void onBeatRangeChanged() override;
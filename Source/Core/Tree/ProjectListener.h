@@ -17,10 +17,65 @@
 
 #pragma once
 
+#include "LayerChangeSet.h"
+
 class MidiEvent;
 class MidiLayer;
 class ProjectInfo;
 
+// What a listener wants to be notified about, so that the project
+// doesn't bother it with the changes it would ignore anyway.
+// The project info and the beat range changes are sent to everyone.
+class ProjectListenerFilter
+{
+public:
+
+    enum LayerTypes
+    {
+        pianoLayers = 0x1,
+        automationLayers = 0x2,
+        annotationLayers = 0x4,
+        timeSignatureLayers = 0x8,
+        allLayerTypes = 0xf
+    };
+
+    enum EventKinds
+    {
+        eventsAdded = 0x1,
+        eventsChanged = 0x2,
+        eventsRemoved = 0x4,
+        layersChanged = 0x8, // layers added, removed, moved or reloaded
+        allEventKinds = 0xf
+    };
+
+    ProjectListenerFilter() :
+        layerTypes(allLayerTypes),
+        eventKinds(allEventKinds),
+        targetLayer(nullptr) {}
+
+    // If the target layer is set, only that layer's changes are sent
+    ProjectListenerFilter(int layerTypesMask, int eventKindsMask, const MidiLayer *layer = nullptr) :
+        layerTypes(layerTypesMask),
+        eventKinds(eventKindsMask),
+        targetLayer(layer) {}
+
+    int getLayerTypes() const noexcept
+    { return this->layerTypes; }
+
+    int getEventKinds() const noexcept
+    { return this->eventKinds; }
+
+    const MidiLayer *getTargetLayer() const noexcept
+    { return this->targetLayer; }
+
+private:
+
+    int layerTypes;
+    int eventKinds;
+    const MidiLayer *targetLayer;
+
+};
+
 class ProjectListener
 {
 public:
@@ -37,6 +92,10 @@ public:
 
     virtual void onEventRemovedPostAction(const MidiLayer *layer) {} // вызывается после удаления события, надо будет переименовать эти методы по-человечески
 
+    // Group edits come here instead of the per-event methods above;
+    // override it to handle all the events at once
+    virtual void onChangesBatch(const LayerChangeSet &changes) { changes.sendTo(*this); }
+
     virtual void onLayerChanged(const MidiLayer *layer) = 0;
 
     virtual void onLayerAdded(const MidiLayer *layer) = 0;
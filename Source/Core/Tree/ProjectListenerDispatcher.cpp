@@ -0,0 +1,252 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Common.h"
+#include "ProjectListenerDispatcher.h"
+#include "PianoLayer.h"
+#include "AutomationLayer.h"
+#include "AnnotationsLayer.h"
+#include "TimeSignaturesLayer.h"
+
+ProjectListenerDispatcher::ProjectListenerDispatcher() :
+    dispatchDepth(0),
+    tablesAreOutdated(false),
+    numDeliveredNotifications(0),
+    numSkippedNotifications(0) {}
+
+void ProjectListenerDispatcher::addListener(ProjectListener *listener, const ProjectListenerFilter &filter)
+{
+    jassert(listener != nullptr);
+
+    bool alreadySubscribed = false;
+
+    for (auto &subscription : this->subscriptions)
+    {
+        if (subscription.listener == listener)
+        {
+            subscription.filter = filter;
+            alreadySubscribed = true;
+            break;
+        }
+    }
+
+    if (! alreadySubscribed)
+    {
+        Subscription subscription;
+        subscription.listener = listener;
+        subscription.filter = filter;
+        this->subscriptions.add(subscription);
+    }
+
+    if (this->dispatchDepth > 0)
+    {
+        this->listenersRemovedWhileDispatching.removeAllInstancesOf(listener);
+        this->tablesAreOutdated = true;
+        return;
+    }
+
+    this->rebuildTables();
+}
+
+void ProjectListenerDispatcher::removeListener(ProjectListener *listener)
+{
+    for (int i = 0; i < this->subscriptions.size(); ++i)
+    {
+        if (this->subscriptions.getReference(i).listener == listener)
+        {
+            this->subscriptions.remove(i);
+            break;
+        }
+    }
+
+    if (this->dispatchDepth > 0)
+    {
+        this->listenersRemovedWhileDispatching.addIfNotAlreadyThere(listener);
+        this->tablesAreOutdated = true;
+        return;
+    }
+
+    this->rebuildTables();
+}
+
+void ProjectListenerDispatcher::removeAllListeners()
+{
+    if (this->dispatchDepth > 0)
+    {
+        for (const auto &subscription : this->subscriptions)
+        {
+            this->listenersRemovedWhileDispatching.addIfNotAlreadyThere(subscription.listener);
+        }
+
+        this->subscriptions.clear();
+        this->tablesAreOutdated = true;
+        return;
+    }
+
+    this->subscriptions.clear();
+    this->rebuildTables();
+}
+
+
+//===----------------------------------------------------------------------===//
+// Dispatch tables
+//===----------------------------------------------------------------------===//
+
+const Array<ProjectListener *> &ProjectListenerDispatcher::getListeners(const MidiLayer *layer, int eventKinds)
+{
+    const int kindsMask = eventKinds & ProjectListenerFilter::allEventKinds;
+
+    if (layer != nullptr && this->layerTables.contains(layer))
+    {
+        ListenerTable *table = this->layerTables[layer];
+
+        if (table == nullptr)
+        {
+            table = new ListenerTable();
+            this->fillTable(*table, getLayerTypeIndex(layer), layer);
+            this->layerTablesStorage.add(table);
+            this->layerTables.set(layer, table);
+        }
+
+        return table->listeners[kindsMask];
+    }
+
+    return this->typeTables[getLayerTypeIndex(layer)].listeners[kindsMask];
+}
+
+void ProjectListenerDispatcher::fillTable(ListenerTable &table, int layerTypeIndex, const MidiLayer *layer) const
+{
+    const bool isKnownType = (layerTypeIndex < PROJECT_LISTENER_NUM_LAYER_TYPES);
+
+    for (int kindsMask = 0; kindsMask < PROJECT_LISTENER_NUM_EVENT_KINDS_MASKS; ++kindsMask)
+    {
+        Array<ProjectListener *> &listeners = table.listeners[kindsMask];
+        listeners.clearQuick();
+
+        for (const auto &subscription : this->subscriptions)
+        {
+            const ProjectListenerFilter &filter = subscription.filter;
+
+            const bool matchesType = ! isKnownType || (filter.getLayerTypes() & (1 << layerTypeIndex)) != 0;
+            const bool matchesLayer = (filter.getTargetLayer() == nullptr || filter.getTargetLayer() == layer);
+            const bool matchesKinds = (filter.getEventKinds() & kindsMask) != 0;
+
+            if (matchesType && matchesLayer && matchesKinds)
+            {
+                listeners.add(subscription.listener);
+            }
+        }
+    }
+}
+
+void ProjectListenerDispatcher::rebuildTables()
+{
+    jassert(this->dispatchDepth == 0);
+
+    this->allListeners.clearQuick();
+    this->layerTables.clear();
+    this->layerTablesStorage.clear();
+
+    for (const auto &subscription : this->subscriptions)
+    {
+        this->allListeners.add(subscription.listener);
+
+        if (const MidiLayer *targetLayer = subscription.filter.getTargetLayer())
+        {
+            this->layerTables.set(targetLayer, nullptr);
+        }
+    }
+
+    for (int i = 0; i <= PROJECT_LISTENER_NUM_LAYER_TYPES; ++i)
+    {
+        this->fillTable(this->typeTables[i], i, nullptr);
+    }
+
+    this->listenersRemovedWhileDispatching.clearQuick();
+    this->tablesAreOutdated = false;
+}
+
+void ProjectListenerDispatcher::beginDispatch() noexcept
+{
+    ++this->dispatchDepth;
+}
+
+void ProjectListenerDispatcher::endDispatch()
+{
+    jassert(this->dispatchDepth > 0);
+
+    if (--this->dispatchDepth == 0 && this->tablesAreOutdated)
+    {
+        this->rebuildTables();
+    }
+}
+
+int ProjectListenerDispatcher::getLayerTypeIndex(const MidiLayer *layer)
+{
+    if (dynamic_cast<const PianoLayer *>(layer)) { return 0; }
+    if (dynamic_cast<const AutomationLayer *>(layer)) { return 1; }
+    if (dynamic_cast<const AnnotationsLayer *>(layer)) { return 2; }
+    if (dynamic_cast<const TimeSignaturesLayer *>(layer)) { return 3; }
+    return PROJECT_LISTENER_NUM_LAYER_TYPES;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Iterator
+//===----------------------------------------------------------------------===//
+
+ProjectListenerDispatcher::Iterator::Iterator(ProjectListenerDispatcher &owner) :
+    dispatcher(owner),
+    listeners(owner.allListeners),
+    index(owner.allListeners.size())
+{
+    this->dispatcher.beginDispatch();
+}
+
+ProjectListenerDispatcher::Iterator::Iterator(ProjectListenerDispatcher &owner,
+                                              const MidiLayer *layer, int eventKinds) :
+    dispatcher(owner),
+    listeners(owner.getListeners(layer, eventKinds)),
+    index(0)
+{
+    this->index = this->listeners.size();
+    this->dispatcher.numSkippedNotifications += (this->dispatcher.allListeners.size() - this->listeners.size());
+    this->dispatcher.beginDispatch();
+}
+
+ProjectListenerDispatcher::Iterator::~Iterator()
+{
+    this->dispatcher.endDispatch();
+}
+
+ProjectListener *ProjectListenerDispatcher::Iterator::next()
+{
+    const Array<ProjectListener *> &removedListeners = this->dispatcher.listenersRemovedWhileDispatching;
+
+    while (--this->index >= 0)
+    {
+        ProjectListener *listener = this->listeners.getUnchecked(this->index);
+
+        if (removedListeners.size() == 0 || ! removedListeners.contains(listener))
+        {
+            ++this->dispatcher.numDeliveredNotifications;
+            return listener;
+        }
+    }
+
+    return nullptr;
+}
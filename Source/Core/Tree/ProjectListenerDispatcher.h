@@ -0,0 +1,133 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "ProjectListener.h"
+
+// Keeps the project listeners along with their filters, and routes each notification
+// straight to the listeners interested in it, using the tables rebuilt on every
+// subscription change. The tables are only rebuilt when no notification is being sent,
+// the listeners removed meanwhile are skipped, and the ones added meanwhile
+// only get the notifications sent after that.
+
+#define PROJECT_LISTENER_NUM_LAYER_TYPES 4
+#define PROJECT_LISTENER_NUM_EVENT_KINDS_MASKS 16
+
+class ProjectListenerDispatcher
+{
+public:
+
+    ProjectListenerDispatcher();
+
+    // Adding the same listener again only replaces its filter
+    void addListener(ProjectListener *listener, const ProjectListenerFilter &filter);
+
+    void removeListener(ProjectListener *listener);
+
+    void removeAllListeners();
+
+    int64 getNumDeliveredNotifications() const noexcept
+    { return this->numDeliveredNotifications; }
+
+    // The notifications which would have been sent to the filtered out listeners
+    int64 getNumSkippedNotifications() const noexcept
+    { return this->numSkippedNotifications; }
+
+    // Walks the interested listeners from the last added one to the first one,
+    // in the same order as ListenerList does
+    class Iterator
+    {
+    public:
+
+        // Walks all the listeners
+        explicit Iterator(ProjectListenerDispatcher &owner);
+
+        // Walks the listeners of the layer, interested in any of the event kinds
+        Iterator(ProjectListenerDispatcher &owner, const MidiLayer *layer, int eventKinds);
+
+        ~Iterator();
+
+        ProjectListener *next();
+
+    private:
+
+        ProjectListenerDispatcher &dispatcher;
+        const Array<ProjectListener *> &listeners;
+        int index;
+
+        JUCE_DECLARE_NON_COPYABLE(Iterator)
+    };
+
+private:
+
+    struct Subscription
+    {
+        ProjectListener *listener;
+        ProjectListenerFilter filter;
+    };
+
+    // The listeners interested in any of the event kinds, indexed by the kinds mask
+    struct ListenerTable
+    {
+        Array<ProjectListener *> listeners[PROJECT_LISTENER_NUM_EVENT_KINDS_MASKS];
+    };
+
+    struct LayerHashFunction
+    {
+        static int generateHash(const MidiLayer *layer, const int upperLimit) noexcept
+        {
+            return static_cast<int>((reinterpret_cast<pointer_sized_uint>(layer) >> 4) %
+                                    static_cast<pointer_sized_uint>(upperLimit));
+        }
+    };
+
+    const Array<ProjectListener *> &getListeners(const MidiLayer *layer, int eventKinds);
+
+    // The layer is only compared with the filters' targets here, and never dereferenced
+    void fillTable(ListenerTable &table, int layerTypeIndex, const MidiLayer *layer) const;
+
+    void rebuildTables();
+
+    void beginDispatch() noexcept;
+    void endDispatch();
+
+    // Returns PROJECT_LISTENER_NUM_LAYER_TYPES for the layers of unknown types
+    static int getLayerTypeIndex(const MidiLayer *layer);
+
+    Array<Subscription> subscriptions;
+    Array<ProjectListener *> allListeners;
+
+    // For the layers no listener is targeted at, indexed by the layer type,
+    // the last one is for the layers of unknown types
+    ListenerTable typeTables[PROJECT_LISTENER_NUM_LAYER_TYPES + 1];
+
+    // For the layers some listeners are targeted at; the tables are created lazily,
+    // when the layer sends a notification, because the layer needs to be alive
+    // to tell its type, while the listener might outlive it
+    HashMap<const MidiLayer *, ListenerTable *, LayerHashFunction> layerTables;
+    OwnedArray<ListenerTable> layerTablesStorage;
+
+    Array<ProjectListener *> listenersRemovedWhileDispatching;
+    int dispatchDepth;
+    bool tablesAreOutdated;
+
+    int64 numDeliveredNotifications;
+    int64 numSkippedNotifications;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectListenerDispatcher)
+};
@@ -170,6 +170,11 @@ void ProjectTimeline::onEventRemoved(const MidiEvent &event)
     this->project.broadcastEventRemoved(event);
 }
 
+void ProjectTimeline::onChangesBatch(const LayerChangeSet &changes)
+{
+    this->project.broadcastChangesBatch(changes);
+}
+
 void ProjectTimeline::onLayerChanged(const MidiLayer *midiLayer)
 {
     this->project.broadcastLayerChanged(midiLayer);
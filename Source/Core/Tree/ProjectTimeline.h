@@ -73,6 +73,8 @@ public:
     void onEventAdded(const MidiEvent &event) override;
     
     void onEventRemoved(const MidiEvent &event) override;
+
+    void onChangesBatch(const LayerChangeSet &changes) override;
     
     void onLayerChanged(const MidiLayer *layer) override;
     
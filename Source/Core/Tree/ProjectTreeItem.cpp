@@ -41,6 +41,7 @@
 #include "ProjectInfo.h"
 #include "ProjectTimeline.h"
 #include "DataEncoder.h"
+#include "ChunkedProjectFormat.h"
 
 #include "TrackedItem.h"
 #include "VersionControlTreeItem.h"
@@ -52,6 +53,7 @@
 #include "HelioTheme.h"
 #include "ProjectCommandPanel.h"
 #include "UndoStack.h"
+#include "ProjectJournal.h"
 
 #include "Workspace.h"
 #include "App.h"
@@ -79,6 +81,18 @@ void ProjectTreeItem::initialize()
     this->isLayersHashOutdated = true;
     
     this->undoStack = new UndoStack(*this);
+
+    // In megabytes; the history that doesn't fit goes to the journal file
+    const int undoHistoryBudget = Config::get(Serialization::Core::undoHistoryBudget).getIntValue();
+
+    if (undoHistoryBudget > 0)
+    {
+        this->undoStack->setMaxNumberOfStoredBytes(jmin(undoHistoryBudget, 2047) * 1024 * 1024,
+                                                   UNDO_STACK_MIN_TRANSACTIONS);
+    }
+
+    this->journal = new ProjectJournal(*this);
+    this->addListener(this->journal);
     
     this->autosaver = new Autosaver(*this);
 
@@ -101,12 +115,17 @@ void ProjectTreeItem::initialize()
 
 ProjectTreeItem::~ProjectTreeItem()
 {
-    // the main policy: all data is to be autosaved
-    this->getDocument()->save();
-    
+    // Commits the notes being recorded, if any, while the layers are still there
     this->transport->stopPlayback();
     this->transport->stopRender();
 
+    // the main policy: all data is to be autosaved
+    this->getDocument()->save();
+
+    // Might need to finish a background compaction, which uses the undo stack
+    this->removeListener(this->journal);
+    this->journal = nullptr;
+
     // remember as the recent file
     if (this->recentFilesList != nullptr)
     {
@@ -143,6 +162,8 @@ void ProjectTreeItem::deletePermanently()
         File localProjectFile(this->getDocument()->getFullPath());
         App::Workspace().unloadProjectById(this->getId());
         localProjectFile.deleteFile();
+        UndoHistoryFile::getFileFor(localProjectFile).deleteFile();
+        ProjectJournal::getFileFor(localProjectFile).deleteFile();
         
         if (this->recentFilesList != nullptr)
         {
@@ -250,6 +271,13 @@ void ProjectTreeItem::onRename(const String &newName)
     this->setName(newName);
     
     this->getDocument()->renameFile(newName);
+
+    // The journal and the undo history are still next to the old file, and the
+    // journal can't be appended for the new one, so the autosaves would skip the
+    // pending edits; a full save writes them and removes the old side files
+    this->journal->markNeedsFullSave();
+    this->getDocument()->forceSave();
+
     TreeItem::notifySubtreeMoved(this);
 
     // notify recent files list
@@ -629,7 +657,8 @@ XmlElement *ProjectTreeItem::save() const
     // UI state is now stored in config
     //xml->addChildElement(this->editor->serialize());
 
-    xml->addChildElement(this->undoStack->serialize());
+    // Undo history is now stored in a side file, see onDocumentDidSave
+    //xml->addChildElement(this->undoStack->serialize());
     
     TreeItemChildrenSerializer::serializeChildren(*this, *xml);
 
@@ -661,6 +690,8 @@ void ProjectTreeItem::load(const XmlElement &xml)
     // UI state is now stored in config
     //this->editor->deserialize(*root);
     
+    // Only the projects saved by the older versions have it here,
+    // otherwise it is picked up from the side file, see onDocumentDidLoad
     this->undoStack->deserialize(*root);
     
     const float seek = float(root->getDoubleAttribute("seek", 0.f));
@@ -706,21 +737,36 @@ void ProjectTreeItem::importMidi(File &file)
 //===----------------------------------------------------------------------===//
 
 void ProjectTreeItem::addListener(ProjectListener *listener)
+{
+    this->addListener(listener, ProjectListenerFilter());
+}
+
+void ProjectTreeItem::addListener(ProjectListener *listener, const ProjectListenerFilter &filter)
 {
     jassert(MessageManager::getInstance()->currentThreadHasLockedMessageManager());
-    this->changeListeners.add(listener);
+    this->changeListeners.addListener(listener, filter);
 }
 
 void ProjectTreeItem::removeListener(ProjectListener *listener)
 {
     jassert(MessageManager::getInstance()->currentThreadHasLockedMessageManager());
-    this->changeListeners.remove(listener);
+    this->changeListeners.removeListener(listener);
 }
 
 void ProjectTreeItem::removeAllListeners()
 {
     jassert(MessageManager::getInstance()->currentThreadHasLockedMessageManager());
-    this->changeListeners.clear();
+    this->changeListeners.removeAllListeners();
+}
+
+int64 ProjectTreeItem::getNumDeliveredNotifications() const noexcept
+{
+    return this->changeListeners.getNumDeliveredNotifications();
+}
+
+int64 ProjectTreeItem::getNumSkippedNotifications() const noexcept
+{
+    return this->changeListeners.getNumSkippedNotifications();
 }
 
 
@@ -730,32 +776,83 @@ void ProjectTreeItem::removeAllListeners()
 
 void ProjectTreeItem::broadcastEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent)
 {
-    //if (this->changeListeners.size() == 0) { return; }
-    this->changeListeners.call(&ProjectListener::onEventChanged, oldEvent, newEvent);
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          newEvent.getLayer(), ProjectListenerFilter::eventsChanged);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onEventChanged(oldEvent, newEvent);
+    }
+
     this->sendChangeMessage();
 }
 
 void ProjectTreeItem::broadcastEventAdded(const MidiEvent &event)
 {
-    this->changeListeners.call(&ProjectListener::onEventAdded, event);
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          event.getLayer(), ProjectListenerFilter::eventsAdded);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onEventAdded(event);
+    }
+
     this->sendChangeMessage();
 }
 
 void ProjectTreeItem::broadcastEventRemoved(const MidiEvent &event)
 {
-    this->changeListeners.call(&ProjectListener::onEventRemoved, event);
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          event.getLayer(), ProjectListenerFilter::eventsRemoved);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onEventRemoved(event);
+    }
+
     this->sendChangeMessage();
 }
 
 void ProjectTreeItem::broadcastEventRemovedPostAction(const MidiLayer *layer)
 {
-    this->changeListeners.call(&ProjectListener::onEventRemovedPostAction, layer);
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          layer, ProjectListenerFilter::eventsRemoved);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onEventRemovedPostAction(layer);
+    }
+
+    this->sendChangeMessage();
+}
+
+void ProjectTreeItem::broadcastChangesBatch(const LayerChangeSet &changes)
+{
+    int eventKinds = 0;
+    eventKinds |= changes.getAddedEvents().isEmpty() ? 0 : ProjectListenerFilter::eventsAdded;
+    eventKinds |= changes.getChangedEventsBefore().isEmpty() ? 0 : ProjectListenerFilter::eventsChanged;
+    eventKinds |= changes.getRemovedEvents().isEmpty() ? 0 : ProjectListenerFilter::eventsRemoved;
+
+    ProjectListenerDispatcher::Iterator i(this->changeListeners, changes.getLayer(), eventKinds);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onChangesBatch(changes);
+    }
+
     this->sendChangeMessage();
 }
 
 void ProjectTreeItem::broadcastLayerChanged(const MidiLayer *layer)
 {
-    this->changeListeners.call(&ProjectListener::onLayerChanged, layer);
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          layer, ProjectListenerFilter::layersChanged);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onLayerChanged(layer);
+    }
+
     this->sendChangeMessage();
 }
 
@@ -763,7 +860,15 @@ void ProjectTreeItem::broadcastLayerAdded(const MidiLayer *layer)
 {
     this->isLayersHashOutdated = true;
     this->registerVcsItem(layer);
-    this->changeListeners.call(&ProjectListener::onLayerAdded, layer);
+
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          layer, ProjectListenerFilter::layersChanged);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onLayerAdded(layer);
+    }
+
     this->sendChangeMessage();
 }
 
@@ -771,19 +876,40 @@ void ProjectTreeItem::broadcastLayerRemoved(const MidiLayer *layer)
 {
     this->isLayersHashOutdated = true;
     this->unregisterVcsItem(layer);
-    this->changeListeners.call(&ProjectListener::onLayerRemoved, layer);
+
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          layer, ProjectListenerFilter::layersChanged);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onLayerRemoved(layer);
+    }
+
     this->sendChangeMessage();
 }
 
 void ProjectTreeItem::broadcastLayerMoved(const MidiLayer *layer)
 {
-    this->changeListeners.call(&ProjectListener::onLayerMoved, layer);
+    ProjectListenerDispatcher::Iterator i(this->changeListeners,
+                                          layer, ProjectListenerFilter::layersChanged);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onLayerMoved(layer);
+    }
+
     this->sendChangeMessage();
 }
 
 void ProjectTreeItem::broadcastInfoChanged(const ProjectInfo *info)
 {
-    this->changeListeners.call(&ProjectListener::onInfoChanged, info);
+    ProjectListenerDispatcher::Iterator i(this->changeListeners);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onInfoChanged(info);
+    }
+
     this->sendChangeMessage();
 }
 
@@ -799,8 +925,14 @@ void ProjectTreeItem::broadcastBeatRangeChanged()
     // и, если ролл ресайзится, индикатор дергается
     // пусть лучше транспорт обновит индикатор 2 раза, но гарантированно перед остальными
     this->transport->onProjectBeatRangeChanged(firstBeat, lastBeat);
-    
-    this->changeListeners.call(&ProjectListener::onProjectBeatRangeChanged, firstBeat, lastBeat);
+
+    ProjectListenerDispatcher::Iterator i(this->changeListeners);
+
+    while (ProjectListener *listener = i.next())
+    {
+        listener->onProjectBeatRangeChanged(firstBeat, lastBeat);
+    }
+
     this->sendChangeMessage();
 }
 
@@ -811,12 +943,20 @@ void ProjectTreeItem::broadcastBeatRangeChanged()
 
 bool ProjectTreeItem::onDocumentLoad(File &file)
 {
+    if (ChunkedProjectFormat::isChunkedProject(file))
+    {
+        return this->loadChunked(file);
+    }
+
+    // Saved by the older versions, will be converted on the next full save
     if (file.existsAsFile())
     {
         ScopedPointer<XmlElement> xml(DataEncoder::loadObfuscated(file));
 
         if (xml)
         {
+            // The changes saved since the last full save
+            this->journal->replay(file, *xml);
             this->load(*xml);
             return true;
         }
@@ -825,8 +965,63 @@ bool ProjectTreeItem::onDocumentLoad(File &file)
     return false;
 }
 
+bool ProjectTreeItem::loadChunked(const File &file)
+{
+    ChunkedProjectFormat::Reader reader(file);
+
+    // Better not to touch the project at all, than to load it halfway
+    if (! reader.verify())
+    {
+        return false;
+    }
+
+    ScopedPointer<XmlElement> xml(reader.readProject());
+
+    if (xml == nullptr)
+    {
+        return false;
+    }
+
+    const String snapshotId(xml->getStringAttribute(PROJECT_JOURNAL_SNAPSHOT_ATTRIBUTE));
+    this->journal->beginReplay(file, snapshotId);
+
+    // The layers are created empty here, and then filled in one by one,
+    // so that only one layer's xml is there at a time
+    this->load(*xml);
+    xml = nullptr;
+
+    for (int i = 0; i < reader.getNumChunks(); ++i)
+    {
+        if (reader.getChunkType(i) != ChunkedProjectFormat::layerChunk)
+        {
+            continue;
+        }
+
+        ScopedPointer<XmlElement> layerXml(reader.readChunk(i));
+
+        if (layerXml == nullptr)
+        {
+            continue;
+        }
+
+        this->journal->replayLayer(*layerXml);
+
+        if (MidiLayer *layer = this->getLayerWithId<MidiLayer>(layerXml->getStringAttribute("id")))
+        {
+            layer->deserialize(*layerXml);
+        }
+    }
+
+    this->journal->endReplay();
+    this->broadcastBeatRangeChanged();
+    return true;
+}
+
 void ProjectTreeItem::onDocumentDidLoad(File &file)
 {
+    this->journal->onProjectDidLoad();
+    this->undoStack->onProjectDidLoad(file);
+
     if (this->recentFilesList != nullptr)
     {
         this->recentFilesList->
@@ -839,8 +1034,40 @@ void ProjectTreeItem::onDocumentDidLoad(File &file)
 
 bool ProjectTreeItem::onDocumentSave(File &file)
 {
+    // Most of the autosaves only have a few events edited,
+    // so there's no need to re-encode the whole project
+    if (this->journal->canAppend(file) && this->journal->append())
+    {
+        if (this->journal->needsCompaction())
+        {
+            this->journal->startCompaction(this->save());
+        }
+        else
+        {
+            this->savePageState();
+        }
+
+        return true;
+    }
+
+    this->undoStack->onProjectWillSave();
+
+    const String snapshotId(Uuid().toString());
     ScopedPointer<XmlElement> xml(this->save());
-    return DataEncoder::saveObfuscated(file, xml);
+    xml->setAttribute(PROJECT_JOURNAL_SNAPSHOT_ATTRIBUTE, snapshotId);
+
+    if (ChunkedProjectFormat::save(file, *xml))
+    {
+        this->journal->onFullSave(file, snapshotId);
+        return true;
+    }
+
+    return false;
+}
+
+void ProjectTreeItem::onDocumentDidSave(File &file)
+{
+    this->undoStack->onProjectDidSave(file);
 }
 
 void ProjectTreeItem::onDocumentImport(File &file)
@@ -946,6 +1173,7 @@ void ProjectTreeItem::changeListenerCallback(ChangeBroadcaster *source)
     if (VersionControl *vcs = dynamic_cast<VersionControl *>(source))
     {
         //Logger::writeToLog("ProjectTreeItem :: vcs changed, saving " + vcs->getParentName());
+        this->journal->markNeedsFullSave();
         DocumentOwner::sendChangeMessage();
         //this->getDocument()->save();
         
@@ -36,6 +36,7 @@ class ProjectInfo;
 class ProjectTimeline;
 class MidiRollCommandPanel;
 class UndoStack;
+class ProjectJournal;
 class RecentFilesList;
 
 #include "TreeItem.h"
@@ -45,6 +46,7 @@ class RecentFilesList;
 #include "ProjectSequencesWrapper.h"
 #include "MidiRollEditMode.h"
 #include "MidiLayer.h"
+#include "ProjectListenerDispatcher.h"
 
 // todo depends on AudioCore
 class ProjectTreeItem :
@@ -201,10 +203,17 @@ public:
 
     void addListener(ProjectListener *listener);
 
+    // Adding the same listener again only replaces its filter
+    void addListener(ProjectListener *listener, const ProjectListenerFilter &filter);
+
     void removeListener(ProjectListener *listener);
 
     void removeAllListeners();
 
+    int64 getNumDeliveredNotifications() const noexcept;
+
+    int64 getNumSkippedNotifications() const noexcept;
+
 
     //===------------------------------------------------------------------===//
     // Broadcaster
@@ -218,6 +227,8 @@ public:
 
     void broadcastEventRemovedPostAction(const MidiLayer *layer);
 
+    void broadcastChangesBatch(const LayerChangeSet &changes);
+
     void broadcastLayerChanged(const MidiLayer *layer);
 
     void broadcastLayerAdded(const MidiLayer *layer);
@@ -267,6 +278,8 @@ protected:
 
     bool onDocumentSave(File &file) override;
 
+    void onDocumentDidSave(File &file) override;
+
     void onDocumentImport(File &file) override;
 
     bool onDocumentExport(File &file) override;
@@ -289,7 +302,7 @@ private:
 
     MidiRollEditMode rollEditMode;
 
-    ListenerList<ProjectListener> changeListeners;
+    ProjectListenerDispatcher changeListeners;
 
     ScopedPointer<ProjectPage> projectSettings;
 
@@ -304,6 +317,7 @@ private:
     void initialize();
     XmlElement *save() const;
     void load(const XmlElement &xml);
+    bool loadChunked(const File &file);
 
 private:
 
@@ -317,6 +331,9 @@ private:
 
     ScopedPointer<UndoStack> undoStack;
 
+    // Lets the autosaves only append the edited events, see onDocumentSave
+    ScopedPointer<ProjectJournal> journal;
+
     bool isLayersHashOutdated;
     HashMap<String, WeakReference<MidiLayer> > layersHash;
 
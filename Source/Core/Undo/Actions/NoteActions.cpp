@@ -518,3 +518,358 @@ void NotesGroupChangeAction::reset()
     this->notesAfter.clear();
     this->layerId.clear();
 }
+
+
+//===----------------------------------------------------------------------===//
+// Transform Group
+//===----------------------------------------------------------------------===//
+
+bool NotesGroupTransformAction::Delta::setDeltas(const Array<int64> &deltas)
+{
+    this->common = deltas.isEmpty() ? 0 : deltas.getFirst();
+    this->perNote.clear();
+
+    bool allTheSame = true;
+
+    for (auto delta : deltas)
+    {
+        if (delta != this->common)
+        {
+            allTheSame = false;
+            break;
+        }
+    }
+
+    if (allTheSame)
+    {
+        return true;
+    }
+
+    this->common = 0;
+    this->perNote.ensureStorageAllocated(deltas.size());
+
+    for (auto delta : deltas)
+    {
+        if (delta < std::numeric_limits<int>::min() ||
+            delta > std::numeric_limits<int>::max())
+        {
+            return false;
+        }
+
+        this->perNote.add(int(delta));
+    }
+
+    return true;
+}
+
+bool NotesGroupTransformAction::Delta::add(const Delta &other, int numNotes)
+{
+    if (this->perNote.isEmpty() && other.perNote.isEmpty())
+    {
+        this->common += other.common;
+        return true;
+    }
+
+    Array<int64> deltas;
+    deltas.ensureStorageAllocated(numNotes);
+
+    for (int i = 0; i < numNotes; ++i)
+    {
+        deltas.add(this->get(i) + other.get(i));
+    }
+
+    return this->setDeltas(deltas);
+}
+
+bool NotesGroupTransformAction::Delta::isValidFor(int numNotes) const noexcept
+{
+    return this->perNote.isEmpty() || this->perNote.size() == numNotes;
+}
+
+String NotesGroupTransformAction::Delta::toString() const
+{
+    if (this->perNote.isEmpty())
+    {
+        return String(this->common);
+    }
+
+    MemoryOutputStream out;
+
+    for (int i = 0; i < this->perNote.size(); ++i)
+    {
+        if (i > 0) { out << " "; }
+        out << this->perNote.getUnchecked(i);
+    }
+
+    return out.toString();
+}
+
+void NotesGroupTransformAction::Delta::fromString(const String &text)
+{
+    const StringArray tokens(StringArray::fromTokens(text, " ", ""));
+
+    this->common = 0;
+    this->perNote.clear();
+
+    // The per-note deltas are only stored when they differ,
+    // so there are always at least two of them
+    if (tokens.size() == 1)
+    {
+        this->common = tokens[0].getLargeIntValue();
+        return;
+    }
+
+    this->perNote.ensureStorageAllocated(tokens.size());
+
+    for (const auto &token : tokens)
+    {
+        this->perNote.add(token.getIntValue());
+    }
+}
+
+NotesGroupTransformAction *NotesGroupTransformAction::createIfCompact(ProjectTreeItem &parentProject,
+                                                                      const String &targetLayerId,
+                                                                      const Array<Note> &state1,
+                                                                      const Array<Note> &state2)
+{
+    if (state1.isEmpty() || state1.size() != state2.size())
+    {
+        return nullptr;
+    }
+
+    const int numNotes = state1.size();
+    ScopedPointer<NotesGroupTransformAction> action(new NotesGroupTransformAction(parentProject));
+    action->layerId = targetLayerId;
+    action->ids.ensureStorageAllocated(numNotes);
+
+    Array<int64> deltaTicks, deltaKeys, deltaLengths;
+    deltaTicks.ensureStorageAllocated(numNotes);
+    deltaKeys.ensureStorageAllocated(numNotes);
+    deltaLengths.ensureStorageAllocated(numNotes);
+
+    bool velocitiesChanged = false;
+
+    for (int i = 0; i < numNotes; ++i)
+    {
+        const Note &before = state1.getUnchecked(i);
+        const Note &after = state2.getUnchecked(i);
+
+        if (before.getID() != after.getID())
+        {
+            return nullptr;
+        }
+
+        action->ids.add(before.getID());
+        deltaTicks.add(after.getTick() - before.getTick());
+        deltaKeys.add(after.getKey() - before.getKey());
+        deltaLengths.add(after.getLengthInTicks() - before.getLengthInTicks());
+        velocitiesChanged = velocitiesChanged || (after.getVelocity() != before.getVelocity());
+    }
+
+    if (! action->ticks.setDeltas(deltaTicks) ||
+        ! action->keys.setDeltas(deltaKeys) ||
+        ! action->lengths.setDeltas(deltaLengths))
+    {
+        return nullptr;
+    }
+
+    if (velocitiesChanged)
+    {
+        action->velocitiesBefore.ensureStorageAllocated(numNotes);
+        action->velocitiesAfter.ensureStorageAllocated(numNotes);
+
+        for (int i = 0; i < numNotes; ++i)
+        {
+            action->velocitiesBefore.add(state1.getUnchecked(i).getVelocity());
+            action->velocitiesAfter.add(state2.getUnchecked(i).getVelocity());
+        }
+    }
+
+    return action.release();
+}
+
+bool NotesGroupTransformAction::apply(bool forward)
+{
+    PianoLayer *layer = this->project.getLayerWithId<PianoLayer>(this->layerId);
+
+    const int numNotes = this->ids.size();
+
+    // A damaged record fails rather than gets applied to the wrong notes
+    if (layer == nullptr ||
+        ! this->ticks.isValidFor(numNotes) ||
+        ! this->keys.isValidFor(numNotes) ||
+        ! this->lengths.isValidFor(numNotes) ||
+        this->velocitiesBefore.size() != this->velocitiesAfter.size() ||
+        (! this->velocitiesBefore.isEmpty() && this->velocitiesBefore.size() != numNotes))
+    {
+        return false;
+    }
+
+    const int64 sign = forward ? 1 : -1;
+    const bool hasVelocities = ! this->velocitiesBefore.isEmpty();
+    const Array<float> &targetVelocities = forward ? this->velocitiesAfter : this->velocitiesBefore;
+
+    Array<Note> groupBefore, groupAfter;
+    groupBefore.ensureStorageAllocated(this->ids.size());
+    groupAfter.ensureStorageAllocated(this->ids.size());
+
+    for (int i = 0; i < this->ids.size(); ++i)
+    {
+        const Note *note = layer->findNoteById(this->ids.getUnchecked(i));
+
+        if (note == nullptr)
+        {
+            return false;
+        }
+
+        groupBefore.add(*note);
+        groupAfter.add(note->withExactParameters(note->getTick() + sign * this->ticks.get(i),
+                                                 note->getKey() + int(sign * this->keys.get(i)),
+                                                 note->getLengthInTicks() + sign * this->lengths.get(i),
+                                                 hasVelocities ? targetVelocities.getUnchecked(i) : note->getVelocity()));
+    }
+
+    return layer->changeGroup(groupBefore, groupAfter, false);
+}
+
+bool NotesGroupTransformAction::perform()
+{
+    return this->apply(true);
+}
+
+bool NotesGroupTransformAction::undo()
+{
+    return this->apply(false);
+}
+
+int NotesGroupTransformAction::getSizeInUnits()
+{
+    return int(sizeof(MidiEvent::Id) * this->ids.size()) +
+           int(sizeof(int) * (this->ticks.perNote.size() + this->keys.perNote.size() + this->lengths.perNote.size())) +
+           int(sizeof(float) * (this->velocitiesBefore.size() + this->velocitiesAfter.size()));
+}
+
+UndoAction *NotesGroupTransformAction::createCoalescedAction(UndoAction *nextAction)
+{
+    if (NotesGroupTransformAction *nextTransform = dynamic_cast<NotesGroupTransformAction *>(nextAction))
+    {
+        if (nextTransform->layerId != this->layerId ||
+            nextTransform->ids != this->ids)
+        {
+            return nullptr;
+        }
+
+        const int numNotes = this->ids.size();
+        ScopedPointer<NotesGroupTransformAction> coalesced(new NotesGroupTransformAction(this->project));
+        coalesced->layerId = this->layerId;
+        coalesced->ids = this->ids;
+        coalesced->ticks = this->ticks;
+        coalesced->keys = this->keys;
+        coalesced->lengths = this->lengths;
+
+        if (! coalesced->ticks.add(nextTransform->ticks, numNotes) ||
+            ! coalesced->keys.add(nextTransform->keys, numNotes) ||
+            ! coalesced->lengths.add(nextTransform->lengths, numNotes))
+        {
+            return nullptr;
+        }
+
+        const bool hadVelocities = ! this->velocitiesBefore.isEmpty();
+        const bool nextHasVelocities = ! nextTransform->velocitiesBefore.isEmpty();
+        coalesced->velocitiesBefore = hadVelocities ? this->velocitiesBefore : nextTransform->velocitiesBefore;
+        coalesced->velocitiesAfter = nextHasVelocities ? nextTransform->velocitiesAfter : this->velocitiesAfter;
+
+        return coalesced.release();
+    }
+
+    return nullptr;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Serializable
+//===----------------------------------------------------------------------===//
+
+static String velocitiesToString(const Array<float> &velocities)
+{
+    MemoryOutputStream out;
+
+    for (int i = 0; i < velocities.size(); ++i)
+    {
+        if (i > 0) { out << " "; }
+        out << String(velocities.getUnchecked(i));
+    }
+
+    return out.toString();
+}
+
+static void velocitiesFromString(const String &text, Array<float> &result)
+{
+    const StringArray tokens(StringArray::fromTokens(text, " ", ""));
+    result.ensureStorageAllocated(tokens.size());
+
+    for (const auto &token : tokens)
+    {
+        result.add(token.getFloatValue());
+    }
+}
+
+XmlElement *NotesGroupTransformAction::serialize() const
+{
+    auto xml = new XmlElement(Serialization::Undo::notesGroupTransformAction);
+    xml->setAttribute(Serialization::Undo::layerId, this->layerId);
+
+    MemoryOutputStream idsText;
+
+    for (int i = 0; i < this->ids.size(); ++i)
+    {
+        if (i > 0) { idsText << " "; }
+        idsText << MidiEvent::idToString(this->ids.getUnchecked(i));
+    }
+
+    xml->setAttribute(Serialization::Undo::ids, idsText.toString());
+    xml->setAttribute(Serialization::Undo::deltaTicks, this->ticks.toString());
+    xml->setAttribute(Serialization::Undo::deltaKeys, this->keys.toString());
+    xml->setAttribute(Serialization::Undo::deltaLengths, this->lengths.toString());
+
+    if (! this->velocitiesBefore.isEmpty())
+    {
+        xml->setAttribute(Serialization::Undo::velocitiesBefore, velocitiesToString(this->velocitiesBefore));
+        xml->setAttribute(Serialization::Undo::velocitiesAfter, velocitiesToString(this->velocitiesAfter));
+    }
+
+    return xml;
+}
+
+void NotesGroupTransformAction::deserialize(const XmlElement &xml)
+{
+    this->reset();
+
+    this->layerId = xml.getStringAttribute(Serialization::Undo::layerId);
+
+    const StringArray idTokens(StringArray::fromTokens(xml.getStringAttribute(Serialization::Undo::ids), " ", ""));
+    this->ids.ensureStorageAllocated(idTokens.size());
+
+    for (const auto &id : idTokens)
+    {
+        this->ids.add(MidiEvent::idFromString(id));
+    }
+
+    this->ticks.fromString(xml.getStringAttribute(Serialization::Undo::deltaTicks));
+    this->keys.fromString(xml.getStringAttribute(Serialization::Undo::deltaKeys));
+    this->lengths.fromString(xml.getStringAttribute(Serialization::Undo::deltaLengths));
+
+    velocitiesFromString(xml.getStringAttribute(Serialization::Undo::velocitiesBefore), this->velocitiesBefore);
+    velocitiesFromString(xml.getStringAttribute(Serialization::Undo::velocitiesAfter), this->velocitiesAfter);
+}
+
+void NotesGroupTransformAction::reset()
+{
+    this->ids.clear();
+    this->ticks = Delta();
+    this->keys = Delta();
+    this->lengths = Delta();
+    this->velocitiesBefore.clear();
+    this->velocitiesAfter.clear();
+    this->layerId.clear();
+}
@@ -226,3 +226,78 @@ private:
     JUCE_DECLARE_NON_COPYABLE(NotesGroupChangeAction)
 
 };
+
+
+//===----------------------------------------------------------------------===//
+// Transform Group
+//===----------------------------------------------------------------------===//
+
+// A compact replacement for the group change, for the bulk edits like
+// shifting, transposing, quantizing or changing the volume: instead of two copies
+// of each note, it only keeps the ids and the parameter deltas
+// (one for the whole group, if they are the same), and the velocities, if changed.
+// The notes themselves are taken from the layer when performing or undoing.
+
+class NotesGroupTransformAction : public UndoAction
+{
+public:
+
+    explicit NotesGroupTransformAction(ProjectTreeItem &project) :
+    UndoAction(project) {}
+
+    // Returns nullptr, if the change cannot be described with the deltas
+    static NotesGroupTransformAction *createIfCompact(ProjectTreeItem &project,
+                                                      const String &layerId,
+                                                      const Array<Note> &state1,
+                                                      const Array<Note> &state2);
+
+    bool perform() override;
+    bool undo() override;
+    int getSizeInUnits() override;
+    UndoAction *createCoalescedAction(UndoAction *nextAction) override;
+
+    XmlElement *serialize() const override;
+    void deserialize(const XmlElement &xml) override;
+    void reset() override;
+
+private:
+
+    // One of the note parameters, changed either by the same amount for the whole group,
+    // or by a different amount for each note (the per-note deltas are stored as ints)
+    struct Delta
+    {
+        Delta() : common(0) {}
+
+        int64 get(int index) const noexcept
+        {
+            return this->perNote.isEmpty() ? this->common : int64(this->perNote.getUnchecked(index));
+        }
+
+        bool setDeltas(const Array<int64> &deltas);
+        bool add(const Delta &other, int numNotes);
+        bool isValidFor(int numNotes) const noexcept;
+
+        String toString() const;
+        void fromString(const String &text);
+
+        int64 common;
+        Array<int> perNote;
+    };
+
+    bool apply(bool forward);
+
+    String layerId;
+
+    Array<MidiEvent::Id> ids;
+
+    Delta ticks;
+    Delta keys;
+    Delta lengths;
+
+    // Both are empty, if none of the velocities has changed
+    Array<float> velocitiesBefore;
+    Array<float> velocitiesAfter;
+
+    JUCE_DECLARE_NON_COPYABLE(NotesGroupTransformAction)
+
+};
@@ -33,6 +33,8 @@ public:
 
     virtual bool undo() = 0;
 
+    // A rough estimate of the memory taken, in bytes;
+    // the undo stack keeps its history within a byte budget
     virtual int getSizeInUnits()
     {
         return 10;
@@ -0,0 +1,418 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Common.h"
+#include "UndoHistoryFile.h"
+
+#define UNDO_HISTORY_RECORD_MAGIC 0x31525548 // "HUR1"
+
+// Magic, type, payload size and checksum
+#define UNDO_HISTORY_HEADER_SIZE (4 + 1 + 4 + 8)
+
+// The file is only rewritten once it's that big, and more than a half of it is garbage
+#define UNDO_HISTORY_COMPACTION_THRESHOLD (4 * 1024 * 1024)
+
+// FNV-1a, as the records are small and this is only needed to spot the damaged ones
+static int64 getChecksum(const void *data, size_t size) noexcept
+{
+    uint64 hash = 14695981039346656037ULL;
+    const uint8 *bytes = static_cast<const uint8 *>(data);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return int64(hash);
+}
+
+static int64 getTotalSize(const Array<UndoHistoryFile::Record> &records) noexcept
+{
+    int64 result = 0;
+
+    for (const auto &record : records)
+    {
+        result += UNDO_HISTORY_HEADER_SIZE + record.size;
+    }
+
+    return result;
+}
+
+UndoHistoryFile::UndoHistoryFile() : size(0), liveSize(0), generation(0) {}
+
+File UndoHistoryFile::getFileFor(const File &projectFile)
+{
+    return projectFile.getSiblingFile(projectFile.getFileName() + ".undo");
+}
+
+void UndoHistoryFile::setFile(const File &newFile, bool keepExisting)
+{
+    this->file = newFile;
+    this->size = 0;
+    this->liveSize = 0;
+    ++this->generation;
+
+    if (! keepExisting)
+    {
+        this->remove();
+    }
+}
+
+bool UndoHistoryFile::exists() const
+{
+    return this->file.existsAsFile() && this->file.getSize() > 0;
+}
+
+
+//===----------------------------------------------------------------------===//
+// Reading
+//===----------------------------------------------------------------------===//
+
+bool UndoHistoryFile::readState(const String &projectId, const File &projectFile,
+                                Array<Record> &transactions, StringArray &names)
+{
+    MemoryBlock lastState;
+    SortedSet<int64> transactionOffsets;
+    int64 validSize = 0;
+    int64 fileSize = 0;
+
+    {
+        FileInputStream in(this->file);
+
+        if (in.failedToOpen())
+        {
+            this->remove();
+            return false;
+        }
+
+        fileSize = in.getTotalLength();
+
+        while (validSize + UNDO_HISTORY_HEADER_SIZE <= fileSize && in.setPosition(validSize))
+        {
+            const int magic = in.readInt();
+            const int type = uint8(in.readByte());
+            const int payloadSize = in.readInt();
+            const int64 checksum = in.readInt64();
+
+            if (magic != UNDO_HISTORY_RECORD_MAGIC || payloadSize <= 0 ||
+                validSize + UNDO_HISTORY_HEADER_SIZE + payloadSize > fileSize)
+            {
+                break;
+            }
+
+            if (type == stateRecord)
+            {
+                MemoryBlock state;
+
+                if (in.readIntoMemoryBlock(state, payloadSize) != size_t(payloadSize) ||
+                    getChecksum(state.getData(), state.getSize()) != checksum)
+                {
+                    break;
+                }
+
+                lastState.swapWith(state);
+            }
+            else if (type == transactionRecord)
+            {
+                // Checked when read, which might never happen
+                transactionOffsets.add(validSize);
+            }
+            else
+            {
+                break;
+            }
+
+            validSize += UNDO_HISTORY_HEADER_SIZE + payloadSize;
+        }
+    }
+
+    // Most likely, the app has crashed while saving
+    if (validSize < fileSize)
+    {
+        Logger::writeToLog("UndoHistoryFile: cutting off a damaged tail of " + this->file.getFileName());
+        FileOutputStream out(this->file);
+        out.setPosition(validSize);
+        out.truncate();
+    }
+
+    this->size = validSize;
+
+    if (lastState.getSize() == 0)
+    {
+        this->remove();
+        return false;
+    }
+
+    MemoryInputStream state(lastState, false);
+    const String stateProjectId(state.readString());
+    const int64 stateProjectSize = state.readInt64();
+    const int64 stateProjectTime = state.readInt64();
+    const int numTransactions = state.readInt();
+
+    // The project has been changed elsewhere since the history was saved,
+    // or the file is not from this project at all
+    if (stateProjectId != projectId ||
+        stateProjectSize != projectFile.getSize() ||
+        stateProjectTime != projectFile.getLastModificationTime().toMilliseconds() ||
+        numTransactions < 0)
+    {
+        Logger::writeToLog("UndoHistoryFile: " + this->file.getFileName() + " doesn't match the project");
+        this->remove();
+        return false;
+    }
+
+    transactions.clearQuick();
+    names.clearQuick();
+
+    for (int i = 0; i < numTransactions; ++i)
+    {
+        Record record;
+        record.offset = state.readInt64();
+        record.size = state.readInt();
+        const String name(state.readString());
+
+        if (record.size <= 0 || ! transactionOffsets.contains(record.offset))
+        {
+            this->remove();
+            return false;
+        }
+
+        transactions.add(record);
+        names.add(name);
+    }
+
+    this->liveSize = getTotalSize(transactions);
+    return true;
+}
+
+XmlElement *UndoHistoryFile::readTransaction(const Record &record) const
+{
+    if (! record.isValid() ||
+        record.offset + UNDO_HISTORY_HEADER_SIZE + record.size > this->size)
+    {
+        return nullptr;
+    }
+
+    FileInputStream in(this->file);
+
+    if (in.failedToOpen() || ! in.setPosition(record.offset))
+    {
+        return nullptr;
+    }
+
+    const int magic = in.readInt();
+    const int type = uint8(in.readByte());
+    const int payloadSize = in.readInt();
+    const int64 checksum = in.readInt64();
+
+    MemoryBlock payload;
+
+    if (magic != UNDO_HISTORY_RECORD_MAGIC ||
+        type != transactionRecord ||
+        payloadSize != record.size ||
+        in.readIntoMemoryBlock(payload, payloadSize) != size_t(payloadSize) ||
+        getChecksum(payload.getData(), payload.getSize()) != checksum)
+    {
+        return nullptr;
+    }
+
+    MemoryInputStream compressedStream(payload, false);
+    GZIPDecompressorInputStream gzip(compressedStream);
+    return XmlDocument::parse(gzip.readEntireStreamAsString());
+}
+
+
+//===----------------------------------------------------------------------===//
+// Writing
+//===----------------------------------------------------------------------===//
+
+bool UndoHistoryFile::appendRecord(OutputStream &out, RecordType type, const MemoryBlock &payload)
+{
+    const bool writtenOk =
+        out.writeInt(UNDO_HISTORY_RECORD_MAGIC) &&
+        out.writeByte(char(type)) &&
+        out.writeInt(int(payload.getSize())) &&
+        out.writeInt64(getChecksum(payload.getData(), payload.getSize())) &&
+        out.write(payload.getData(), payload.getSize());
+
+    return writtenOk;
+}
+
+UndoHistoryFile::Record UndoHistoryFile::writeTransaction(const XmlElement &transaction)
+{
+    Record record;
+    MemoryOutputStream compressed;
+
+    {
+        GZIPCompressorOutputStream gzip(&compressed, 9, false);
+        transaction.writeToStream(gzip, StringRef(), true, false);
+    }
+
+    const MemoryBlock payload(compressed.getData(), compressed.getDataSize());
+
+    FileOutputStream out(this->file);
+
+    if (out.failedToOpen())
+    {
+        return record;
+    }
+
+    // Whatever was there after the last good record is overwritten
+    out.setPosition(this->size);
+    out.truncate();
+
+    if (! this->appendRecord(out, transactionRecord, payload))
+    {
+        return record;
+    }
+
+    out.flush();
+
+    record.offset = this->size;
+    record.size = int(payload.getSize());
+    this->size += UNDO_HISTORY_HEADER_SIZE + record.size;
+    this->liveSize += UNDO_HISTORY_HEADER_SIZE + record.size;
+    return record;
+}
+
+static MemoryBlock createState(const String &projectId, const File &projectFile,
+                               const Array<UndoHistoryFile::Record> &transactions,
+                               const StringArray &names)
+{
+    MemoryOutputStream state;
+    state.writeString(projectId);
+    state.writeInt64(projectFile.getSize());
+    state.writeInt64(projectFile.getLastModificationTime().toMilliseconds());
+    state.writeInt(transactions.size());
+
+    for (int i = 0; i < transactions.size(); ++i)
+    {
+        state.writeInt64(transactions.getUnchecked(i).offset);
+        state.writeInt(transactions.getUnchecked(i).size);
+        state.writeString(names[i]);
+    }
+
+    return MemoryBlock(state.getData(), state.getDataSize());
+}
+
+bool UndoHistoryFile::writeState(const String &projectId, const File &projectFile,
+                                 Array<Record> &transactions, const StringArray &names)
+{
+    jassert(transactions.size() == names.size());
+    this->liveSize = getTotalSize(transactions);
+
+    if (this->size > UNDO_HISTORY_COMPACTION_THRESHOLD &&
+        this->liveSize * 2 < this->size)
+    {
+        Array<Record> compactedTransactions(transactions);
+
+        if (this->compact(compactedTransactions))
+        {
+            // The state is written to the new file right after the transactions,
+            // so there's no moment when the file has no valid state
+            const MemoryBlock state(createState(projectId, projectFile, compactedTransactions, names));
+            FileOutputStream out(this->file);
+
+            if (! out.failedToOpen() && this->appendRecord(out, stateRecord, state))
+            {
+                out.flush();
+                this->size += UNDO_HISTORY_HEADER_SIZE + int64(state.getSize());
+                transactions.swapWith(compactedTransactions);
+                return true;
+            }
+
+            return false;
+        }
+    }
+
+    const MemoryBlock state(createState(projectId, projectFile, transactions, names));
+    FileOutputStream out(this->file);
+
+    if (out.failedToOpen())
+    {
+        return false;
+    }
+
+    out.setPosition(this->size);
+    out.truncate();
+
+    if (! this->appendRecord(out, stateRecord, state))
+    {
+        return false;
+    }
+
+    out.flush();
+    this->size += UNDO_HISTORY_HEADER_SIZE + int64(state.getSize());
+    return true;
+}
+
+bool UndoHistoryFile::compact(Array<Record> &transactions)
+{
+    TemporaryFile temp(this->file);
+    int64 newSize = 0;
+
+    {
+        FileInputStream in(this->file);
+        FileOutputStream out(temp.getFile());
+
+        if (in.failedToOpen() || out.failedToOpen())
+        {
+            return false;
+        }
+
+        for (auto &record : transactions)
+        {
+            const int recordSize = UNDO_HISTORY_HEADER_SIZE + record.size;
+
+            if (! in.setPosition(record.offset) ||
+                out.writeFromInputStream(in, recordSize) != recordSize)
+            {
+                return false;
+            }
+
+            record.offset = newSize;
+            newSize += recordSize;
+        }
+
+        out.flush();
+    }
+
+    if (! temp.overwriteTargetFileWithTemporary())
+    {
+        return false;
+    }
+
+    this->size = newSize;
+    this->liveSize = newSize;
+    ++this->generation;
+    return true;
+}
+
+void UndoHistoryFile::remove()
+{
+    if (this->file != File())
+    {
+        this->file.deleteFile();
+    }
+
+    ++this->generation;
+
+    this->size = 0;
+    this->liveSize = 0;
+}
@@ -0,0 +1,98 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+#include "UndoJournal.h"
+
+// The undo history of a project, kept in a side file next to it,
+// so that saving the project doesn't re-encode the history every time,
+// and loading it doesn't parse the history until someone wants to undo.
+//
+// The file is append-only: each save appends the transactions that are
+// not there yet, and then a state record, which lists the transactions
+// of the history in order, along with the project file's id, size and
+// modification time at the moment of saving. Each record has a checksum.
+// On load, the last good state record is used; a torn tail is cut off,
+// and a file that doesn't match the project is thrown away.
+// Once most of the file is garbage, it is rewritten with the live records only.
+
+class UndoHistoryFile
+{
+public:
+
+    using Record = UndoJournal::Record;
+
+    UndoHistoryFile();
+
+    static File getFileFor(const File &projectFile);
+
+    const File &getFile() const noexcept
+    { return this->file; }
+
+    // Forgets any previous file; unless keepExisting is set,
+    // whatever is in the new one is removed as well
+    void setFile(const File &newFile, bool keepExisting);
+
+    bool exists() const;
+
+    // Changes whenever the records written so far become invalid,
+    // i.e. when the file is replaced or compacted
+    int getGeneration() const noexcept
+    { return this->generation; }
+
+    // Finds the last good state, and checks it against the project;
+    // if there's no such state, the file is removed and false is returned
+    bool readState(const String &projectId, const File &projectFile,
+                   Array<Record> &transactions, StringArray &names);
+
+    Record writeTransaction(const XmlElement &transaction);
+
+    // May compact the file, in which case the records are updated
+    bool writeState(const String &projectId, const File &projectFile,
+                    Array<Record> &transactions, const StringArray &names);
+
+    // The caller takes the ownership; returns nullptr on failure
+    XmlElement *readTransaction(const Record &record) const;
+
+private:
+
+    enum RecordType
+    {
+        transactionRecord = 1,
+        stateRecord = 2
+    };
+
+    bool appendRecord(OutputStream &out, RecordType type, const MemoryBlock &payload);
+
+    bool compact(Array<Record> &transactions);
+
+    void remove();
+
+    File file;
+
+    // Where the valid records end
+    int64 size;
+
+    // Bytes taken by the records that are still in use
+    int64 liveSize;
+
+    int generation;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UndoHistoryFile)
+};
@@ -0,0 +1,106 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "Common.h"
+#include "UndoJournal.h"
+#include "FileUtils.h"
+
+UndoJournal::UndoJournal() : size(0) {}
+
+UndoJournal::~UndoJournal()
+{
+    this->clear();
+}
+
+UndoJournal::Record UndoJournal::write(const XmlElement &transaction)
+{
+    Record record;
+
+    if (this->file == File())
+    {
+        this->file = File(FileUtils::getTemporaryFolder()).getNonexistentChildFile("undo", ".journal", false);
+    }
+
+    MemoryOutputStream compressed;
+
+    {
+        GZIPCompressorOutputStream gzip(&compressed, 9, false);
+        transaction.writeToStream(gzip, StringRef(), true, false);
+    }
+
+    FileOutputStream out(this->file);
+
+    if (out.failedToOpen())
+    {
+        return record;
+    }
+
+    // Whatever was there after the last good record is overwritten
+    out.setPosition(this->size);
+    out.truncate();
+
+    if (! out.write(compressed.getData(), compressed.getDataSize()))
+    {
+        return record;
+    }
+
+    out.flush();
+
+    record.offset = this->size;
+    record.size = int(compressed.getDataSize());
+    this->size += record.size;
+    return record;
+}
+
+XmlElement *UndoJournal::read(const Record &record) const
+{
+    if (! record.isValid() ||
+        record.offset + record.size > this->size)
+    {
+        return nullptr;
+    }
+
+    FileInputStream in(this->file);
+
+    if (in.failedToOpen() || ! in.setPosition(record.offset))
+    {
+        return nullptr;
+    }
+
+    MemoryBlock compressed;
+
+    if (in.readIntoMemoryBlock(compressed, record.size) != size_t(record.size))
+    {
+        return nullptr;
+    }
+
+    MemoryInputStream compressedStream(compressed, false);
+    GZIPDecompressorInputStream gzip(compressedStream);
+    return XmlDocument::parse(gzip.readEntireStreamAsString());
+}
+
+void UndoJournal::clear()
+{
+    if (this->file != File())
+    {
+        this->file.deleteFile();
+        this->file = File();
+    }
+
+    this->size = 0;
+}
@@ -0,0 +1,64 @@
+/*
+    This file is part of Helio Workstation.
+
+    Helio is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Helio is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Helio. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#pragma once
+
+// A local file the undo stack moves its older transactions to,
+// once they don't fit into the memory budget.
+// Each record is a gzipped transaction xml; the file is append-only,
+// so a record stays valid after it has been read back, and is removed
+// along with the stack. It lives in the temporary folder, since
+// nothing in it is needed after the project is closed.
+
+class UndoJournal
+{
+public:
+
+    UndoJournal();
+
+    ~UndoJournal();
+
+    struct Record
+    {
+        Record() : offset(0), size(0) {}
+
+        bool isValid() const noexcept
+        { return this->size > 0; }
+
+        int64 offset;
+        int size;
+    };
+
+    // Returns an invalid record, if the file is not writable
+    Record write(const XmlElement &transaction);
+
+    // The caller takes the ownership; returns nullptr on failure
+    XmlElement *read(const Record &record) const;
+
+    int64 getSize() const noexcept
+    { return this->size; }
+
+    void clear();
+
+private:
+
+    File file;
+    int64 size;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UndoJournal)
+};
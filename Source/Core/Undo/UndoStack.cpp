@@ -33,6 +33,13 @@
 
 #define MAX_TRANSACTIONS_TO_STORE 10
 
+// How much of the history is kept in the side file
+#define MAX_TRANSACTIONS_IN_HISTORY_FILE 100
+
+// Past that, the transactions moved to the journal are dropped,
+// and the journal starts over
+#define UNDO_STACK_MAX_JOURNAL_BYTES (256 * 1024 * 1024)
+
 
 struct UndoStack::ActionSet
 {
@@ -41,6 +48,11 @@ struct UndoStack::ActionSet
     name(std::move(transactionName))
     {}
     
+    bool isInMemory() const noexcept
+    {
+        return ! this->actions.isEmpty();
+    }
+
     bool perform() const
     {
         for (int i = 0; i < actions.size(); ++i) {
@@ -126,6 +138,7 @@ struct UndoStack::ActionSet
         else if (tagName == Serialization::Undo::notesGroupInsertAction)                { return new NotesGroupInsertAction(this->project); }
         else if (tagName == Serialization::Undo::notesGroupRemoveAction)                { return new NotesGroupRemoveAction(this->project); }
         else if (tagName == Serialization::Undo::notesGroupChangeAction)                { return new NotesGroupChangeAction(this->project); }
+        else if (tagName == Serialization::Undo::notesGroupTransformAction)             { return new NotesGroupTransformAction(this->project); }
         else if (tagName == Serialization::Undo::annotationEventInsertAction)           { return new AnnotationEventInsertAction(this->project); }
         else if (tagName == Serialization::Undo::annotationEventRemoveAction)           { return new AnnotationEventRemoveAction(this->project); }
         else if (tagName == Serialization::Undo::annotationEventChangeAction)           { return new AnnotationEventChangeAction(this->project); }
@@ -152,20 +165,26 @@ struct UndoStack::ActionSet
     OwnedArray<UndoAction> actions;
     String name;
     
+    // Where the actions can be read back from, once moved out of memory;
+    // the records stay valid after that, until the transaction is changed
+    UndoJournal::Record journalRecord;
+    UndoHistoryFile::Record historyRecord;
+    
     ProjectTreeItem &project;
 };
 
 //==============================================================================
 UndoStack::UndoStack (ProjectTreeItem &parentProject,
-                      const int maxNumberOfUnitsToKeep,
+                      const int maxNumberOfBytesToKeep,
                       const int minimumTransactions) :
 project(parentProject),
-totalUnitsStored(0),
+totalBytesStored(0),
 nextIndex(0),
 newTransaction(true),
-reentrancyCheck(false)
+reentrancyCheck(false),
+hasPendingHistory(false)
 {
-    setMaxNumberOfStoredUnits (maxNumberOfUnitsToKeep,
+    setMaxNumberOfStoredBytes (maxNumberOfBytesToKeep,
                                minimumTransactions);
 }
 
@@ -177,20 +196,38 @@ UndoStack::~UndoStack()
 void UndoStack::clearUndoHistory()
 {
     transactions.clear();
-    totalUnitsStored = 0;
+    journal.clear();
+    hasPendingHistory = false;
+    totalBytesStored = 0;
     nextIndex = 0;
     sendChangeMessage();
 }
 
-int UndoStack::getNumberOfUnitsTakenUpByStoredCommands() const
+int UndoStack::getNumberOfBytesTakenUpByStoredCommands() const
 {
-    return totalUnitsStored;
+    return totalBytesStored;
 }
 
-void UndoStack::setMaxNumberOfStoredUnits (const int maxNumberOfUnitsToKeep,
+int64 UndoStack::getNumberOfBytesInJournal() const noexcept
+{
+    return journal.getSize();
+}
+
+int UndoStack::getNumberOfTransactionsInJournal() const
+{
+    int numTransactions = 0;
+    
+    for (auto transaction : transactions) {
+        numTransactions += (! transaction->isInMemory() && transaction->journalRecord.isValid()) ? 1 : 0;
+    }
+    
+    return numTransactions;
+}
+
+void UndoStack::setMaxNumberOfStoredBytes (const int maxNumberOfBytesToKeep,
                                            const int minimumTransactions)
 {
-    maxNumUnitsToKeep          = jmax (1, maxNumberOfUnitsToKeep);
+    maxNumBytesToKeep          = jmax (1, maxNumberOfBytesToKeep);
     minimumTransactionsToKeep  = jmax (1, minimumTransactions);
 }
 
@@ -241,7 +278,7 @@ bool UndoStack::perform (UndoAction* const newAction)
                         {
                             //Logger::writeToLog("createCoalescedAction");
                             action = coalescedAction;
-                            totalUnitsStored -= lastAction->getSizeInUnits();
+                            totalBytesStored -= lastAction->getSizeInUnits();
                             actionSet->actions.remove(i);
                             break;
                         }
@@ -254,7 +291,7 @@ bool UndoStack::perform (UndoAction* const newAction)
                 //    {
                 //        Logger::writeToLog("remove last");
                 //        action = coalescedAction;
-                //        totalUnitsStored -= lastAction->getSizeInUnits();
+                //        totalBytesStored -= lastAction->getSizeInUnits();
                 //        actionSet->actions.removeLast();
                 //    }
                 //}
@@ -266,8 +303,10 @@ bool UndoStack::perform (UndoAction* const newAction)
                 ++nextIndex;
             }
             
-            totalUnitsStored += action->getSizeInUnits();
+            totalBytesStored += action->getSizeInUnits();
             actionSet->actions.add (action.release());
+            actionSet->journalRecord = UndoJournal::Record();
+            actionSet->historyRecord = UndoHistoryFile::Record();
             newTransaction = false;
             //Logger::writeToLog("size " + String(actionSet->actions.size()));
             
@@ -284,22 +323,109 @@ void UndoStack::clearFutureTransactions()
 {
     while (nextIndex < transactions.size())
     {
-        totalUnitsStored -= transactions.getLast()->getTotalSize();
+        totalBytesStored -= transactions.getLast()->getTotalSize();
         transactions.removeLast();
     }
     
-    while (nextIndex > 0
-           && totalUnitsStored > maxNumUnitsToKeep
-           && transactions.size() > minimumTransactionsToKeep)
+    // the oldest transactions are moved out of memory first,
+    // and only dropped if they are not in the history file, and the journal is not writable
+    for (int i = 0; i < nextIndex - minimumTransactionsToKeep
+         && totalBytesStored > maxNumBytesToKeep; ++i)
     {
-        totalUnitsStored -= transactions.getFirst()->getTotalSize();
-        transactions.remove (0);
-        --nextIndex;
+        ActionSet *const transaction = transactions.getUnchecked (i);
         
-        // if this fails, then some actions may not be returning
-        // consistent results from their getSizeInUnits() method
-        jassert (totalUnitsStored >= 0);
+        if (! transaction->isInMemory() || moveOutOfMemory (*transaction)) {
+            continue;
+        }
+        
+        while (i >= 0)
+        {
+            totalBytesStored -= transactions.getFirst()->getTotalSize();
+            transactions.remove (0);
+            --nextIndex;
+            --i;
+        }
+    }
+    
+    if (journal.getSize() > UNDO_STACK_MAX_JOURNAL_BYTES)
+    {
+        int lastInJournal = -1;
+        
+        for (int i = 0; i < transactions.size(); ++i) {
+            const ActionSet *const transaction = transactions.getUnchecked (i);
+            if (! transaction->isInMemory() && ! transaction->historyRecord.isValid()) {
+                lastInJournal = i;
+            }
+        }
+        
+        for (int i = 0; i <= lastInJournal; ++i)
+        {
+            totalBytesStored -= transactions.getFirst()->getTotalSize();
+            transactions.remove (0);
+            --nextIndex;
+        }
+        
+        // nothing refers to the journal records anymore
+        for (auto transaction : transactions) {
+            transaction->journalRecord = UndoJournal::Record();
+        }
+        
+        journal.clear();
     }
+    
+    // if this fails, then some actions may not be returning
+    // consistent results from their getSizeInUnits() method
+    jassert (totalBytesStored >= 0);
+}
+
+bool UndoStack::moveOutOfMemory (ActionSet &transaction)
+{
+    if (! transaction.journalRecord.isValid() &&
+        ! transaction.historyRecord.isValid())
+    {
+        ScopedPointer<XmlElement> xml (transaction.serialize());
+        transaction.journalRecord = journal.write (*xml);
+        
+        if (! transaction.journalRecord.isValid()) {
+            return false;
+        }
+    }
+    
+    totalBytesStored -= transaction.getTotalSize();
+    transaction.actions.clear();
+    return true;
+}
+
+bool UndoStack::restore (ActionSet &transaction)
+{
+    ScopedPointer<XmlElement> xml (readTransaction (transaction));
+    
+    if (xml == nullptr) {
+        return false;
+    }
+    
+    transaction.deserialize (*xml);
+    totalBytesStored += transaction.getTotalSize();
+    return transaction.isInMemory();
+}
+
+XmlElement *UndoStack::readTransaction (const ActionSet &transaction) const
+{
+    if (transaction.isInMemory()) {
+        return transaction.serialize();
+    }
+    
+    if (transaction.journalRecord.isValid()) {
+        if (XmlElement *xml = journal.read (transaction.journalRecord)) {
+            return xml;
+        }
+    }
+    
+    if (transaction.historyRecord.isValid()) {
+        return historyFile.readTransaction (transaction.historyRecord);
+    }
+    
+    return nullptr;
 }
 
 void UndoStack::beginNewTransaction() noexcept
@@ -326,16 +452,22 @@ void UndoStack::setCurrentTransactionName (const String& newName) noexcept
 UndoStack::ActionSet* UndoStack::getCurrentSet() const noexcept     { return transactions [nextIndex - 1]; }
 UndoStack::ActionSet* UndoStack::getNextSet() const noexcept        { return transactions [nextIndex]; }
 
-bool UndoStack::canUndo() const noexcept   { return getCurrentSet() != nullptr; }
+bool UndoStack::canUndo() const noexcept   { return getCurrentSet() != nullptr || hasPendingHistory; }
 bool UndoStack::canRedo() const noexcept   { return getNextSet()    != nullptr; }
 
 bool UndoStack::undo()
 {
-    if (const ActionSet* const s = getCurrentSet())
+    if (hasPendingHistory) {
+        loadPendingHistory();
+    }
+    
+    if (ActionSet* const s = getCurrentSet())
     {
         const ScopedValueSetter<bool> setter (reentrancyCheck, true);
         
-        if (s->undo()) {
+        if (! s->isInMemory() && ! restore (*s)) {
+            clearUndoHistory();
+        } else if (s->undo()) {
             --nextIndex;
         } else {
             clearUndoHistory();
@@ -351,11 +483,13 @@ bool UndoStack::undo()
 
 bool UndoStack::redo()
 {
-    if (const ActionSet* const s = getNextSet())
+    if (ActionSet* const s = getNextSet())
     {
         const ScopedValueSetter<bool> setter (reentrancyCheck, true);
         
-        if (s->perform()) {
+        if (! s->isInMemory() && ! restore (*s)) {
+            clearUndoHistory();
+        } else if (s->perform()) {
             ++nextIndex;
         } else {
             clearUndoHistory();
@@ -431,7 +565,10 @@ XmlElement *UndoStack::serialize() const
     {
         if (ActionSet *action = this->transactions[currentIndex])
         {
-            xml->prependChildElement(action->serialize());
+            if (XmlElement *actionXml = this->readTransaction(*action))
+            {
+                xml->prependChildElement(actionXml);
+            }
         }
         
         --currentIndex;
@@ -455,6 +592,7 @@ void UndoStack::deserialize(const XmlElement &xml)
     {
         auto actionSet = new ActionSet(this->project, String::empty);
         actionSet->deserialize(*childTransactionXml);
+        this->totalBytesStored += actionSet->getTotalSize();
         this->transactions.insert(this->nextIndex, actionSet);
         ++this->nextIndex;
     }
@@ -464,3 +602,170 @@ void UndoStack::reset()
 {
     this->clearUndoHistory();
 }
+
+
+//===----------------------------------------------------------------------===//
+// History file
+//===----------------------------------------------------------------------===//
+
+void UndoStack::onProjectDidLoad(const File &projectFile)
+{
+    // The projects saved by the older versions have the history inside,
+    // and any side file found next to them is not to be trusted
+    const bool hasHistoryInProject = (this->transactions.size() > 0);
+    
+    this->historyProjectFile = projectFile;
+    this->historyFile.setFile(UndoHistoryFile::getFileFor(projectFile), ! hasHistoryInProject);
+    this->hasPendingHistory = (! hasHistoryInProject && this->historyFile.exists());
+}
+
+void UndoStack::onProjectWillSave()
+{
+    // The side file is checked against the project file as it was saved,
+    // so this has to be done before the project file is overwritten
+    if (this->hasPendingHistory)
+    {
+        this->loadPendingHistory();
+    }
+}
+
+bool UndoStack::loadPendingHistory()
+{
+    this->hasPendingHistory = false;
+    
+    Array<UndoHistoryFile::Record> records;
+    StringArray names;
+    
+    if (! this->historyFile.readState(this->project.getId(), this->historyProjectFile, records, names))
+    {
+        return false;
+    }
+    
+    // Only the records are loaded here, the actions are read when undoing that far
+    for (int i = 0; i < records.size(); ++i)
+    {
+        auto transaction = new ActionSet(this->project, names[i]);
+        transaction->historyRecord = records.getUnchecked(i);
+        this->transactions.insert(i, transaction);
+        ++this->nextIndex;
+    }
+    
+    this->sendChangeMessage();
+    return true;
+}
+
+void UndoStack::onProjectDidSave(const File &projectFile)
+{
+    if (this->hasPendingHistory)
+    {
+        this->loadPendingHistory();
+    }
+    
+    const File sideFile(UndoHistoryFile::getFileFor(projectFile));
+    const File previousSideFile(this->historyFile.getFile());
+    const File previousProjectFile(this->historyProjectFile);
+    
+    // Saved as another file, so the records in the old side file are no use there
+    if (sideFile != previousSideFile)
+    {
+        for (auto transaction : this->transactions)
+        {
+            if (! transaction->isInMemory() && ! transaction->journalRecord.isValid())
+            {
+                this->restore(*transaction);
+            }
+            
+            transaction->historyRecord = UndoHistoryFile::Record();
+        }
+        
+        this->historyFile.setFile(sideFile, false);
+    }
+    
+    this->historyProjectFile = projectFile;
+    
+    Array<ActionSet *> storedTransactions;
+    Array<UndoHistoryFile::Record> records;
+    StringArray names;
+    
+    for (int i = jmax(0, this->nextIndex - MAX_TRANSACTIONS_IN_HISTORY_FILE); i < this->nextIndex; ++i)
+    {
+        ActionSet *const transaction = this->transactions.getUnchecked(i);
+        
+        // Only the new and changed transactions are written
+        if (! transaction->historyRecord.isValid())
+        {
+            ScopedPointer<XmlElement> xml(this->readTransaction(*transaction));
+            
+            if (xml != nullptr)
+            {
+                transaction->historyRecord = this->historyFile.writeTransaction(*xml);
+            }
+        }
+        
+        // Nothing before a missing transaction can be undone after loading
+        if (! transaction->historyRecord.isValid())
+        {
+            storedTransactions.clearQuick();
+            records.clearQuick();
+            names.clearQuick();
+            continue;
+        }
+        
+        storedTransactions.add(transaction);
+        records.add(transaction->historyRecord);
+        names.add(transaction->name);
+    }
+    
+    const int generation = this->historyFile.getGeneration();
+    
+    if (! this->historyFile.writeState(this->project.getId(), projectFile, records, names))
+    {
+        return;
+    }
+    
+    // Renamed, so the old side file would only be left behind; after a Save As,
+    // it still belongs to the original project, which keeps its history
+    if (previousSideFile != sideFile &&
+        previousSideFile.existsAsFile() &&
+        previousProjectFile != File() &&
+        ! previousProjectFile.existsAsFile())
+    {
+        previousSideFile.deleteFile();
+    }
+    
+    if (this->historyFile.getGeneration() == generation)
+    {
+        return;
+    }
+    
+    // The file has been compacted: the offsets of the stored transactions have changed,
+    // and the older ones are not there anymore, so the ones that were only kept there are lost
+    for (int i = 0; i < storedTransactions.size(); ++i)
+    {
+        storedTransactions.getUnchecked(i)->historyRecord = records.getUnchecked(i);
+    }
+    
+    int lastLost = -1;
+    
+    for (int i = 0; i < this->transactions.size(); ++i)
+    {
+        ActionSet *const transaction = this->transactions.getUnchecked(i);
+        
+        if (! storedTransactions.contains(transaction))
+        {
+            transaction->historyRecord = UndoHistoryFile::Record();
+            
+            if (! transaction->isInMemory() && ! transaction->journalRecord.isValid())
+            {
+                lastLost = i;
+            }
+        }
+    }
+    
+    for (int i = 0; i <= lastLost; ++i)
+    {
+        this->totalBytesStored -= this->transactions.getFirst()->getTotalSize();
+        this->transactions.remove(0);
+        --this->nextIndex;
+    }
+}
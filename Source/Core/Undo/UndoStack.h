@@ -21,21 +21,34 @@ class UndoAction;
 class ProjectTreeItem;
 
 #include "Serializable.h"
+#include "UndoJournal.h"
+#include "UndoHistoryFile.h"
+
+// The history is limited by the memory its actions take, as reported
+// by UndoAction::getSizeInUnits(), rather than by the number of actions;
+// the older transactions that don't fit are moved to the journal file
+// and read back when undoing that far.
+// Between the sessions, the history is kept in a side file next to the project,
+// which is only read when undoing, or when the project is saved again
+#define UNDO_STACK_DEFAULT_MAX_BYTES (32 * 1024 * 1024)
+#define UNDO_STACK_MIN_TRANSACTIONS 30
 
 class UndoStack : public ChangeBroadcaster, public Serializable
 {
 public:
 
     explicit UndoStack(ProjectTreeItem &parentProject,
-              int maxNumberOfUnitsToKeep = 30000,
-              int minimumTransactionsToKeep = 30);
+              int maxNumberOfBytesToKeep = UNDO_STACK_DEFAULT_MAX_BYTES,
+              int minimumTransactionsToKeep = UNDO_STACK_MIN_TRANSACTIONS);
 
     ~UndoStack() override;
     
     void clearUndoHistory();
     
-    int getNumberOfUnitsTakenUpByStoredCommands() const;
-    void setMaxNumberOfStoredUnits(int maxNumberOfUnitsToKeep,
+    int getNumberOfBytesTakenUpByStoredCommands() const;
+    int64 getNumberOfBytesInJournal() const noexcept;
+    int getNumberOfTransactionsInJournal() const;
+    void setMaxNumberOfStoredBytes(int maxNumberOfBytesToKeep,
                                    int minimumTransactionsToKeep);
     
     bool perform(UndoAction *action);
@@ -58,6 +71,10 @@ public:
     String getRedoDescription() const;
     bool redo();
     
+    void onProjectDidLoad(const File &projectFile);
+    void onProjectWillSave();
+    void onProjectDidSave(const File &projectFile);
+    
     XmlElement *serialize() const override;
     void deserialize(const XmlElement &xml) override;
     void reset() override;
@@ -72,13 +89,25 @@ private:
     OwnedArray<ActionSet> transactions;
     String newTransactionName;
     
-    int totalUnitsStored, maxNumUnitsToKeep, minimumTransactionsToKeep, nextIndex;
+    int totalBytesStored, maxNumBytesToKeep, minimumTransactionsToKeep, nextIndex;
     bool newTransaction, reentrancyCheck;
     
     ActionSet *getCurrentSet() const noexcept;
     ActionSet *getNextSet() const noexcept;
     
     void clearFutureTransactions();
+
+    bool moveOutOfMemory(ActionSet &transaction);
+    bool restore(ActionSet &transaction);
+    XmlElement *readTransaction(const ActionSet &transaction) const;
+
+    UndoJournal journal;
+
+    bool loadPendingHistory();
+
+    UndoHistoryFile historyFile;
+    File historyProjectFile;
+    bool hasPendingHistory;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (UndoStack)
 };
@@ -478,7 +478,7 @@ Array<NewSerializedDelta> AutomationLayerDiffLogic::createEventsDiffs(const XmlE
             {
                 foundNoteInChanges = true;
 
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                const bool eventHasChanged = (stateEvent->getTick() != changesEvent->getTick() ||
                                               stateEvent->getCurvature() != changesEvent->getCurvature() ||
                                               stateEvent->getControllerValue() != changesEvent->getControllerValue());
 
@@ -500,8 +500,8 @@ Array<NewSerializedDelta> PianoLayerDiffLogic::createEventsDiffs(const XmlElemen
                 foundNoteInChanges = true;
 
                 const bool noteHasChanged = (stateNote->getKey() != changesNote->getKey() ||
-                                             stateNote->getBeat() != changesNote->getBeat() ||
-                                             stateNote->getLength() != changesNote->getLength() ||
+                                             stateNote->getTick() != changesNote->getTick() ||
+                                             stateNote->getLengthInTicks() != changesNote->getLengthInTicks() ||
                                              stateNote->getVelocity() != changesNote->getVelocity());
 
                 if (noteHasChanged)
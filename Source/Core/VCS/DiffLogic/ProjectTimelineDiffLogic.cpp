@@ -503,7 +503,7 @@ Array<NewSerializedDelta> ProjectTimelineDiffLogic::createAnnotationsDiffs(const
             {
                 foundNoteInChanges = true;
 
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                const bool eventHasChanged = (stateEvent->getTick() != changesEvent->getTick() ||
                                               stateEvent->getColour() != changesEvent->getColour() ||
                                               stateEvent->getDescription() != changesEvent->getDescription());
 
@@ -606,7 +606,7 @@ Array<NewSerializedDelta> ProjectTimelineDiffLogic::createTimeSignaturesDiffs(co
             {
                 foundNoteInChanges = true;
                 
-                const bool eventHasChanged = (stateEvent->getBeat() != changesEvent->getBeat() ||
+                const bool eventHasChanged = (stateEvent->getTick() != changesEvent->getTick() ||
                                               stateEvent->getNumerator() != changesEvent->getNumerator() ||
                                               stateEvent->getDenominator() != changesEvent->getDenominator());
                 
@@ -58,6 +58,17 @@ void PluginWindow::closeCurrentlyOpenWindowsFor(const uint32 nodeId)
     }
 }
 
+bool PluginWindow::hasOpenWindowFor(const AudioProcessorGraph::Node *node)
+{
+    for (int i = activePluginWindows.size(); --i >= 0;) {
+        if (activePluginWindows.getUnchecked(i)->owner == node) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void PluginWindow::closeAllCurrentlyOpenWindows()
 {
     for (int i = activePluginWindows.size(); --i >= 0;) {
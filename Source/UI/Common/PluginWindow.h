@@ -32,6 +32,8 @@ public:
 
     static void closeCurrentlyOpenWindowsFor(const uint32 nodeId);
 
+    static bool hasOpenWindowFor(const AudioProcessorGraph::Node *node);
+
     static void closeAllCurrentlyOpenWindows();
 
     ~PluginWindow() override;
@@ -352,6 +352,9 @@ void InstrumentsPage::changeListenerCallback(ChangeBroadcaster *source)
             {
 				// Nasty hack -_-
                 delete progressIndicator;
+
+                const double scanTimeSeconds = this->pluginManager.getLastScanTimeMs() / 1000.0;
+                App::Helio()->showTooltip(TRANS("instruments::scandone") + " " + String(scanTimeSeconds, 1) + "s");
             }
         }
     }
@@ -45,7 +45,8 @@ template<typename T> AnnotationsTrackMap<T>::AnnotationsTrackMap(ProjectTreeItem
     
     this->reloadTrackMap();
     
-    this->project.addListener(this);
+    this->project.addListener(this,
+        ProjectListenerFilter(ProjectListenerFilter::annotationLayers, ProjectListenerFilter::allEventKinds));
 }
 
 template<typename T> AnnotationsTrackMap<T>::~AnnotationsTrackMap()
@@ -50,15 +50,14 @@ public:
     {
         if (first == second) { return 0; }
 
-        const float beatDiff = first->getBeat() - second->getBeat();
-        const int beatResult = (beatDiff > 0.f) - (beatDiff < 0.f);
-        if (beatResult != 0) { return beatResult; }
+        const int tickResult = MidiEvent::compareTicks(first->event.getTick(), second->event.getTick());
+        if (tickResult != 0) { return tickResult; }
 
         const float cvDiff = first->getControllerValue() - second->getControllerValue();
         const int cvResult = (cvDiff > 0.f) - (cvDiff < 0.f); // sorted by cv, if beats are the same
         if (cvResult != 0) { return cvResult; }
 
-        return first->event.getID().compare(second->event.getID());
+        return MidiEvent::compareIds(first->event.getID(), second->event.getID());
     }
 
     //[/UserMethods]
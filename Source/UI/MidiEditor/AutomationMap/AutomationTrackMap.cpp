@@ -62,7 +62,10 @@ AutomationTrackMap::AutomationTrackMap(ProjectTreeItem &parentProject, MidiRoll
     
     this->reloadTrack();
     
-    this->project.addListener(this);
+    this->project.addListener(this,
+        ProjectListenerFilter(ProjectListenerFilter::automationLayers,
+                              ProjectListenerFilter::allEventKinds,
+                              this->layer.get()));
     
     this->setSize(1, DEFAULT_TRACKMAP_HEIGHT);
 }
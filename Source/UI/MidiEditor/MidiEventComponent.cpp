@@ -139,9 +139,8 @@ void MidiEventComponent::mouseDown(const MouseEvent &e)
 int MidiEventComponent::compareElements(MidiEventComponent *first, MidiEventComponent *second)
 {
     if (first == second) { return 0; }
-    const float diff = first->getBeat() - second->getBeat();
-    const int diffResult = (diff > 0.f) - (diff < 0.f);
-    return (diffResult != 0) ? diffResult : (first->midiEvent.getID().compare(second->midiEvent.getID()));
+    const int tickResult = MidiEvent::compareTicks(first->midiEvent.getTick(), second->midiEvent.getTick());
+    return (tickResult != 0) ? tickResult : (MidiEvent::compareIds(first->midiEvent.getID(), second->midiEvent.getID()));
 }
 
 void MidiEventComponent::activateCorrespondingLayer(bool selectOthers, bool deselectOthers)
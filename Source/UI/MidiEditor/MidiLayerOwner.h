@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "LayerChangeSet.h"
+
 class MidiEvent;
 class MidiLayer;
 class Transport;
@@ -45,6 +47,8 @@ public:
 
     virtual void onEventRemovedPostAction(const MidiLayer *layer) {}
 
+    virtual void onChangesBatch(const LayerChangeSet &changes) { changes.sendTo(*this); }
+
     virtual void onLayerChanged(const MidiLayer *layer) = 0;
 
     virtual void onBeatRangeChanged() = 0;
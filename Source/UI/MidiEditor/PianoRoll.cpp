@@ -48,6 +48,7 @@
 #include "NoteResizerRight.h"
 #include "Config.h"
 #include "SerializationKeys.h"
+#include "MidiRecorder.h"
 
 #define ROWS_OF_TWO_OCTAVES 24
 
@@ -77,6 +78,11 @@ PianoRoll::PianoRoll(ProjectTreeItem &parentProject,
     this->indicator->toFront(false);
     
     this->reloadMidiTrack();
+
+    // The roll only shows notes, and the base class repaints on time signature changes
+    this->project.addListener(this,
+        ProjectListenerFilter(ProjectListenerFilter::pianoLayers | ProjectListenerFilter::timeSignatureLayers,
+                              ProjectListenerFilter::allEventKinds));
 }
 
 PianoRoll::~PianoRoll()
@@ -512,6 +518,69 @@ void PianoRoll::onEventRemoved(const MidiEvent &event)
     }
 }
 
+void PianoRoll::onChangesBatch(const LayerChangeSet &changes)
+{
+    if (! dynamic_cast<const PianoLayer *>(changes.getLayer()))
+    {
+        MidiRoll::onChangesBatch(changes);
+        return;
+    }
+
+    const Array<const MidiEvent *> &removedEvents = changes.getRemovedEvents();
+
+    if (removedEvents.size() > 0)
+    {
+        // Removing the components one by one would search the array for each of them,
+        // so they are collected first, and then removed from the array in a single pass
+        Array<MidiEventComponent *> removedComponents;
+        removedComponents.ensureStorageAllocated(removedEvents.size());
+
+        for (auto event : removedEvents)
+        {
+            const Note &note = static_cast<const Note &>(*event);
+
+            if (NoteComponent *component = this->componentsHashTable[note])
+            {
+                this->fader.fadeOut(component, 150);
+                this->selection.deselect(component);
+                this->removeChildComponent(component);
+                this->componentsHashTable.remove(note);
+                removedComponents.add(component);
+            }
+        }
+
+        DefaultElementComparator<MidiEventComponent *> comparator;
+        removedComponents.sort(comparator);
+
+        const int numComponents = this->eventComponents.size();
+        int numKept = 0;
+
+        for (int i = 0; i < numComponents; ++i)
+        {
+            if (removedComponents.indexOfSorted(comparator, this->eventComponents.getUnchecked(i)) < 0)
+            {
+                this->eventComponents.swap(i, numKept++);
+            }
+        }
+
+        this->eventComponents.removeLast(numComponents - numKept, true);
+        this->onEventRemovedPostAction(changes.getLayer());
+    }
+
+    const Array<const MidiEvent *> &changedBefore = changes.getChangedEventsBefore();
+    const Array<const MidiEvent *> &changedAfter = changes.getChangedEventsAfter();
+
+    for (int i = 0; i < changedBefore.size(); ++i)
+    {
+        this->onEventChanged(*changedBefore.getUnchecked(i), *changedAfter.getUnchecked(i));
+    }
+
+    for (auto event : changes.getAddedEvents())
+    {
+        this->onEventAdded(*event);
+    }
+}
+
 void PianoRoll::onLayerChanged(const MidiLayer *layer)
 {
     if (! dynamic_cast<const PianoLayer *>(layer)) { return; }
@@ -562,11 +631,32 @@ void PianoRoll::findLassoItemsInArea(Array<MidiEventComponent *> &itemsFound, co
         note->setSelected(this->selection.isSelected(note));
     }
 
-    for (int i = 0; i < this->eventComponents.size(); ++i)
+    // Only the notes of the active layers can be lassoed, so ask their key indices
+    // for the rows and beats under the rectangle (widened by a pixel and a row
+    // to cover rounding), and only test the bounds of what they return
+    const float startBeat = this->getBarByXPosition(rectangle.getX() - 1) * NUM_BEATS_IN_BAR;
+    const float endBeat = this->getBarByXPosition(rectangle.getRight() + 1) * NUM_BEATS_IN_BAR;
+    const int lowKey = jmax(0, (this->getHeight() - rectangle.getBottom()) / this->rowHeight - 1);
+    const int highKey = jmin(this->numRows - 1, (this->getHeight() - rectangle.getY()) / this->rowHeight);
+
+    Array<Note *> candidates;
+
+    for (auto layer : this->activeLayers)
     {
-        NoteComponent *note = static_cast<NoteComponent *>(this->eventComponents.getUnchecked(i));
+        if (PianoLayer *pianoLayer = dynamic_cast<PianoLayer *>(layer))
+        {
+            for (int key = lowKey; key <= highKey; ++key)
+            {
+                pianoLayer->findNotes(key, startBeat, endBeat, candidates);
+            }
+        }
+    }
+
+    for (auto candidate : candidates)
+    {
+        NoteComponent *note = this->componentsHashTable[*candidate];
 
-        if (rectangle.intersects(note->getBounds()) && note->isActive())
+        if (note != nullptr && rectangle.intersects(note->getBounds()) && note->isActive())
         {
             shouldInvalidateSelectionCache = true;
             itemsFound.addIfNotAlreadyThere(note);
@@ -948,6 +1038,22 @@ bool PianoRoll::keyPressed(const KeyPress &key)
             return true;
         }
     }
+    else if (key == KeyPress::createFromDescription("r"))
+    {
+        MidiRecorder &recorder = this->project.getTransport().getMidiRecorder();
+
+        if (recorder.isRecording())
+        {
+            recorder.stopRecording();
+            return true;
+        }
+        else if (PianoLayer *layer = dynamic_cast<PianoLayer *>(this->getPrimaryActiveMidiLayer()))
+        {
+            recorder.startRecording(layer);
+            this->startFollowingIndicator();
+            return true;
+        }
+    }
     else if (key == KeyPress::createFromDescription("o"))
     {
         MIDI_ROLL_BULK_REPAINT_START
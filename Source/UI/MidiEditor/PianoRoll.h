@@ -135,6 +135,7 @@ public:
     void onEventChanged(const MidiEvent &oldEvent, const MidiEvent &newEvent) override;
     void onEventAdded(const MidiEvent &event) override;
     void onEventRemoved(const MidiEvent &event) override;
+    void onChangesBatch(const LayerChangeSet &changes) override;
     void onLayerChanged(const MidiLayer *layer) override;
     void onLayerAdded(const MidiLayer *layer) override;
     void onLayerRemoved(const MidiLayer *layer) override;
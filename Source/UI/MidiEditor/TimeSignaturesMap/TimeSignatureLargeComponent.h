@@ -44,11 +44,10 @@ public:
     {
         if (first == second) { return 0; }
 
-        const float diff = first->event.getBeat() - second->event.getBeat();
-        const int diffResult = (diff > 0.f) - (diff < 0.f);
-        if (diffResult != 0) { return diffResult; }
+        const int tickResult = MidiEvent::compareTicks(first->event.getTick(), second->event.getTick());
+        if (tickResult != 0) { return tickResult; }
 
-        return first->event.getID().compare(second->event.getID());
+        return MidiEvent::compareIds(first->event.getID(), second->event.getID());
     }
     //[/UserMethods]
 
@@ -56,7 +56,8 @@ template<typename T> TimeSignaturesTrackMap<T>::TimeSignaturesTrackMap(ProjectTr
     
     this->reloadTrackMap();
     
-    this->project.addListener(this);
+    this->project.addListener(this,
+        ProjectListenerFilter(ProjectListenerFilter::timeSignatureLayers, ProjectListenerFilter::allEventKinds));
 }
 
 template<typename T> TimeSignaturesTrackMap<T>::~TimeSignaturesTrackMap()
@@ -92,7 +92,8 @@ PianoTrackMap::PianoTrackMap(ProjectTreeItem &parentProject, MidiRoll &parentRol
     this->setOpaque(false);
     this->setInterceptsMouseClicks(false, false);
     this->reloadTrackMap();
-    this->project.addListener(this);
+    this->project.addListener(this,
+        ProjectListenerFilter(ProjectListenerFilter::pianoLayers, ProjectListenerFilter::allEventKinds));
 }
 
 PianoTrackMap::~PianoTrackMap()
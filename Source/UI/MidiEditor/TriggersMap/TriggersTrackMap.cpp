@@ -50,7 +50,10 @@ TriggersTrackMap::TriggersTrackMap(ProjectTreeItem &parentProject, MidiRoll &par
     
     this->reloadTrack();
     
-    this->project.addListener(this);
+    this->project.addListener(this,
+        ProjectListenerFilter(ProjectListenerFilter::automationLayers,
+                              ProjectListenerFilter::allEventKinds,
+                              this->layer.get()));
 
     this->setSize(1, DEFAULT_TRACKMAP_HEIGHT);
 }
@@ -23,6 +23,7 @@
 
 //[MiscUserDefs]
 #include "AudioCore.h"
+#include "BuiltInSynthSamplesPool.h"
 //[/MiscUserDefs]
 
 AudioSettings::AudioSettings(AudioCore &core)
@@ -94,11 +95,20 @@ AudioSettings::AudioSettings(AudioCore &core)
     latency->setTextWhenNoChoicesAvailable (TRANS("(no choices)"));
     latency->addListener (this);
 
+    addAndMakeVisible (samplesPoolLabel = new Label (String(),
+                                                     String()));
+    samplesPoolLabel->setFont (Font (Font::getDefaultSansSerifFontName(), 16.00f, Font::plain).withTypefaceStyle ("Regular"));
+    samplesPoolLabel->setJustificationType (Justification::centredRight);
+    samplesPoolLabel->setEditable (false, false, false);
+    samplesPoolLabel->setColour (Label::textColourId, Colour (0x77ffffff));
+    samplesPoolLabel->setColour (TextEditor::textColourId, Colours::black);
+    samplesPoolLabel->setColour (TextEditor::backgroundColourId, Colour (0x00000000));
+
 
     //[UserPreSize]
     //[/UserPreSize]
 
-    setSize (550, 300);
+    setSize (550, 330);
 
     //[Constructor]
     //[/Constructor]
@@ -117,6 +127,7 @@ AudioSettings::~AudioSettings()
     sampleRatesLabel = nullptr;
     latencyLabel = nullptr;
     latency = nullptr;
+    samplesPoolLabel = nullptr;
 
     //[Destructor]
     //[/Destructor]
@@ -138,12 +149,13 @@ void AudioSettings::resized()
 
     deviceTypes->setBounds (16, 39, getWidth() - 38, 26);
     deviceTypesLabel->setBounds (8, 8, getWidth() - 22, 24);
-    devices->setBounds (16, (getHeight() / 2) + -26 - (26 / 2), getWidth() - 38, 26);
+    devices->setBounds (16, 111, getWidth() - 38, 26);
     devicesLabel->setBounds (8, 80, getWidth() - 22, 24);
-    sampleRates->setBounds (16, (getHeight() / 2) + 46 - (26 / 2), getWidth() - 38, 26);
+    sampleRates->setBounds (16, 183, getWidth() - 38, 26);
     sampleRatesLabel->setBounds (8, 152, getWidth() - 22, 24);
     latencyLabel->setBounds (8, 236 - (24 / 2), getWidth() - 22, 24);
-    latency->setBounds (16, (getHeight() / 2) + 119 - (26 / 2), getWidth() - 38, 26);
+    latency->setBounds (16, 256, getWidth() - 38, 26);
+    samplesPoolLabel->setBounds (8, 294, getWidth() - 22, 24);
     //[UserResized] Add your own custom resize handling here..
     //[/UserResized]
 }
@@ -212,6 +224,7 @@ void AudioSettings::visibilityChanged()
         this->syncDevicesList(deviceManager);
         this->syncSampleRatesList(deviceManager);
         this->syncLatencySlider(deviceManager);
+        this->syncSamplesPoolInfo();
     }
     //[/UserCode_visibilityChanged]
 }
@@ -363,6 +376,18 @@ void AudioSettings::syncLatencySlider(AudioDeviceManager &deviceManager)
     }
 }
 
+void AudioSettings::syncSamplesPoolInfo()
+{
+    const auto stats = BuiltInSynthSamplesPool::getInstance().getStatistics();
+
+    this->samplesPoolLabel->setText(TRANS("settings::audio::samplespool") + ": " +
+        String(stats.numSamples) + " / " +
+        File::descriptionOfSizeInBytes(stats.bytesUsed) + " (" +
+        File::descriptionOfSizeInBytes(stats.bytesSaved) + " " +
+        TRANS("settings::audio::samplespool::shared") + ")",
+        dontSendNotification);
+}
+
 //[/MiscUserCode]
 
 #if 0
@@ -373,7 +398,7 @@ BEGIN_JUCER_METADATA
                  componentName="" parentClasses="public Component" constructorParams="AudioCore &amp;core"
                  variableInitialisers="audioCore(core)" snapPixels="8" snapActive="1"
                  snapShown="1" overlayOpacity="0.330" fixedSize="1" initialWidth="550"
-                 initialHeight="300">
+                 initialHeight="330">
   <METHODS>
     <METHOD name="visibilityChanged()"/>
   </METHODS>
@@ -387,7 +412,7 @@ BEGIN_JUCER_METADATA
          editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default sans-serif font"
          fontsize="21" kerning="0" bold="0" italic="0" justification="33"/>
   <COMBOBOX name="" id="c40779f2a1d82e01" memberName="devices" virtualName=""
-            explicitFocusOrder="0" pos="16 -26Cc 38M 26" editable="0" layout="33"
+            explicitFocusOrder="0" pos="16 111 38M 26" editable="0" layout="33"
             items="" textWhenNonSelected="" textWhenNoItems="(no choices)"/>
   <LABEL name="" id="1a168043cfef2cb0" memberName="devicesLabel" virtualName=""
          explicitFocusOrder="0" pos="8 80 22M 24" textCol="bcffffff" edTextCol="ff000000"
@@ -395,7 +420,7 @@ BEGIN_JUCER_METADATA
          editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default sans-serif font"
          fontsize="21" kerning="0" bold="0" italic="0" justification="33"/>
   <COMBOBOX name="" id="6266c722bfb5105a" memberName="sampleRates" virtualName=""
-            explicitFocusOrder="0" pos="16 46Cc 38M 26" editable="0" layout="33"
+            explicitFocusOrder="0" pos="16 183 38M 26" editable="0" layout="33"
             items="" textWhenNonSelected="" textWhenNoItems="(no choices)"/>
   <LABEL name="" id="46a4ed98959925ad" memberName="sampleRatesLabel" virtualName=""
          explicitFocusOrder="0" pos="8 152 22M 24" textCol="bcffffff"
@@ -410,8 +435,13 @@ BEGIN_JUCER_METADATA
          fontname="Default sans-serif font" fontsize="21" kerning="0"
          bold="0" italic="0" justification="33"/>
   <COMBOBOX name="" id="5961361c40500925" memberName="latency" virtualName=""
-            explicitFocusOrder="0" pos="16 119Cc 38M 26" editable="0" layout="33"
+            explicitFocusOrder="0" pos="16 256 38M 26" editable="0" layout="33"
             items="" textWhenNonSelected="" textWhenNoItems="(no choices)"/>
+  <LABEL name="" id="c3f1b1c0f7a52e4d" memberName="samplesPoolLabel" virtualName=""
+         explicitFocusOrder="0" pos="8 294 22M 24" textCol="77ffffff"
+         edTextCol="ff000000" edBkgCol="0" labelText="" editableSingleClick="0"
+         editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default sans-serif font"
+         fontsize="16" kerning="0" bold="0" italic="0" justification="34"/>
 </JUCER_COMPONENT>
 
 END_JUCER_METADATA
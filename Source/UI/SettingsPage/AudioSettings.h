@@ -61,6 +61,8 @@ private:
 
     void syncLatencySlider(AudioDeviceManager &deviceManager);
 
+    void syncSamplesPoolInfo();
+
 
     AudioCore &audioCore;
 
@@ -74,6 +76,7 @@ private:
     ScopedPointer<Label> sampleRatesLabel;
     ScopedPointer<Label> latencyLabel;
     ScopedPointer<ComboBox> latency;
+    ScopedPointer<Label> samplesPoolLabel;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioSettings)
 };